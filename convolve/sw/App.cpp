@@ -3,11 +3,24 @@
 
 #include <stdlib.h>
 #include <cmath>
+#include <map>
+#include <vector>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "App.h"
 
 using namespace std;
 
+#define HUGE_PAGE_BYTES (2*1024*1024)
+
+// released buffers by size class, and the size class of every pool buffer
+static map<unsigned long, vector<void *> > freeBuffers;
+static map<void *, unsigned long> bufferSizes;
+static bool hugePages = false;
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+
 App::App(Board &board) : board(board) {
 
 }
@@ -26,3 +39,92 @@ unsigned long App::getSafeTransferSize(unsigned long elements,
   
   return (unsigned long) ceil(elements*bytesPerElement/(float) sizeof(boardWord_t))*sizeof(boardWord_t);
 }
+
+
+void *App::allocBuffer(unsigned long numBytes) {
+
+  unsigned long bytes = getSafeTransferSize(numBytes > 0 ? numBytes : 1, 1);
+
+  pthread_mutex_lock(&poolMutex);
+  bool huge = hugePages;
+  unsigned long pageBytes = huge ? HUGE_PAGE_BYTES : sysconf(_SC_PAGESIZE);
+  unsigned long sizeClass = pageBytes;
+  while (sizeClass < bytes) sizeClass *= 2;
+
+  vector<void *> &released = freeBuffers[sizeClass];
+  if (!released.empty()) {
+    void *buffer = released.back();
+    released.pop_back();
+    pthread_mutex_unlock(&poolMutex);
+    return buffer;
+  }
+  pthread_mutex_unlock(&poolMutex);
+
+  void *buffer = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (huge)
+    buffer = mmap(NULL, sizeClass, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+  if (buffer == MAP_FAILED)
+    buffer = mmap(NULL, sizeClass, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+  if (buffer == MAP_FAILED) {
+    cerr << "Error: can't allocate a " << sizeClass << " byte transfer buffer" << endl;
+    throw 1;
+  }
+
+  // locking faults the pages in now and keeps them from being swapped. It
+  // fails without enough RLIMIT_MEMLOCK, so fault the pages in by hand then.
+  if (mlock(buffer, sizeClass) != 0) {
+    for (unsigned long i=0; i < sizeClass; i += sysconf(_SC_PAGESIZE)) {
+      ((volatile char *) buffer)[i] = 0;
+    }
+  }
+
+  pthread_mutex_lock(&poolMutex);
+  bufferSizes[buffer] = sizeClass;
+  pthread_mutex_unlock(&poolMutex);
+  return buffer;
+}
+
+
+void App::releaseBuffer(void *buffer) {
+
+  if (buffer == NULL) return;
+
+  pthread_mutex_lock(&poolMutex);
+  map<void *, unsigned long>::iterator it = bufferSizes.find(buffer);
+  if (it == bufferSizes.end()) {
+    pthread_mutex_unlock(&poolMutex);
+    cerr << "Error: releasing a buffer that isn't from the buffer pool" << endl;
+    throw 1;
+  }
+  freeBuffers[it->second].push_back(buffer);
+  pthread_mutex_unlock(&poolMutex);
+}
+
+
+void App::setHugePages(bool enable) {
+
+  pthread_mutex_lock(&poolMutex);
+  hugePages = enable;
+  pthread_mutex_unlock(&poolMutex);
+}
+
+
+void App::freeBufferPool() {
+
+  pthread_mutex_lock(&poolMutex);
+  for (map<unsigned long, vector<void *> >::iterator it = freeBuffers.begin();
+       it != freeBuffers.end(); it++) {
+
+    for (unsigned i=0; i < it->second.size(); i++) {
+      munmap(it->second[i], it->first);
+      bufferSizes.erase(it->second[i]);
+    }
+    it->second.clear();
+  }
+  pthread_mutex_unlock(&poolMutex);
+}
@@ -38,6 +38,29 @@ class App {
   static unsigned long getSafeTransferSize(unsigned long elements,
 					   unsigned int bytesPerElement);
 
+  /** \brief Gets a transfer buffer of at least numBytes from the buffer pool.
+   *
+   * Buffers are page aligned, locked in memory and rounded up to a safe
+   * transfer size. Released buffers stay in the pool and are handed out
+   * again for requests of the same size class (a power of two pages), so
+   * repeated transfers do no allocation and take no page faults. Buffers
+   * must be returned with releaseBuffer(), not free() or delete.
+   */
+
+  static void *allocBuffer(unsigned long numBytes);
+  static void releaseBuffer(void *buffer);
+
+  /** \brief Backs buffers allocated from now on with huge pages, falling
+   *         back to normal pages if none are reserved.
+   */
+
+  static void setHugePages(bool enable);
+
+  /** \brief Unmaps the released buffers held by the pool.
+   */
+
+  static void freeBufferPool();
+
  protected:
   Board &board;
   
@@ -74,12 +97,11 @@ class App {
 template <class T>
 void App::read(T& data, unsigned long addr, MemId memId) {
   
-  unsigned long numWords = (unsigned long) ceil(sizeof(T)/(float) sizeof(boardWord_t));
-  boardWord_t *temp = new boardWord_t[numWords];
+  const unsigned long numWords = (sizeof(T)+sizeof(boardWord_t)-1)/sizeof(boardWord_t);
+  boardWord_t temp[numWords];
   bool ok;
   ok = board.read((boardWord_t*)temp, addr, numWords);
   memcpy(&data, temp, sizeof(T));
-  delete[] temp;
   if (!ok) throw "Failure in App::read()";    
 }
 
@@ -96,12 +118,11 @@ void App::read(T *data, unsigned long addr, unsigned long size, MemId memId) {
 template <class T>
 void App::write(const T &data, unsigned long addr, MemId memId) {
 
-  unsigned long numWords = (unsigned long) ceil(sizeof(T)/(float) sizeof(boardWord_t));
-  boardWord_t *temp = new boardWord_t[numWords];
+  const unsigned long numWords = (sizeof(T)+sizeof(boardWord_t)-1)/sizeof(boardWord_t);
+  boardWord_t temp[numWords];
   memcpy(temp, &data, sizeof(T));
   bool ok = false;  
   ok = board.write((boardWord_t*)temp, addr, numWords);
-  delete[] temp;
   if (!ok) throw "Failure in App::write()";
 }
 
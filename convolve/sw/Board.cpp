@@ -31,7 +31,9 @@ using namespace std;
 #define CLK3 "fclk3"
 */
 
-Board::Board(const char *bitfile, const vector<float> &clocks) : PAGE_SIZE(sysconf(_SC_PAGESIZE)) {
+Board::Board(const char *bitfile, const vector<float> &clocks,
+             unsigned long baseAddr, unsigned long addrSpace) :
+  PAGE_SIZE(sysconf(_SC_PAGESIZE)), baseAddr(baseAddr), addrSpace(addrSpace) {
 
   if (clocks.size() != NUM_FPGA_CLOCKS) {
 
@@ -46,6 +48,19 @@ Board::Board(const char *bitfile, const vector<float> &clocks) : PAGE_SIZE(sysco
 }
 
 
+Board::Board(unsigned long baseAddr, unsigned long addrSpace) :
+  PAGE_SIZE(sysconf(_SC_PAGESIZE)), baseAddr(baseAddr), addrSpace(addrSpace) {
+
+  initializeMemoryMap();
+}
+
+
+Board::Board() : PAGE_SIZE(sysconf(_SC_PAGESIZE)), mmapPages(NULL),
+                 baseAddr(0), addrSpace(0) {
+
+}
+
+
 Board::~Board() {
 
   delete mmapPages;
@@ -194,7 +209,7 @@ void Board::initializeMemoryMap() {
   //this->pageSize=sysconf(_SC_PAGESIZE);
 
   // calculate the number of pages required for the memory-map address space
-  unsigned numPages = (MEM_INT_ADDR_SPACE * (MMAP_DATA_WIDTH/8)) / PAGE_SIZE;
+  unsigned numPages = (addrSpace * (MMAP_DATA_WIDTH/8)) / PAGE_SIZE;
   mmapPages = new unsigned*[numPages];
 
   // save a ptr to the start of each page.
@@ -202,7 +217,7 @@ void Board::initializeMemoryMap() {
   // in physical memory.
   for (unsigned i=0; i < numPages; i++) {
 
-    unsigned startAddr = AXI_MMAP_ADDR+i*PAGE_SIZE;
+    unsigned startAddr = baseAddr+i*PAGE_SIZE;
     unsigned pageAddr = (startAddr & (~(PAGE_SIZE-1)));
     unsigned pageOffset = startAddr - pageAddr;
 
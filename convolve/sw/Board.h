@@ -9,9 +9,12 @@
 #include <string>
 #include <vector>
 
-// starting address of AXI memory map
+// default starting address of AXI memory map
 #define AXI_MMAP_ADDR 0x43c00000
 
+// distance between the memory maps of consecutive accelerator cores
+#define AXI_MMAP_STRIDE MEM_INT_ADDR_SPACE
+
 // total size in bytes of memory-map address space
 #define MEM_INT_ADDR_SPACE (1 << 20)
 
@@ -33,7 +36,12 @@ typedef unsigned boardWord_t;
 class Board {
 
  public:
-  Board(const char *bitfile, const std::vector<float> &frequencies);
+  Board(const char *bitfile, const std::vector<float> &frequencies,
+        unsigned long baseAddr=AXI_MMAP_ADDR,
+        unsigned long addrSpace=MEM_INT_ADDR_SPACE);
+
+  // maps another core of an FPGA that has already been programmed
+  Board(unsigned long baseAddr, unsigned long addrSpace=MEM_INT_ADDR_SPACE);
   virtual ~Board();
   
   virtual bool write(unsigned *data, unsigned long addr, unsigned long words);
@@ -49,6 +57,14 @@ class Board {
   // pointer to each page used in the memory-mapped AXI address space.
   unsigned **mmapPages;
 
+  // starting address and size of this board's memory map
+  unsigned long baseAddr;
+  unsigned long addrSpace;
+
+  // used by derived boards (e.g. emulators, decorators) that don't access
+  // the FPGA directly
+  Board();
+
   void copy(const char *to, const char *from);
   void loadBitfile(const char* bitfile);
   void writeToDriver(std::string file, std::string data) const;
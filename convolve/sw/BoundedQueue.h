@@ -0,0 +1,107 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <deque>
+#include <pthread.h>
+
+/** \brief Blocking FIFO with a maximum depth, used between pipeline stages.
+ *
+ * push() blocks while the queue is full and pop() blocks while it is
+ * empty. After close(), pop() drains the remaining items and then returns
+ * false.
+ */
+
+template <class T>
+class BoundedQueue {
+
+ public:
+  BoundedQueue(unsigned depth);
+  ~BoundedQueue();
+
+  void push(const T &item);
+  bool pop(T &item);
+  void close();
+
+  unsigned getDepth() const;
+
+ protected:
+  std::deque<T> items;
+  unsigned depth;
+  bool closed;
+  pthread_mutex_t mutex;
+  pthread_cond_t notFull;
+  pthread_cond_t notEmpty;
+};
+
+
+template <class T>
+BoundedQueue<T>::BoundedQueue(unsigned depth) : depth(depth > 0 ? depth : 1), closed(false) {
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&notFull, NULL);
+  pthread_cond_init(&notEmpty, NULL);
+}
+
+
+template <class T>
+BoundedQueue<T>::~BoundedQueue() {
+
+  pthread_cond_destroy(&notEmpty);
+  pthread_cond_destroy(&notFull);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+template <class T>
+void BoundedQueue<T>::push(const T &item) {
+
+  pthread_mutex_lock(&mutex);
+  while (items.size() >= depth && !closed) {
+    pthread_cond_wait(&notFull, &mutex);
+  }
+  items.push_back(item);
+  pthread_cond_signal(&notEmpty);
+  pthread_mutex_unlock(&mutex);
+}
+
+
+template <class T>
+bool BoundedQueue<T>::pop(T &item) {
+
+  pthread_mutex_lock(&mutex);
+  while (items.empty() && !closed) {
+    pthread_cond_wait(&notEmpty, &mutex);
+  }
+
+  bool ok = !items.empty();
+  if (ok) {
+    item = items.front();
+    items.pop_front();
+    pthread_cond_signal(&notFull);
+  }
+  pthread_mutex_unlock(&mutex);
+  return ok;
+}
+
+
+template <class T>
+void BoundedQueue<T>::close() {
+
+  pthread_mutex_lock(&mutex);
+  closed = true;
+  pthread_cond_broadcast(&notEmpty);
+  pthread_cond_broadcast(&notFull);
+  pthread_mutex_unlock(&mutex);
+}
+
+
+template <class T>
+unsigned BoundedQueue<T>::getDepth() const {
+
+  return depth;
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <cstring>
 
 #include "Convolve.h"
 
@@ -59,83 +60,503 @@ ostream & operator<<(ostream& stream, const Kernel &k) {
 }
 
 
-Signal::Signal(const appWord_t *signal, unsigned int size) {
-
-  this->unpaddedSize = size;
-  this->size = size+2*(Convolve::MAX_KERNEL_SIZE-1);
-  this->signal = new appWord_t [this->size];
+Convolve::Convolve(Board &board) : App(board), residentSize(0), resident(false),
+                                   kernelLoaded(false), eventLimit(0) {
+  
+}
 
-  // pad the original signal based on the maximum kernel size that can
-  // be handled by the FPGA
+Convolve::~Convolve() {
   
-  for (unsigned i=0,j=0; i < this->size; i++) {
-      
-      if (i < Convolve::MAX_KERNEL_SIZE-1 || i >= size+Convolve::MAX_KERNEL_SIZE-1) {
-          this->signal[i] = 0;
+}
+
+void Convolve::start(const appWord_t *signal, unsigned int signalSize,
+                     const appWord_t *kernel, unsigned int kernelSize) {
+
+  startPadded(signal, signalSize, kernel, kernelSize);
+}
+
+
+void Convolve::start(const unsigned char *signal, unsigned int signalSize,
+                     const appWord_t *kernel, unsigned int kernelSize) {
+
+  startPadded(signal, signalSize, kernel, kernelSize);
+}
+
+
+void Convolve::start(const float *signal, unsigned int signalSize,
+                     const appWord_t *kernel, unsigned int kernelSize,
+                     const Quantizer &quantizer) {
+
+  startPadded(signal, signalSize, kernel, kernelSize, &quantizer);
+}
+
+
+void Convolve::start(const int *signal, unsigned int signalSize,
+                     const appWord_t *kernel, unsigned int kernelSize,
+                     const Quantizer &quantizer) {
+
+  startPadded(signal, signalSize, kernel, kernelSize, &quantizer);
+}
+
+
+void Convolve::startLoadedKernel(const appWord_t *signal, unsigned int signalSize) {
+
+  assert(signal != NULL);
+
+  if (!kernelLoaded) {
+    cerr << "Error: no kernel has been loaded" << endl;
+    throw 1;
+  }
+
+  loadPadded(signal, signalSize);
+  write(1, GO_ADDR);
+}
+
+
+bool Convolve::isKernelLoaded() const {
+
+  return kernelLoaded;
+}
+
+
+void Convolve::loadSignal(const appWord_t *signal, unsigned int signalSize) {
+
+  loadPadded(signal, signalSize);
+}
+
+
+void Convolve::loadSignal(const unsigned char *signal, unsigned int signalSize) {
+
+  loadPadded(signal, signalSize);
+}
+
+
+void Convolve::loadSignal(const float *signal, unsigned int signalSize,
+                          const Quantizer &quantizer) {
+
+  loadPadded(signal, signalSize, &quantizer);
+}
+
+
+void Convolve::loadSignal(const int *signal, unsigned int signalSize,
+                          const Quantizer &quantizer) {
+
+  loadPadded(signal, signalSize, &quantizer);
+}
+
+
+void Convolve::startResident(const appWord_t *kernel, unsigned int kernelSize) {
+
+  assert(kernel != NULL);
+
+  if (!resident) {
+    cerr << "Error: no signal is resident in RAM0" << endl;
+    throw 1;
+  }
+
+  Kernel paddedKernel(kernel, kernelSize);
+
+  // reset the pipeline but keep the padded signal from the last upload
+  write(1 | RST_KEEP_SIGNAL, RST_ADDR);
+  write(residentSize, SIGNAL_SIZE_ADDR);
+  write(1, DECIMATE_ADDR);
+  writeKernel(paddedKernel);
+  write(1, GO_ADDR);
+}
+
+
+void Convolve::startDecimated(const appWord_t *signal, unsigned int signalSize,
+                              const appWord_t *kernel, unsigned int kernelSize,
+                              unsigned int factor) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+
+  if (factor == 0 || factor > MAX_DECIMATION) {
+    cerr << "Error: decimation factors must be between 1 and " << MAX_DECIMATION << endl;
+    throw 1;
+  }
+
+  Kernel paddedKernel(kernel, kernelSize);
+
+  loadPadded(signal, signalSize);
+
+  // like without decimation, the FPGA writes the outputs of the padded
+  // kernel, and software only reads the real ones
+  unsigned kept = getDecimatedSize(signalSize+MAX_KERNEL_SIZE-1, factor);
+  write((kept << DECIMATE_FACTOR_BITS) | factor, DECIMATE_ADDR);
+  writeKernel(paddedKernel);
+  write(1, GO_ADDR);
+}
+
+
+void Convolve::convolveInterpolated(const appWord_t *signal, unsigned int signalSize,
+                                    const appWord_t *kernel, unsigned int kernelSize,
+                                    unsigned int factor, appWord_t *output) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+  assert(output != NULL);
+  assert(factor > 0);
+
+  const unsigned outputSize = signalSize*factor+kernelSize-1;
+  appWord_t subkernel[MAX_KERNEL_SIZE];
+  appWord_t *scratch = (appWord_t *) allocBuffer(getSafeTransferSize(signalSize+kernelSize-1, sizeof(appWord_t)));
+
+  // phases without any taps, and the end of every phase, are 0
+  memset(output, 0, outputSize*sizeof(appWord_t));
+
+  try {
+    loadSignal(signal, signalSize);
+
+    // output q*factor+p = (signal * taps p, p+factor, ...)[q]
+    for (unsigned p=0; p < factor && p < kernelSize; p++) {
+
+      unsigned size = 0;
+      for (unsigned j=p; j < kernelSize; j += factor) {
+        subkernel[size++] = kernel[j];
       }
-      else {
-          this->signal[i] = signal[j++];
-      }      
+
+      startResident(subkernel, size);
+      while (!isDone());
+      getOutput(scratch, signalSize+size-1);
+
+      for (unsigned q=0; q < signalSize+size-1; q++) {
+        output[q*factor+p] = scratch[q];
+      }
+    }
   }
-  
-  allocated = true;  
+  catch(...) {
+    releaseBuffer(scratch);
+    throw;
+  }
+
+  releaseBuffer(scratch);
 }
 
-Signal::~Signal() {
 
-  if (allocated)
-     delete signal;
+unsigned int Convolve::getDecimatedSize(unsigned int outputSize, unsigned int factor) {
+
+  return (outputSize+factor-1)/factor;
 }
 
-unsigned int Signal::getSize() const {
-  return size;
+
+void Convolve::convolveCascade(const appWord_t *signal, unsigned int signalSize,
+                               const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                               unsigned int numKernels, appWord_t *output) {
+
+  assert(signal != NULL);
+  assert(kernels != NULL);
+  assert(kernelSizes != NULL);
+  assert(output != NULL);
+  assert(numKernels > 0);
+
+  // the signal of the last stage is the largest
+  unsigned lastSize = getCascadeSize(signalSize, kernelSizes, numKernels-1);
+  if (lastSize > MAX_CASCADE_SIGNAL_SIZE) {
+    cerr << "Error: cascaded signals can be at most " << MAX_CASCADE_SIGNAL_SIZE
+         << " samples, but stage " << numKernels-1 << " needs " << lastSize << endl;
+    throw 1;
+  }
+
+  loadPadded(signal, signalSize);
+
+  // the signal of each stage is in one half of RAM0, and its outputs go to
+  // the other
+  unsigned size = signalSize;
+  unsigned long in = 0;
+
+  for (unsigned i=0; i < numKernels; i++) {
+
+    Kernel paddedKernel(kernels[i], kernelSizes[i]);
+    unsigned long out = in == 0 ? BANK_WORDS : 0;
+
+    if (i > 0) {
+      write(1 | RST_KEEP_SIGNAL, RST_ADDR);
+      write(size, SIGNAL_SIZE_ADDR);
+      write((unsigned) in, SIGNAL_ADDR_ADDR);
+    }
+
+    if (i < numKernels-1)
+      write((unsigned) ((out << 1) | CASCADE_ENABLE), CASCADE_ADDR);
+
+    writeKernel(paddedKernel);
+    write(1, GO_ADDR);
+    while (!isDone());
+
+    size += kernelSizes[i]-1;
+    in = out;
+  }
+
+  // RAM0 no longer starts with the uploaded signal
+  resident = false;
+  getOutput(output, size);
 }
 
-unsigned int Signal::getUnpaddedSize() const {
-  return unpaddedSize;
+
+void Convolve::startThreshold(const appWord_t *signal, unsigned int signalSize,
+                              const appWord_t *kernel, unsigned int kernelSize,
+                              appWord_t threshold, unsigned int maxEvents) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+
+  if (maxEvents == 0 || maxEvents > MAX_EVENTS) {
+    cerr << "Error: the maximum number of events must be between 1 and " << MAX_EVENTS << endl;
+    throw 1;
+  }
+
+  // every output index has to fit in the low half of an event
+  if (signalSize > MAX_THRESHOLD_SIGNAL_SIZE) {
+    cerr << "Error: threshold detection can't handle signals larger than " << MAX_THRESHOLD_SIGNAL_SIZE << endl;
+    throw 1;
+  }
+
+  Kernel paddedKernel(kernel, kernelSize);
+
+  loadPadded(signal, signalSize);
+  write((maxEvents << THRESHOLD_MAX_EVENTS_SHIFT) | threshold, THRESHOLD_ADDR);
+  writeKernel(paddedKernel);
+  write(1, GO_ADDR);
+  eventLimit = maxEvents;
 }
 
-appWord_t *Signal::getSignal() const {
-  return signal;
+
+unsigned int Convolve::getEventCount() {
+
+  unsigned int count;
+  read(count, EVENT_COUNT_ADDR);
+  return count;
 }
 
-ostream & operator<<(ostream& stream, const Signal &s) {
-  
-  for (unsigned i=0; i < s.getSize(); i++) {   
-    stream << s.signal[i] << " ";
+
+unsigned int Convolve::getEvents(OutputEvent *events) {
+
+  assert(events != NULL);
+
+  unsigned int count = getEventCount();
+  unsigned int stored = count < eventLimit ? count : eventLimit;
+  if (stored == 0) return count;
+
+  // each event is a whole word: the index, then the value
+  appWord_t *words = (appWord_t *) allocBuffer(getSafeTransferSize(2*stored, sizeof(appWord_t)));
+  try {
+    readOutput(words, 2*stored, 0);
   }
-  return stream;
+  catch(...) {
+    releaseBuffer(words);
+    throw;
+  }
+
+  for (unsigned i=0; i < stored; i++) {
+    events[i].index = words[2*i];
+    events[i].value = words[2*i+1];
+  }
+
+  releaseBuffer(words);
+  return count;
 }
 
 
-Convolve::Convolve(Board &board) : App(board) {
-  
+unsigned int Convolve::getCascadeSize(unsigned int signalSize, const unsigned int *kernelSizes,
+                                      unsigned int numKernels) {
+
+  unsigned size = signalSize;
+  for (unsigned i=0; i < numKernels; i++) {
+    size += kernelSizes[i]-1;
+  }
+  return size;
 }
 
-Convolve::~Convolve() {
-  
+
+void Convolve::filterBank(const appWord_t *signal, unsigned int signalSize,
+                          const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                          unsigned int numKernels, appWord_t * const *outputs) {
+
+  loadSignal(signal, signalSize);
+
+  for (unsigned i=0; i < numKernels; i++) {
+
+    startResident(kernels[i], kernelSizes[i]);
+    while (!isDone());
+    getOutput(outputs[i], signalSize+kernelSizes[i]-1);
+  }
 }
 
-void Convolve::start(const appWord_t *signal, unsigned int signalSize, 
-                     const appWord_t *kernel, unsigned int kernelSize) {
+
+void Convolve::convolveStaged(const appWord_t *signal, unsigned long signalSize,
+                              const appWord_t *kernel, unsigned int kernelSize,
+                              appWord_t *output, unsigned int windowSize) {
 
   assert(signal != NULL);
   assert(kernel != NULL);
+  assert(output != NULL);
+
+  // each window overlaps the previous one by the padded kernel size-1, so
+  // that all of its outputs except the first overlap ones are complete
+  const unsigned overlap = MAX_KERNEL_SIZE-1;
+
+  if (windowSize > MAX_SIGNAL_SIZE) windowSize = MAX_SIGNAL_SIZE;
+  if (windowSize < overlap+2) {
+    cerr << "Error: staged windows must be larger than " << overlap+1 << " samples" << endl;
+    throw 1;
+  }
+
+  // windows are read from word addresses, so the distance between window
+  // starts has to be even
+  const unsigned length = windowSize-(windowSize-overlap)%2;
+  const unsigned long outputSize = signalSize+kernelSize-1;
 
-  Signal paddedSignal(signal, signalSize);
   Kernel paddedKernel(kernel, kernelSize);
+  appWord_t *scratch = (appWord_t *) allocBuffer(getSafeTransferSize(MAX_OUTPUT_SIZE, sizeof(appWord_t)));
+
+  // samples [segStart, segEnd) of the signal are staged in RAM0
+  unsigned long segStart = 0, segEnd = 0;
+  bool staged = false;
+
+  try {
+    write(0, BANK_ADDR);
+    write(1, DECIMATE_ADDR);
+
+    for (unsigned long start=0; ; start += length-overlap) {
 
-//  cout << "Signal = " << paddedSignal << endl;
-//  cout << "Kernel = " << paddedKernel << endl;
+      unsigned long end = start+length < signalSize ? start+length : signalSize;
 
-  start(paddedSignal, paddedKernel);
+      if (!staged || end > segEnd) {
+
+        // stage the next segment starting at this window. The kernel buffer
+        // is only cleared by a global reset, so it is sent once.
+        segStart = start;
+        segEnd = start+MAX_SIGNAL_SIZE < signalSize ? start+MAX_SIGNAL_SIZE : signalSize;
+        resident = false;
+        write(1, RST_ADDR);
+        writeSignal(signal+segStart, segEnd-segStart);
+        if (!staged) writeKernel(paddedKernel);
+        staged = true;
+      }
+
+      // the FPGA pads every window with zeros, so only outputs that don't
+      // depend on that padding are kept, except at the ends of the signal
+      unsigned long first = start == 0 ? 0 : start+overlap;
+      unsigned long last = end == signalSize ? outputSize : end;
+
+      write(1 | RST_KEEP_SIGNAL, RST_ADDR);
+      write(end-start, SIGNAL_SIZE_ADDR);
+      write((start-segStart)/2, SIGNAL_ADDR_ADDR);
+      write(1, GO_ADDR);
+      while (!isDone());
+
+      if (last > first) {
+        getOutput(scratch, last-start);
+        memcpy(output+first, scratch+(first-start), (last-first)*sizeof(appWord_t));
+      }
+
+      if (end == signalSize) break;
+    }
+  }
+  catch(...) {
+    releaseBuffer(scratch);
+    throw;
+  }
+
+  releaseBuffer(scratch);
+}
+
+
+void Convolve::runPipelined(const appWord_t * const *signals, const unsigned int *signalSizes,
+                            const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                            unsigned int numJobs, appWord_t * const *outputs) {
+
+  for (unsigned i=0; i < numJobs; i++) {
+    if (signalSizes[i] > MAX_BANK_SIGNAL_SIZE) {
+      cerr << "Error: pipelined jobs can't have signals larger than " << MAX_BANK_SIGNAL_SIZE << endl;
+      throw 1;
+    }
+  }
+
+  if (numJobs == 0) return;
+
+  // nothing can overlap the upload of the first job
+  resident = false;
+  write(1, RST_ADDR);
+  write(1, DECIMATE_ADDR);
+  writeSignal(signals[0], signalSizes[0], 0);
+
+  for (unsigned i=0; i < numJobs; i++) {
+
+    Kernel paddedKernel(kernels[i], kernelSizes[i]);
+
+    // the kernel can only change once the previous job is done. A reset
+    // that keeps the signal doesn't stop the DMA transfers of the other bank.
+    write(1 | RST_KEEP_SIGNAL, RST_ADDR);
+    write(signalSizes[i], SIGNAL_SIZE_ADDR);
+    write(0, SIGNAL_ADDR_ADDR);
+    write(i%2, BANK_ADDR);
+    writeKernel(paddedKernel);
+    write(1, GO_ADDR);
+
+    // fill and drain the other bank while job i computes
+    unsigned long other = ((i+1)%2)*BANK_WORDS;
+    if (i+1 < numJobs)
+      writeSignal(signals[i+1], signalSizes[i+1], other);
+    if (i > 0)
+      readOutput(outputs[i-1], signalSizes[i-1]+kernelSizes[i-1]-1, other);
+
+    while (!isDone());
+  }
+
+  unsigned last = numJobs-1;
+  readOutput(outputs[last], signalSizes[last]+kernelSizes[last]-1, (last%2)*BANK_WORDS);
 }
 
 
 void Convolve::getOutput(appWord_t *output, unsigned int outputSize) {
   
+  readOutput(output, outputSize, 0);
+}
+
+
+void Convolve::getOutput(float *output, unsigned int outputSize, const Quantizer &quantizer) {
+
   assert(output != NULL);
-  unsigned config = (outputSize << ADDR_WIDTH) | 0;
+  appWord_t chunk[UPLOAD_CHUNK];
+
+  // every block but the last is even, so each one starts on a word
+  for (unsigned pos=0; pos < outputSize; pos += UPLOAD_CHUNK) {
+
+    unsigned n = outputSize-pos < UPLOAD_CHUNK ? outputSize-pos : UPLOAD_CHUNK;
+    readOutput(chunk, n, pos/2);
+    quantizer.dequantize(chunk, n, output+pos);
+  }
+}
+
+
+void Convolve::getOutputRange(appWord_t *output, unsigned int begin, unsigned int end) {
+
+  assert(output != NULL);
+  if (end <= begin) return;
+
+  // RAM1 is read in whole words
+  unsigned skip = begin % 2;
+  readOutput(output, end-begin+skip, begin/2);
+  if (skip) memmove(output, output+1, (end-begin)*sizeof(appWord_t));
+}
+
+
+unsigned int Convolve::getOutput(appWord_t *output, unsigned int signalSize,
+                                 unsigned int kernelSize, OutputMode mode) {
+
+  unsigned begin, end;
+  ::getOutputRange(mode, signalSize, kernelSize, begin, end);
+  getOutputRange(output, begin, end);
+  return end-begin;
+}
+
+
+void Convolve::readOutput(appWord_t *output, unsigned int outputSize, unsigned long wordAddr) {
+
+  assert(output != NULL);
+  unsigned config = (outputSize << ADDR_WIDTH) | wordAddr;
   write(config, RAM1_CONFIG_ADDR);
   read(output, 0, outputSize);
 }
@@ -149,23 +570,27 @@ bool Convolve::isDone() {
 }
 
 
-void Convolve::start(Signal &signal, Kernel &kernel) {
+void Convolve::packChunk(const float *signal, unsigned int n, appWord_t *chunk,
+                         const Quantizer *quantizer) {
 
-  write(1, RST_ADDR);
+  assert(quantizer != NULL);
+  quantizer->quantize(signal, n, chunk);
+}
 
-  // send signal to input RAM
-  unsigned config = (signal.getSize() << ADDR_WIDTH) | 0;
-  write(config, RAM0_CONFIG_ADDR);
-  write(signal.getSignal(), 0, signal.getSize());
 
-  // send the unpadded signal size
-  write(signal.getUnpaddedSize(), SIGNAL_SIZE_ADDR);
+void Convolve::packChunk(const int *signal, unsigned int n, appWord_t *chunk,
+                         const Quantizer *quantizer) {
 
-  // send the kernel
+  assert(quantizer != NULL);
+  quantizer->quantize(signal, n, chunk);
+}
+
+
+void Convolve::writeKernel(const Kernel &kernel) {
+
+  kernelLoaded = false;
   for (unsigned i=0; i < kernel.getSize(); i++) {
       write(kernel.getKernel()[i], KERNEL_DATA_ADDR);
   }
-  
-  write(1, GO_ADDR); 
+  kernelLoaded = true;
 }
-
@@ -4,14 +4,28 @@
 #ifndef _CONVOLVE_H_
 #define _CONVOLVE_H_
 
+#include <cassert>
+
 #include "App.h"
+#include "OutputMode.h"
+#include "Quantizer.h"
+#include "OutputEvent.h"
 
 #define ADDR_WIDTH 15
 #define RAM_WORDS (1 << ADDR_WIDTH)
 #define RAM_BYTES RAM_WORDS*4
 
+// words in each half of RAM0 and RAM1 selected by BANK_ADDR
+#define BANK_WORDS (RAM_WORDS/2)
+
 #define MEM_IN_ADDR 0
 #define MEM_OUT_ADDR 0
+#define EVENT_COUNT_ADDR ((1<<MMAP_ADDR_WIDTH)-14)
+#define THRESHOLD_ADDR ((1<<MMAP_ADDR_WIDTH)-13)
+#define CASCADE_ADDR ((1<<MMAP_ADDR_WIDTH)-12)
+#define DECIMATE_ADDR ((1<<MMAP_ADDR_WIDTH)-11)
+#define BANK_ADDR ((1<<MMAP_ADDR_WIDTH)-10)
+#define SIGNAL_ADDR_ADDR ((1<<MMAP_ADDR_WIDTH)-9)
 #define RAM0_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-8)
 #define RAM1_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-7)
 #define GO_ADDR ((1<<MMAP_ADDR_WIDTH)-6)
@@ -21,6 +35,24 @@
 #define SIGNAL_SIZE_ADDR ((1<<MMAP_ADDR_WIDTH)-2)
 #define DONE_ADDR ((1<<MMAP_ADDR_WIDTH)-1)
 
+// written to RST_ADDR along with bit 0 to reset the convolution without
+// clearing the signal in RAM0
+#define RST_KEEP_SIGNAL 0x2
+
+// a DECIMATE_ADDR write holds the factor in its low DECIMATE_FACTOR_BITS
+// bits and the number of outputs kept above them
+#define DECIMATE_FACTOR_BITS 8
+
+// a CASCADE_ADDR write of (wordAddr << 1) | CASCADE_ENABLE makes the next
+// go also write its outputs to RAM0 from wordAddr on, so they can be the
+// signal of the next stage. Every RST_ADDR write disables it.
+#define CASCADE_ENABLE 0x1
+
+// a THRESHOLD_ADDR write holds the threshold in its low 16 bits and the
+// maximum number of events above them. A maximum of 0 (also set by every
+// RST_ADDR write) turns detection off.
+#define THRESHOLD_MAX_EVENTS_SHIFT 16
+
 
 typedef unsigned short appWord_t;
 
@@ -42,26 +74,6 @@ class Kernel {
 };
 
 
-class Signal {
-  
- public:
-  Signal(const appWord_t *signal, unsigned int size);
-  ~Signal();
-
-  unsigned int getSize() const;
-  unsigned int getUnpaddedSize() const;
-  appWord_t *getSignal() const;
-
-  friend std::ostream & operator<<(std::ostream& stream, const Signal &s );
-
- protected:
-  appWord_t *signal;
-  unsigned int size;
-  unsigned int unpaddedSize;
-  bool allocated;
-};
-
-
 class Convolve : public App {
 
  public:  
@@ -72,17 +84,281 @@ class Convolve : public App {
   bool isDone();  
   void start(const appWord_t *signal, unsigned int signalSize,
              const appWord_t *kernel, unsigned int kernelSize);
+  void start(const unsigned char *signal, unsigned int signalSize,
+             const appWord_t *kernel, unsigned int kernelSize);
   void getOutput(appWord_t *output, unsigned int outputSize);
 
+  /** \brief Quantizing front end for real-valued signals.
+   *
+   * Each UPLOAD_CHUNK-sample block is quantized straight into the block
+   * that is sent to RAM0, so there is no separate conversion pass and no
+   * copy of the whole signal. The float getOutput() reads RAM1 back in
+   * blocks and dequantizes each one with its own quantizer, which is
+   * normally different from the input's since the outputs are sums of
+   * products.
+   */
+  void start(const float *signal, unsigned int signalSize,
+             const appWord_t *kernel, unsigned int kernelSize,
+             const Quantizer &quantizer);
+  void start(const int *signal, unsigned int signalSize,
+             const appWord_t *kernel, unsigned int kernelSize,
+             const Quantizer &quantizer);
+  void getOutput(float *output, unsigned int outputSize, const Quantizer &quantizer);
+
+  /** \brief Reads back only outputs [begin, end) into output[0], ....
+   *
+   * RAM1's readback starts at the word that holds output begin, so the
+   * other outputs never cross the bus. If begin is odd, the sample before
+   * it is read as well and dropped, so output needs room for a safe
+   * transfer of end-begin+1 samples.
+   */
+  void getOutputRange(appWord_t *output, unsigned int begin, unsigned int end);
+
+  // reads back the outputs kept by mode and returns how many there are
+  unsigned int getOutput(appWord_t *output, unsigned int signalSize,
+                         unsigned int kernelSize, OutputMode mode);
+
+  // like start(), but keeps the kernel from the last start(), which isn't
+  // cleared by RST_ADDR
+  void startLoadedKernel(const appWord_t *signal, unsigned int signalSize);
+  bool isKernelLoaded() const;
+
+  /** \brief Uploads a signal that stays resident in RAM0.
+   *
+   * The resident signal can then be convolved with any number of kernels
+   * by startResident(), which only sends the kernel. start() also leaves
+   * its signal resident.
+   */
+  void loadSignal(const appWord_t *signal, unsigned int signalSize);
+  void loadSignal(const unsigned char *signal, unsigned int signalSize);
+  void loadSignal(const float *signal, unsigned int signalSize, const Quantizer &quantizer);
+  void loadSignal(const int *signal, unsigned int signalSize, const Quantizer &quantizer);
+  void startResident(const appWord_t *kernel, unsigned int kernelSize);
+
+  /** \brief Like start(), but the FPGA only writes outputs 0, factor,
+   *  2*factor, ... to RAM1, so getOutput() only reads back the
+   *  getDecimatedSize(signalSize+kernelSize-1, factor) outputs that are kept.
+   */
+  void startDecimated(const appWord_t *signal, unsigned int signalSize,
+                      const appWord_t *kernel, unsigned int kernelSize,
+                      unsigned int factor);
+
+  /** \brief Convolves the signal upsampled by factor (factor-1 zeros after
+   *  every sample) with the kernel.
+   *
+   * The signal is uploaded once and convolved with each of the polyphase
+   * subkernels (taps p, p+factor, ...), whose outputs are interleaved, so
+   * the zeros are never sent or multiplied. output needs room for
+   * signalSize*factor+kernelSize-1 samples.
+   */
+  void convolveInterpolated(const appWord_t *signal, unsigned int signalSize,
+                            const appWord_t *kernel, unsigned int kernelSize,
+                            unsigned int factor, appWord_t *output);
+
+  static unsigned int getDecimatedSize(unsigned int outputSize, unsigned int factor);
+
+  /** \brief Convolves the signal with kernels[0], the result with
+   *  kernels[1], and so on.
+   *
+   * Only the signal and the final outputs cross the bus. Each stage but the
+   * last has the FPGA loop its outputs back into the other half of RAM0,
+   * and the next stage keeps that signal and only sends its kernel. Every
+   * signal in the chain, i.e., signalSize plus the kernelSizes[i]-1 of the
+   * stages before it, can be at most MAX_CASCADE_SIGNAL_SIZE samples.
+   * output needs room for a safe transfer of getCascadeSize() samples.
+   */
+  void convolveCascade(const appWord_t *signal, unsigned int signalSize,
+                       const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                       unsigned int numKernels, appWord_t *output);
+
+  /** \brief Like start(), but the FPGA detects outputs above threshold.
+   *
+   * Instead of the outputs, RAM1 receives one 32-bit event (index in the
+   * low half, value in the high half) per output above the threshold, for
+   * at most maxEvents (up to MAX_EVENTS) of them, and EVENT_COUNT_ADDR
+   * counts every output above it. getEvents() then reads back only the
+   * stored events.
+   */
+  void startThreshold(const appWord_t *signal, unsigned int signalSize,
+                      const appWord_t *kernel, unsigned int kernelSize,
+                      appWord_t threshold, unsigned int maxEvents);
+
+  // outputs above the threshold of the last startThreshold(), which can be
+  // more than the events stored
+  unsigned int getEventCount();
+
+  // reads back the stored events in index order and returns the number of
+  // outputs above the threshold. events needs room for maxEvents events.
+  unsigned int getEvents(OutputEvent *events);
+
+  static unsigned int getCascadeSize(unsigned int signalSize, const unsigned int *kernelSizes,
+                                     unsigned int numKernels);
+
+  // applies numKernels kernels to one signal, uploading the signal once.
+  // outputs[i] needs room for a safe transfer of signalSize+kernelSizes[i]-1
+  // samples.
+  void filterBank(const appWord_t *signal, unsigned int signalSize,
+                  const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                  unsigned int numKernels, appWord_t * const *outputs);
+
+  /** \brief Convolves a signal of any length that is staged in DRAM.
+   *
+   * The signal is uploaded to RAM0 (DRAM) once, in segments of at most
+   * MAX_SIGNAL_SIZE samples, and the FPGA convolves overlapping windows of
+   * up to windowSize samples by programming SIGNAL_ADDR_ADDR with the start
+   * of each window. Only the MAX_KERNEL_SIZE-1 samples shared by adjacent
+   * segments are sent twice. output needs room for signalSize+kernelSize-1
+   * samples.
+   */
+  void convolveStaged(const appWord_t *signal, unsigned long signalSize,
+                      const appWord_t *kernel, unsigned int kernelSize,
+                      appWord_t *output, unsigned int windowSize=MAX_SIGNAL_SIZE);
+
+  /** \brief Runs independent jobs with ping-pong buffering.
+   *
+   * Job i uses bank i%2, i.e., one half of RAM0 and RAM1. While job i
+   * computes, the signal of job i+1 is uploaded to the other half of RAM0
+   * and the outputs of job i-1 are read from the other half of RAM1, so
+   * only the kernel and a few registers are sent between jobs. Every signal
+   * can be at most MAX_BANK_SIGNAL_SIZE samples, and outputs[i] needs room
+   * for a safe transfer of signalSizes[i]+kernelSizes[i]-1 samples.
+   */
+  void runPipelined(const appWord_t * const *signals, const unsigned int *signalSizes,
+                    const appWord_t * const *kernels, const unsigned int *kernelSizes,
+                    unsigned int numJobs, appWord_t * const *outputs);
+
   // change this back to 128 for final test
   static const unsigned int MAX_KERNEL_SIZE = 4;
-  // make sure to leave enough room for pre- and post-padding
+  // the padding is added by the FPGA, but leave room for the outputs in RAM1
   static const unsigned int MAX_SIGNAL_SIZE = (RAM_BYTES/sizeof(appWord_t))-2*(MAX_KERNEL_SIZE-1)*sizeof(appWord_t);
   static const unsigned int MAX_OUTPUT_SIZE = RAM_BYTES/sizeof(appWord_t);
+  static const unsigned int MAX_BANK_SIGNAL_SIZE = MAX_SIGNAL_SIZE/2;
+  static const unsigned int MAX_DECIMATION = (1 << DECIMATE_FACTOR_BITS)-1;
+  // each stage writes all of its padded outputs to a half of RAM0
+  static const unsigned int MAX_CASCADE_SIGNAL_SIZE = 2*BANK_WORDS-(MAX_KERNEL_SIZE-1);
+  // one event per RAM1 word, with a 16-bit index
+  static const unsigned int MAX_EVENTS = RAM_WORDS;
+  static const unsigned int MAX_THRESHOLD_SIGNAL_SIZE = 0x10000-(MAX_KERNEL_SIZE-1);
   
 protected:
-  void start(Signal &signal, Kernel &kernel);
+  // size of the signal resident in RAM0, valid if resident is true
+  unsigned int residentSize;
+  bool resident;
+  bool kernelLoaded;
+
+  // maxEvents of the last startThreshold()
+  unsigned int eventLimit;
+
+  // quantizer is only used (and required) for float and int signals
+  template <class T>
+    void loadPadded(const T *signal, unsigned int signalSize,
+                    const Quantizer *quantizer=NULL);
+
+  template <class T>
+    void startPadded(const T *signal, unsigned int signalSize,
+                     const appWord_t *kernel, unsigned int kernelSize,
+                     const Quantizer *quantizer=NULL);
+
+  /** \brief Sends the unpadded signal to RAM0.
+   *
+   * The FPGA adds the MAX_KERNEL_SIZE-1 zeros on each side itself, so only
+   * the real samples are transferred. The signal is read directly from the
+   * caller's memory (e.g., a mapped file) and repacked in UPLOAD_CHUNK-sample
+   * blocks, so no copy of the whole signal is made.
+   */
+  template <class T>
+    void writeSignal(const T *signal, unsigned int size, unsigned long wordAddr=0,
+                     const Quantizer *quantizer=NULL);
+
+  // converts n samples into an upload block
+  template <class T>
+    static void packChunk(const T *signal, unsigned int n, appWord_t *chunk,
+                          const Quantizer *quantizer);
+  static void packChunk(const float *signal, unsigned int n, appWord_t *chunk,
+                        const Quantizer *quantizer);
+  static void packChunk(const int *signal, unsigned int n, appWord_t *chunk,
+                        const Quantizer *quantizer);
 
+  void writeKernel(const Kernel &kernel);
+  void readOutput(appWord_t *output, unsigned int outputSize, unsigned long wordAddr);
+
+  // samples repacked per RAM0 transfer. Must be even so that every block
+  // starts on a word boundary.
+  static const unsigned int UPLOAD_CHUNK = 1024;
 };
 
+
+template <class T>
+void Convolve::startPadded(const T *signal, unsigned int signalSize,
+                           const appWord_t *kernel, unsigned int kernelSize,
+                           const Quantizer *quantizer) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+
+  Kernel paddedKernel(kernel, kernelSize);
+
+  loadPadded(signal, signalSize, quantizer);
+  writeKernel(paddedKernel);
+  write(1, GO_ADDR);
+}
+
+
+template <class T>
+void Convolve::loadPadded(const T *signal, unsigned int signalSize,
+                          const Quantizer *quantizer) {
+
+  assert(signal != NULL);
+
+  if (signalSize > MAX_SIGNAL_SIZE) {
+    std::cerr << "Current FPGA implementation doesn't support signals larger than " << MAX_SIGNAL_SIZE << std::endl;
+    throw 1;
+  }
+
+  // a full reset doesn't preserve RAM0
+  resident = false;
+  write(1, RST_ADDR);
+  writeSignal(signal, signalSize, 0, quantizer);
+
+  // send the unpadded signal size, which starts at the beginning of RAM0
+  write(signalSize, SIGNAL_SIZE_ADDR);
+  write(0, SIGNAL_ADDR_ADDR);
+  write(0, BANK_ADDR);
+  write(1, DECIMATE_ADDR);
+
+  residentSize = signalSize;
+  resident = true;
+}
+
+
+template <class T>
+void Convolve::writeSignal(const T *signal, unsigned int size, unsigned long wordAddr,
+                           const Quantizer *quantizer) {
+
+  appWord_t chunk[UPLOAD_CHUNK];
+
+  unsigned config = (size << ADDR_WIDTH) | wordAddr;
+  write(config, RAM0_CONFIG_ADDR);
+
+  for (unsigned pos=0; pos < size; pos += UPLOAD_CHUNK) {
+
+    unsigned n = size-pos < UPLOAD_CHUNK ? size-pos : UPLOAD_CHUNK;
+    packChunk(signal+pos, n, chunk, quantizer);
+
+    // odd final blocks are sent as whole words; the extra sample is unused
+    if (n % 2) chunk[n] = 0;
+    write(chunk, MEM_IN_ADDR+pos/2, n);
+  }
+}
+
+
+template <class T>
+void Convolve::packChunk(const T *signal, unsigned int n, appWord_t *chunk,
+                         const Quantizer *quantizer) {
+
+  for (unsigned i=0; i < n; i++) {
+    chunk[i] = signal[i];
+  }
+}
+
 #endif
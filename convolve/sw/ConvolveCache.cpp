@@ -0,0 +1,421 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "ConvolveCache.h"
+
+using namespace std;
+
+ConvolveCache::ConvolveCache(Convolve &convolve, size_t byteBudget,
+                             const char *spillFile, size_t spillBytes) :
+  convolveHW(convolve), byteBudget(byteBudget), spillFd(-1), spillMap(NULL),
+  spillBytes(0), spillPos(0) {
+
+  memset(&stats, 0, sizeof(stats));
+
+  if (spillFile != NULL && spillBytes > 0) {
+
+    spillFd = open(spillFile, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (spillFd < 0 || ftruncate(spillFd, spillBytes) != 0) {
+      cerr << "Error: can't create " << spillFile << endl;
+      throw 1;
+    }
+
+    void *map = mmap(NULL, spillBytes, PROT_READ|PROT_WRITE, MAP_SHARED, spillFd, 0);
+    if (map == MAP_FAILED) {
+      close(spillFd);
+      cerr << "Error: can't map " << spillFile << endl;
+      throw 1;
+    }
+
+    spillMap = (unsigned char *) map;
+    this->spillBytes = spillBytes;
+  }
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  pthread_mutex_init(&deviceMutex, NULL);
+}
+
+
+ConvolveCache::~ConvolveCache() {
+
+  if (spillMap != NULL) {
+    munmap(spillMap, spillBytes);
+    close(spillFd);
+  }
+
+  pthread_mutex_destroy(&deviceMutex);
+  pthread_cond_destroy(&doneCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+bool ConvolveCache::Key::operator<(const Key &rhs) const {
+
+  if (signalHash != rhs.signalHash) return signalHash < rhs.signalHash;
+  if (kernelHash != rhs.kernelHash) return kernelHash < rhs.kernelHash;
+  if (signalSize != rhs.signalSize) return signalSize < rhs.signalSize;
+  if (kernelSize != rhs.kernelSize) return kernelSize < rhs.kernelSize;
+  return mode < rhs.mode;
+}
+
+
+// murmur3's 64-bit finalizer, so that every bit of a word affects every
+// bit of the result
+static inline uint64_t mix(uint64_t k) {
+
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+
+uint64_t ConvolveCache::hash(const appWord_t *data, unsigned long size) {
+
+  // FNV-1a over 64-bit words instead of bytes. Mixing each word first keeps
+  // the high bits of the words from only reaching the high bits of the
+  // hash, where two changes to the same bit would cancel.
+  const uint64_t prime = 0x100000001b3ull;
+  const unsigned samplesPerWord = sizeof(uint64_t)/sizeof(appWord_t);
+  uint64_t h = 0xcbf29ce484222325ull ^ size;
+  unsigned long i = 0;
+
+  for (; i+samplesPerWord <= size; i += samplesPerWord) {
+    uint64_t word;
+    memcpy(&word, data+i, sizeof(word));
+    h = (h ^ mix(word))*prime;
+  }
+
+  // the last samples are zero-extended to a word
+  if (i < size) {
+    uint64_t word = 0;
+    memcpy(&word, data+i, (size-i)*sizeof(appWord_t));
+    h = (h ^ mix(word))*prime;
+  }
+
+  return mix(h);
+}
+
+
+ConvolveCache::Stats ConvolveCache::getStats() {
+
+  pthread_mutex_lock(&mutex);
+  Stats copy = stats;
+  pthread_mutex_unlock(&mutex);
+
+  unsigned long reused = copy.hits+copy.spillHits+copy.shared;
+  copy.hitRate = copy.lookups > 0 ? reused/(double) copy.lookups : 0.0;
+  return copy;
+}
+
+
+bool ConvolveCache::convolve(const appWord_t *signal, unsigned int signalSize,
+                             const appWord_t *kernel, unsigned int kernelSize,
+                             appWord_t *output, OutputMode mode) {
+
+  Key key;
+  key.signalHash = hash(signal, signalSize);
+  key.kernelHash = hash(kernel, kernelSize);
+  key.signalSize = signalSize;
+  key.kernelSize = kernelSize;
+  key.mode = mode;
+
+  unsigned begin, end;
+  getOutputRange(mode, signalSize, kernelSize, begin, end);
+  const unsigned outputSize = end-begin;
+
+  pthread_mutex_lock(&mutex);
+  stats.lookups++;
+
+  if (lookup(key, signal, kernel, output)) {
+    stats.hits++;
+    recordSaving(key, outputSize);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  if (unspill(key, signal, kernel, output)) {
+    stats.spillHits++;
+    recordSaving(key, outputSize);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  // wait for the same job if another call is already running it. A job
+  // whose hashes only collide with this one is run separately.
+  map<Key, InFlight *>::iterator it = inFlight.find(key);
+  bool collided = false;
+  if (it != inFlight.end()) {
+
+    InFlight *flight = it->second;
+    collided = memcmp(flight->signal, signal, signalSize*sizeof(appWord_t)) != 0 ||
+               memcmp(flight->kernel, kernel, kernelSize*sizeof(appWord_t)) != 0;
+  }
+
+  if (it != inFlight.end() && !collided) {
+
+    InFlight *flight = it->second;
+    flight->refs++;
+    while (!flight->done) {
+      pthread_cond_wait(&doneCond, &mutex);
+    }
+
+    bool ok = flight->ok;
+    if (ok) {
+      memcpy(output, &flight->output[0], outputSize*sizeof(appWord_t));
+      stats.shared++;
+      recordSaving(key, outputSize);
+    }
+
+    if (--flight->refs == 0) delete flight;
+    pthread_mutex_unlock(&mutex);
+    return ok;
+  }
+
+  InFlight *flight = new InFlight;
+  flight->signal = signal;
+  flight->kernel = kernel;
+  flight->done = false;
+  flight->ok = false;
+  flight->refs = 1;
+  if (!collided) inFlight[key] = flight;
+  stats.misses++;
+  pthread_mutex_unlock(&mutex);
+
+  // only the owner touches the flight's outputs until it is done
+  bool ok = run(signal, signalSize, kernel, kernelSize, mode, flight->output);
+
+  pthread_mutex_lock(&mutex);
+  flight->done = true;
+  flight->ok = ok;
+  if (!collided) inFlight.erase(key);
+
+  if (ok) {
+    memcpy(output, &flight->output[0], outputSize*sizeof(appWord_t));
+    insert(key, signal, kernel, flight->output);
+  }
+  else {
+    stats.failed++;
+  }
+
+  pthread_cond_broadcast(&doneCond);
+  if (--flight->refs == 0) delete flight;
+  pthread_mutex_unlock(&mutex);
+
+  return ok;
+}
+
+
+bool ConvolveCache::run(const appWord_t *signal, unsigned int signalSize,
+                        const appWord_t *kernel, unsigned int kernelSize,
+                        OutputMode mode, vector<appWord_t> &output) {
+
+  unsigned outputSize = signalSize+kernelSize-1;
+  output.resize(App::getSafeTransferSize(outputSize, sizeof(appWord_t)));
+
+  bool ok = true;
+  pthread_mutex_lock(&deviceMutex);
+  try {
+    convolveHW.start(signal, signalSize, kernel, kernelSize);
+    while (!convolveHW.isDone());
+    outputSize = convolveHW.getOutput(&output[0], signalSize, kernelSize, mode);
+  }
+  catch(...) {
+    ok = false;
+  }
+  pthread_mutex_unlock(&deviceMutex);
+
+  output.resize(ok ? outputSize : 0);
+  return ok;
+}
+
+
+void ConvolveCache::recordSaving(const Key &key, unsigned long outputSize) {
+
+  stats.bytesSaved += ((unsigned long long) key.signalSize+outputSize)*sizeof(appWord_t);
+}
+
+
+bool ConvolveCache::lookup(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+                           appWord_t *output) {
+
+  map<Key, list<Entry>::iterator>::iterator it = index.find(key);
+  if (it == index.end()) return false;
+
+  const Entry &entry = *it->second;
+  if (memcmp(&entry.signal[0], signal, key.signalSize*sizeof(appWord_t)) != 0 ||
+      memcmp(&entry.kernel[0], kernel, key.kernelSize*sizeof(appWord_t)) != 0)
+    return false;
+
+  // move to the front of the LRU list
+  lru.splice(lru.begin(), lru, it->second);
+
+  if (!entry.output.empty())
+    memcpy(output, &entry.output[0], entry.output.size()*sizeof(appWord_t));
+  return true;
+}
+
+
+// bytes of memory that an entry counts against the budget
+static size_t entryBytes(size_t signalSize, size_t kernelSize, size_t outputSize) {
+
+  return (signalSize+kernelSize+outputSize)*sizeof(appWord_t);
+}
+
+
+void ConvolveCache::insert(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+                           const vector<appWord_t> &output) {
+
+  // a result for inputs whose hashes collide with these is replaced
+  map<Key, list<Entry>::iterator>::iterator it = index.find(key);
+  if (it != index.end()) remove(it->second);
+
+  size_t bytes = entryBytes(key.signalSize, key.kernelSize, output.size());
+
+  if (bytes > byteBudget) {
+    Entry entry;
+    entry.key = key;
+    entry.signal.assign(signal, signal+key.signalSize);
+    entry.kernel.assign(kernel, kernel+key.kernelSize);
+    entry.output = output;
+    spill(entry);
+    return;
+  }
+
+  while (stats.bytesUsed+bytes > byteBudget) {
+    evict();
+  }
+
+  lru.push_front(Entry());
+  Entry &entry = lru.front();
+  entry.key = key;
+  entry.signal.assign(signal, signal+key.signalSize);
+  entry.kernel.assign(kernel, kernel+key.kernelSize);
+  entry.output = output;
+  index[key] = lru.begin();
+  stats.bytesUsed += bytes;
+}
+
+
+void ConvolveCache::remove(list<Entry>::iterator entry) {
+
+  stats.bytesUsed -= entryBytes(entry->signal.size(), entry->kernel.size(), entry->output.size());
+  index.erase(entry->key);
+  lru.erase(entry);
+}
+
+
+void ConvolveCache::evict() {
+
+  assert(!lru.empty());
+  list<Entry>::iterator entry = lru.end();
+  --entry;
+
+  spill(*entry);
+  stats.evictions++;
+  remove(entry);
+}
+
+
+bool ConvolveCache::spillMatches(size_t offset, const Key &key, const appWord_t *signal,
+                                 const appWord_t *kernel) const {
+
+  const unsigned char *inputs = spillMap+offset+sizeof(SpillRecord);
+  return memcmp(inputs, signal, key.signalSize*sizeof(appWord_t)) == 0 &&
+         memcmp(inputs+key.signalSize*sizeof(appWord_t), kernel,
+                key.kernelSize*sizeof(appWord_t)) == 0;
+}
+
+
+void ConvolveCache::dropSpill(size_t offset) {
+
+  map<size_t, Key>::iterator it = spillOffsets.find(offset);
+  assert(it != spillOffsets.end());
+  spillIndex.erase(it->second);
+  spillOffsets.erase(it);
+}
+
+
+void ConvolveCache::spill(const Entry &entry) {
+
+  if (spillMap == NULL) return;
+
+  // a record of the same inputs is still in the file, and one of inputs
+  // whose hashes collide is replaced
+  map<Key, size_t>::iterator found = spillIndex.find(entry.key);
+  if (found != spillIndex.end()) {
+    if (spillMatches(found->second, entry.key, &entry.signal[0], &entry.kernel[0])) return;
+    dropSpill(found->second);
+  }
+
+  // records are 8-byte aligned
+  size_t bytes = sizeof(SpillRecord)+entryBytes(entry.signal.size(), entry.kernel.size(),
+                                                entry.output.size());
+  bytes = (bytes+7) & ~(size_t) 7;
+  if (bytes > spillBytes) return;
+
+  if (spillPos+bytes > spillBytes) spillPos = 0;
+
+  // drop the older records that this one overwrites. Records are written
+  // in order, so they all start inside the range.
+  map<size_t, Key>::iterator it = spillOffsets.lower_bound(spillPos);
+  while (it != spillOffsets.end() && it->first < spillPos+bytes) {
+    spillIndex.erase(it->second);
+    spillOffsets.erase(it++);
+  }
+
+  SpillRecord record;
+  memset(&record, 0, sizeof(record));
+  record.key = entry.key;
+  record.outputSize = entry.output.size();
+
+  unsigned char *pos = spillMap+spillPos;
+  memcpy(pos, &record, sizeof(record));
+  pos += sizeof(record);
+  memcpy(pos, &entry.signal[0], entry.signal.size()*sizeof(appWord_t));
+  pos += entry.signal.size()*sizeof(appWord_t);
+  memcpy(pos, &entry.kernel[0], entry.kernel.size()*sizeof(appWord_t));
+  pos += entry.kernel.size()*sizeof(appWord_t);
+  if (!entry.output.empty())
+    memcpy(pos, &entry.output[0], entry.output.size()*sizeof(appWord_t));
+
+  spillIndex[entry.key] = spillPos;
+  spillOffsets[spillPos] = entry.key;
+  spillPos += bytes;
+  stats.spills++;
+}
+
+
+bool ConvolveCache::unspill(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+                            appWord_t *output) {
+
+  map<Key, size_t>::iterator it = spillIndex.find(key);
+  if (it == spillIndex.end()) return false;
+  if (!spillMatches(it->second, key, signal, kernel)) return false;
+
+  SpillRecord record;
+  memcpy(&record, spillMap+it->second, sizeof(record));
+
+  const unsigned char *outputs = spillMap+it->second+sizeof(record)+
+                                 entryBytes(key.signalSize, key.kernelSize, 0);
+  vector<appWord_t> result(record.outputSize);
+  if (!result.empty()) {
+    memcpy(&result[0], outputs, record.outputSize*sizeof(appWord_t));
+    memcpy(output, &result[0], record.outputSize*sizeof(appWord_t));
+  }
+
+  // the record stays in the file, so evicting it again doesn't rewrite it
+  insert(key, signal, kernel, result);
+  return true;
+}
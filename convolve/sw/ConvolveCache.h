@@ -0,0 +1,147 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _CONVOLVE_CACHE_H_
+#define _CONVOLVE_CACHE_H_
+
+#include <list>
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Convolve.h"
+
+/** \brief Memoizes convolutions that are repeated with the same inputs.
+ *
+ * Results are keyed by 64-bit hashes of the signal and kernel contents,
+ * their sizes and the output mode. Every result also keeps its signal and
+ * kernel, which are compared on a hit, so inputs whose hashes collide
+ * never share a result. Results are kept in memory in LRU order up to
+ * byteBudget bytes of inputs and outputs. With a spill file, results evicted
+ * from memory are written to a memory-mapped ring of spillBytes bytes in
+ * that file, and are brought back into memory when they hit. The spill
+ * file is a scratch area that is recreated by every cache.
+ *
+ * convolve() can be called from any number of threads. Calls for a result
+ * that is already being computed wait for that computation instead of
+ * running their own, so each distinct job runs on the FPGA once.
+ */
+
+class ConvolveCache {
+
+ public:
+  struct Stats {
+    unsigned long lookups;
+    unsigned long hits;
+    unsigned long spillHits;
+
+    // calls that waited for the same job in flight
+    unsigned long shared;
+
+    // jobs run on the FPGA
+    unsigned long misses;
+    unsigned long failed;
+    unsigned long evictions;
+    unsigned long spills;
+
+    // (hits+spillHits+shared)/lookups
+    double hitRate;
+
+    // signal and output bytes that weren't transferred to or from the FPGA
+    unsigned long long bytesSaved;
+    unsigned long bytesUsed;
+  };
+
+  ConvolveCache(Convolve &convolve, size_t byteBudget,
+                const char *spillFile=NULL, size_t spillBytes=0);
+  ~ConvolveCache();
+
+  // returns false if the job failed. output needs room for the outputs
+  // kept by mode, which is signalSize+kernelSize-1 samples at most.
+  bool convolve(const appWord_t *signal, unsigned int signalSize,
+                const appWord_t *kernel, unsigned int kernelSize,
+                appWord_t *output, OutputMode mode=OUTPUT_FULL);
+
+  Stats getStats();
+
+  static uint64_t hash(const appWord_t *data, unsigned long size);
+
+ protected:
+  struct Key {
+    uint64_t signalHash;
+    uint64_t kernelHash;
+    unsigned int signalSize;
+    unsigned int kernelSize;
+    OutputMode mode;
+
+    bool operator<(const Key &rhs) const;
+  };
+
+  struct Entry {
+    Key key;
+    std::vector<appWord_t> signal;
+    std::vector<appWord_t> kernel;
+    std::vector<appWord_t> output;
+  };
+
+  // a job being computed, and the calls waiting for it. The inputs belong
+  // to the call that runs the job, which returns only once it is done.
+  struct InFlight {
+    const appWord_t *signal;
+    const appWord_t *kernel;
+    std::vector<appWord_t> output;
+    bool done;
+    bool ok;
+    unsigned refs;
+  };
+
+  // header of each result in the spill file, followed by the signal, the
+  // kernel and the outputs
+  struct SpillRecord {
+    Key key;
+    unsigned long outputSize;
+  };
+
+  Convolve &convolveHW;
+  size_t byteBudget;
+
+  // most recently used first
+  std::list<Entry> lru;
+  std::map<Key, std::list<Entry>::iterator> index;
+  std::map<Key, InFlight *> inFlight;
+
+  int spillFd;
+  unsigned char *spillMap;
+  size_t spillBytes;
+  size_t spillPos;
+  std::map<Key, size_t> spillIndex;
+  std::map<size_t, Key> spillOffsets;
+
+  Stats stats;
+  pthread_mutex_t mutex;
+  pthread_cond_t doneCond;
+
+  // serializes use of the FPGA
+  pthread_mutex_t deviceMutex;
+
+  bool lookup(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+              appWord_t *output);
+  void insert(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+              const std::vector<appWord_t> &output);
+  void remove(std::list<Entry>::iterator entry);
+  void evict();
+  void spill(const Entry &entry);
+  bool spillMatches(size_t offset, const Key &key, const appWord_t *signal,
+                    const appWord_t *kernel) const;
+  void dropSpill(size_t offset);
+  bool unspill(const Key &key, const appWord_t *signal, const appWord_t *kernel,
+               appWord_t *output);
+  bool run(const appWord_t *signal, unsigned int signalSize,
+           const appWord_t *kernel, unsigned int kernelSize,
+           OutputMode mode, std::vector<appWord_t> &output);
+  void recordSaving(const Key &key, unsigned long outputSize);
+};
+
+#endif
@@ -0,0 +1,252 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include <time.h>
+#include <sched.h>
+
+#include "ConvolveDispatcher.h"
+
+using namespace std;
+
+ConvolveDispatcher::Producer::Producer(ConvolveDispatcher &dispatcher) :
+  dispatcher(dispatcher), status(JOB_OK) {
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&doneCond, NULL);
+}
+
+
+ConvolveDispatcher::Producer::~Producer() {
+
+  pthread_cond_destroy(&doneCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+bool ConvolveDispatcher::Producer::convolve(const appWord_t *signal, unsigned int signalSize,
+                                            const appWord_t *kernel, unsigned int kernelSize,
+                                            appWord_t *output) {
+
+  Job job;
+  job.signal = signal;
+  job.signalSize = signalSize;
+  job.kernel = kernel;
+  job.kernelSize = kernelSize;
+  job.output = output;
+  job.producer = this;
+  job.submitTime = currentTime();
+
+  pthread_mutex_lock(&mutex);
+  status = JOB_PENDING;
+  pthread_mutex_unlock(&mutex);
+  dispatcher.submit(job);
+
+  // sleep until the dispatcher finishes the job. It sets the slot under
+  // the mutex, so the outputs are complete once it is seen.
+  pthread_mutex_lock(&mutex);
+  while (status == JOB_PENDING) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  int result = status;
+  pthread_mutex_unlock(&mutex);
+
+  return result == JOB_OK;
+}
+
+
+ConvolveDispatcher::ConvolveDispatcher(Board &board, unsigned long capacity, bool coalesce) :
+  convolve(board), ring(capacity), coalesce(coalesce), stopping(0) {
+
+  memset(&stats, 0, sizeof(stats));
+  pthread_mutex_init(&statsMutex, NULL);
+  sem_init(&workSem, 0, 0);
+  pthread_create(&thread, NULL, dispatchThread, this);
+}
+
+
+ConvolveDispatcher::~ConvolveDispatcher() {
+
+  __sync_lock_test_and_set(&stopping, 1);
+  sem_post(&workSem);
+  pthread_join(thread, NULL);
+  sem_destroy(&workSem);
+  pthread_mutex_destroy(&statsMutex);
+}
+
+
+ConvolveDispatcher::Stats ConvolveDispatcher::getStats() {
+
+  pthread_mutex_lock(&statsMutex);
+  Stats copy = stats;
+  pthread_mutex_unlock(&statsMutex);
+  return copy;
+}
+
+
+void ConvolveDispatcher::submit(const Job &job) {
+
+  // only a full ring makes a producer poll
+  unsigned spins = 0;
+  while (!ring.tryPush(job)) {
+    backoff(spins);
+  }
+  sem_post(&workSem);
+}
+
+
+void ConvolveDispatcher::backoff(unsigned &spins) {
+
+  // spin briefly, then yield, then sleep so that idle threads don't take
+  // a core
+  spins++;
+  if (spins < 64)
+    return;
+  else if (spins < 128)
+    sched_yield();
+  else {
+    timespec delay;
+    delay.tv_sec = 0;
+    delay.tv_nsec = 50000;
+    nanosleep(&delay, NULL);
+  }
+}
+
+
+double ConvolveDispatcher::currentTime() {
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec+now.tv_nsec*1e-9;
+}
+
+
+bool ConvolveDispatcher::sameKernel(const Job &a, const Job &b) {
+
+  return a.kernelSize == b.kernelSize &&
+    (a.kernel == b.kernel || memcmp(a.kernel, b.kernel, a.kernelSize*sizeof(appWord_t)) == 0);
+}
+
+
+bool ConvolveDispatcher::isLoaded(const Job &job) const {
+
+  return convolve.isKernelLoaded() && job.kernelSize > 0 &&
+    loadedKernel.size() == job.kernelSize &&
+    memcmp(&loadedKernel[0], job.kernel, job.kernelSize*sizeof(appWord_t)) == 0;
+}
+
+
+bool ConvolveDispatcher::runJob(const Job &job) {
+
+  try {
+
+    if (coalesce && isLoaded(job)) {
+      convolve.startLoadedKernel(job.signal, job.signalSize);
+    }
+    else {
+      loadedKernel.clear();
+      convolve.start(job.signal, job.signalSize, job.kernel, job.kernelSize);
+      loadedKernel.assign(job.kernel, job.kernel+job.kernelSize);
+
+      pthread_mutex_lock(&statsMutex);
+      stats.kernelLoads++;
+      pthread_mutex_unlock(&statsMutex);
+    }
+
+    while (!convolve.isDone());
+    convolve.getOutput(job.output, job.signalSize+job.kernelSize-1);
+  }
+  catch(...) {
+    loadedKernel.clear();
+    return false;
+  }
+
+  return true;
+}
+
+
+void ConvolveDispatcher::runBatch(vector<Job> &batch, unsigned long depth) {
+
+  if (coalesce) {
+
+    // group the jobs by kernel, starting with the one already loaded. The
+    // jobs are independent, so their order doesn't matter.
+    for (unsigned i=0; i < batch.size(); i++) {
+      if (isLoaded(batch[i])) {
+        swap(batch[0], batch[i]);
+        break;
+      }
+    }
+
+    for (unsigned i=0; i+1 < batch.size(); i++) {
+      for (unsigned j=i+1; j < batch.size(); j++) {
+        if (sameKernel(batch[i], batch[j])) {
+          swap(batch[i+1], batch[j]);
+          break;
+        }
+      }
+    }
+  }
+
+  pthread_mutex_lock(&statsMutex);
+  stats.batches++;
+  stats.meanDepth += (depth-stats.meanDepth)/stats.batches;
+  if (depth > stats.maxDepth) stats.maxDepth = depth;
+  pthread_mutex_unlock(&statsMutex);
+
+  for (unsigned i=0; i < batch.size(); i++) {
+
+    double wait = currentTime()-batch[i].submitTime;
+    bool ok = runJob(batch[i]);
+
+    pthread_mutex_lock(&statsMutex);
+    stats.jobs++;
+    if (!ok) stats.failed++;
+    stats.meanWait += (wait-stats.meanWait)/stats.jobs;
+    if (wait > stats.maxWait) stats.maxWait = wait;
+    pthread_mutex_unlock(&statsMutex);
+
+    Producer *producer = batch[i].producer;
+    pthread_mutex_lock(&producer->mutex);
+    producer->status = ok ? JOB_OK : JOB_FAILED;
+    pthread_cond_signal(&producer->doneCond);
+    pthread_mutex_unlock(&producer->mutex);
+  }
+}
+
+
+void *ConvolveDispatcher::dispatchThread(void *arg) {
+
+  ConvolveDispatcher *dispatcher = (ConvolveDispatcher *) arg;
+  vector<Job> batch;
+
+  while (true) {
+
+    Job job;
+    if (!dispatcher->ring.tryPop(job)) {
+
+      // only stop once the ring is empty. Posts for jobs that were already
+      // taken in an earlier batch just come back here.
+      if (__sync_fetch_and_add(&dispatcher->stopping, 0))
+        break;
+      while (sem_wait(&dispatcher->workSem) != 0);
+      continue;
+    }
+
+    unsigned long depth = dispatcher->ring.getSize()+1;
+
+    batch.clear();
+    batch.push_back(job);
+    while (batch.size() < dispatcher->ring.getCapacity() && dispatcher->ring.tryPop(job)) {
+      batch.push_back(job);
+    }
+
+    dispatcher->runBatch(batch, depth);
+  }
+
+  return NULL;
+}
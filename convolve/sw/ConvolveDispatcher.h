@@ -0,0 +1,122 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _CONVOLVE_DISPATCHER_H_
+#define _CONVOLVE_DISPATCHER_H_
+
+#include <vector>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "Convolve.h"
+#include "MpscRing.h"
+
+/** \brief Shares one accelerator between any number of threads.
+ *
+ * Threads submit job descriptors through a Producer into a lock-free ring.
+ * A single dispatcher thread owns the Board and runs the jobs, so producers
+ * never wait for each other, only for their own job. Each Producer has its
+ * own completion slot that the dispatcher sets and signals when the job is
+ * done, and producers post a semaphore that the dispatcher sleeps on while
+ * the ring is empty, so no thread polls.
+ *
+ * The dispatcher takes every job in the ring at once. With coalescing, jobs
+ * in such a batch that use the same kernel run one after the other and the
+ * kernel is only sent for the first, since it isn't cleared by RST_ADDR.
+ */
+
+class ConvolveDispatcher {
+
+ public:
+  struct Stats {
+    unsigned long jobs;
+    unsigned long failed;
+    unsigned long batches;
+    unsigned long kernelLoads;
+
+    // jobs in the ring when the dispatcher took each batch
+    unsigned long maxDepth;
+    double meanDepth;
+
+    // seconds from submission until the dispatcher started the job
+    double meanWait;
+    double maxWait;
+  };
+
+  class Producer {
+
+   public:
+    Producer(ConvolveDispatcher &dispatcher);
+
+    // blocks until the job is done and returns false if it failed. output
+    // needs room for a safe transfer of signalSize+kernelSize-1 samples.
+    bool convolve(const appWord_t *signal, unsigned int signalSize,
+                  const appWord_t *kernel, unsigned int kernelSize,
+                  appWord_t *output);
+
+    ~Producer();
+
+   protected:
+    friend class ConvolveDispatcher;
+
+    ConvolveDispatcher &dispatcher;
+
+    // completion slot: JOB_PENDING until the dispatcher finishes the job
+    // and signals doneCond
+    int status;
+    pthread_mutex_t mutex;
+    pthread_cond_t doneCond;
+  };
+
+  ConvolveDispatcher(Board &board, unsigned long capacity=64, bool coalesce=true);
+
+  // runs the jobs still in the ring and stops the dispatcher. No Producer
+  // may submit during or after destruction.
+  ~ConvolveDispatcher();
+
+  Stats getStats();
+
+ protected:
+  enum JobStatus {
+    JOB_PENDING,
+    JOB_OK,
+    JOB_FAILED
+  };
+
+  struct Job {
+    const appWord_t *signal;
+    unsigned int signalSize;
+    const appWord_t *kernel;
+    unsigned int kernelSize;
+    appWord_t *output;
+    Producer *producer;
+    double submitTime;
+  };
+
+  Convolve convolve;
+  MpscRing<Job> ring;
+  bool coalesce;
+  int stopping;
+  pthread_t thread;
+
+  // posted once per submitted job, and to stop the dispatcher
+  sem_t workSem;
+
+  // kernel on the FPGA, only used by the dispatcher
+  std::vector<appWord_t> loadedKernel;
+
+  Stats stats;
+  pthread_mutex_t statsMutex;
+
+  void submit(const Job &job);
+  void runBatch(std::vector<Job> &batch, unsigned long depth);
+  bool runJob(const Job &job);
+  bool isLoaded(const Job &job) const;
+
+  static bool sameKernel(const Job &a, const Job &b);
+  static void backoff(unsigned &spins);
+  static double currentTime();
+  static void *dispatchThread(void *dispatcher);
+};
+
+#endif
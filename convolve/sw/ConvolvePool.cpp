@@ -0,0 +1,123 @@
+// Greg Stitt
+// University of Florida
+
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+
+#include "ConvolvePool.h"
+
+using namespace std;
+
+ConvolvePool::ConvolvePool(const vector<Board *> &boards) {
+
+  assert(!boards.empty());
+
+  for (unsigned i=0; i < boards.size(); i++) {
+    cores.push_back(new Convolve(*boards[i]));
+    scratch.push_back((appWord_t *) App::allocBuffer(Convolve::MAX_OUTPUT_SIZE*sizeof(appWord_t)));
+  }
+}
+
+
+ConvolvePool::~ConvolvePool() {
+
+  for (unsigned i=0; i < cores.size(); i++) {
+    delete cores[i];
+    App::releaseBuffer(scratch[i]);
+  }
+}
+
+
+unsigned ConvolvePool::getNumCores() const {
+
+  return cores.size();
+}
+
+
+Convolve &ConvolvePool::getCore(unsigned i) {
+
+  return *cores[i];
+}
+
+
+void ConvolvePool::convolve(const appWord_t *signal, unsigned int signalSize,
+                            const appWord_t *kernel, unsigned int kernelSize,
+                            appWord_t *output) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+  assert(output != NULL);
+  assert(kernelSize > 0 && kernelSize <= Convolve::MAX_KERNEL_SIZE);
+
+  const unsigned overlap = kernelSize-1;
+  const unsigned outputSize = signalSize+overlap;
+  const unsigned maxSegment = Convolve::MAX_SIGNAL_SIZE-overlap;
+  vector<unsigned> segStart(cores.size()), segEnd(cores.size()), inStart(cores.size());
+  unsigned next = 0;
+
+  while (next < outputSize) {
+
+    // split the remaining outputs evenly across the cores, limited by the
+    // amount of input each core can hold
+    unsigned numCores = cores.size();
+    unsigned segment = min((outputSize-next+numCores-1)/numCores, maxSegment);
+    unsigned used = 0;
+
+    for (unsigned i=0; i < cores.size() && next < outputSize; i++, used++) {
+
+      // outputs [a,b) depend on inputs [a-overlap, b)
+      segStart[i] = next;
+      segEnd[i] = min(next+segment, outputSize);
+      inStart[i] = segStart[i] > overlap ? segStart[i]-overlap : 0;
+      unsigned inEnd = min(segEnd[i], signalSize);
+      next = segEnd[i];
+
+      cores[i]->start(signal+inStart[i], inEnd-inStart[i], kernel, kernelSize);
+    }
+
+    for (unsigned i=0; i < used; i++) {
+
+      while (!cores[i]->isDone());
+
+      // the core's output t is global output inStart+t
+      cores[i]->getOutput(scratch[i], segEnd[i]-inStart[i]);
+      memcpy(output+segStart[i], scratch[i]+(segStart[i]-inStart[i]),
+             (segEnd[i]-segStart[i])*sizeof(appWord_t));
+    }
+  }
+}
+
+
+void ConvolvePool::run(vector<ConvolveJob> &jobs) {
+
+  const int IDLE = -1;
+  vector<int> running(cores.size(), IDLE);
+  unsigned next = 0, completed = 0;
+
+  while (completed < jobs.size()) {
+
+    for (unsigned i=0; i < cores.size(); i++) {
+
+      if (running[i] != IDLE && cores[i]->isDone()) {
+
+        ConvolveJob &job = jobs[running[i]];
+        cores[i]->getOutput(job.output, job.signalSize+job.kernelSize-1);
+        running[i] = IDLE;
+        completed++;
+      }
+
+      if (running[i] == IDLE && next < jobs.size()) {
+
+        ConvolveJob &job = jobs[next];
+        if (job.signalSize > Convolve::MAX_SIGNAL_SIZE) {
+          cerr << "Job signal size " << job.signalSize << " exceeds " << Convolve::MAX_SIGNAL_SIZE << endl;
+          throw 1;
+        }
+
+        cores[i]->start(job.signal, job.signalSize, job.kernel, job.kernelSize);
+        running[i] = next++;
+      }
+    }
+  }
+}
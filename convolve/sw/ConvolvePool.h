@@ -0,0 +1,62 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _CONVOLVE_POOL_H_
+#define _CONVOLVE_POOL_H_
+
+#include <vector>
+
+#include "Convolve.h"
+
+// An independent convolution to run on any core of the pool. output must
+// be allocated with room for App::getSafeTransferSize(signalSize+kernelSize-1,
+// sizeof(appWord_t)) bytes.
+struct ConvolveJob {
+  const appWord_t *signal;
+  unsigned int signalSize;
+  const appWord_t *kernel;
+  unsigned int kernelSize;
+  appWord_t *output;
+};
+
+
+/** \brief Pool of Convolve instances, each bound to its own accelerator core.
+ *
+ * The pool shards work across cores in two ways: a single long signal is
+ * split into overlapping segments (overlap-save), and independent jobs are
+ * dispatched to whichever core is idle. Uploads are issued by the host one
+ * core at a time, but each core computes while the others are being
+ * serviced, so throughput scales with the number of cores.
+ */
+
+class ConvolvePool {
+
+ public:
+  ConvolvePool(const std::vector<Board *> &boards);
+  ~ConvolvePool();
+
+  unsigned getNumCores() const;
+  Convolve &getCore(unsigned i);
+
+  /** \brief Convolves a signal of any length by splitting its outputs
+   *         across all cores. Each segment is sent with the kernelSize-1
+   *         preceding samples it depends on.
+   */
+  void convolve(const appWord_t *signal, unsigned int signalSize,
+                const appWord_t *kernel, unsigned int kernelSize,
+                appWord_t *output);
+
+  /** \brief Runs independent jobs, starting each one on the next idle core.
+   *  Each job must fit in a single core (i.e., signalSize <= MAX_SIGNAL_SIZE).
+   */
+  void run(std::vector<ConvolveJob> &jobs);
+
+ protected:
+  std::vector<Convolve *> cores;
+
+  // per-core buffer for segment outputs, which include the leading
+  // kernelSize-1 outputs that overlap the previous segment
+  std::vector<appWord_t *> scratch;
+};
+
+#endif
@@ -0,0 +1,401 @@
+// Greg Stitt
+// University of Florida
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "ConvolveSW.h"
+
+using namespace std;
+
+void convolveSW(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output) {
+
+  unsigned int i,j;
+  unsigned int outputSize = inputSize+kernelSize-1;
+  memset(output, 0, sizeof(unsigned short)*outputSize);
+
+  for (i=0; i < outputSize; i++) {
+    for (j=0; j < kernelSize; j++) {
+
+      unsigned int temp;
+      unsigned int product;
+      unsigned int sum;
+      temp = (i>=j && i-j < inputSize) ? input[i-j] : 0;
+      product = (unsigned int) kernel[j]*temp;
+      product = product > 0xffff ? 0xffff : product;
+      sum = product + (unsigned int) output[i] > 0xffff ? 0xffff : product+output[i];
+      output[i] = sum;
+    }
+  }
+}
+
+
+
+void convolveSW(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output, OutputMode mode) {
+
+  unsigned begin, end;
+  getOutputRange(mode, inputSize, kernelSize, begin, end);
+
+  for (unsigned i=begin; i < end; i++) {
+    output[i-begin] = convolveSWAt(input, inputSize, kernel, kernelSize, i);
+  }
+}
+
+void convolveSWDecimate(const unsigned short* input, unsigned int inputSize,
+                        const unsigned short* kernel, unsigned int kernelSize,
+                        unsigned short *output, unsigned int factor) {
+
+  assert(factor > 0);
+  unsigned int outputSize = inputSize+kernelSize-1;
+
+  for (unsigned i=0, n=0; i < outputSize; i += factor, n++) {
+    output[n] = convolveSWAt(input, inputSize, kernel, kernelSize, i);
+  }
+}
+
+
+void convolveSWInterpolate(const unsigned short* input, unsigned int inputSize,
+                           const unsigned short* kernel, unsigned int kernelSize,
+                           unsigned short *output, unsigned int factor) {
+
+  assert(factor > 0);
+  unsigned int outputSize = inputSize*factor+kernelSize-1;
+
+  // output q*factor+p = sum over k of kernel[p+k*factor]*input[q-k]
+  for (unsigned i=0; i < outputSize; i++) {
+
+    unsigned p = i%factor, q = i/factor;
+    unsigned int sum = 0;
+
+    for (unsigned k=0, j=p; j < kernelSize && k <= q; k++, j += factor) {
+
+      if (q-k >= inputSize) continue;
+
+      unsigned int product = (unsigned int) kernel[j]*input[q-k];
+      product = product > 0xffff ? 0xffff : product;
+      sum = sum+product > 0xffff ? 0xffff : sum+product;
+    }
+    output[i] = sum;
+  }
+}
+
+
+unsigned int convolveSWThreshold(const unsigned short* input, unsigned int inputSize,
+                                 const unsigned short* kernel, unsigned int kernelSize,
+                                 unsigned short threshold, OutputEvent *events,
+                                 unsigned int maxEvents) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int count = 0;
+
+  for (unsigned i=0; i < outputSize; i++) {
+
+    unsigned short value = convolveSWAt(input, inputSize, kernel, kernelSize, i);
+    if (value <= threshold) continue;
+
+    if (count < maxEvents) {
+      events[count].index = i;
+      events[count].value = value;
+    }
+    count++;
+  }
+
+  return count;
+}
+
+
+TapPlan::TapPlan() : kind(PLAN_ZERO), first(0), last(0), wide(false) {
+
+}
+
+
+TapPlan::TapPlan(const unsigned short* kernel, unsigned int kernelSize) {
+
+  compile(kernel, kernelSize);
+}
+
+
+void TapPlan::compile(const unsigned short* kernel, unsigned int kernelSize) {
+
+  kind = PLAN_ZERO;
+  first = last = 0;
+  taps.clear();
+  pairs.clear();
+  singles.clear();
+
+  unsigned long long maxSum = 0;
+  for (unsigned j=0; j < kernelSize; j++) {
+    if (kernel[j] != 0) {
+      Tap tap = {j, kernel[j]};
+      taps.push_back(tap);
+      maxSum += kernel[j]*0xffffull;
+    }
+  }
+
+  wide = maxSum > 0xffffffffull;
+  if (taps.empty()) return;
+
+  first = taps.front().offset;
+  last = taps.back().offset;
+
+  bool box = taps.size() > 1 && taps.size() == last-first+1;
+  for (unsigned i=1; i < taps.size() && box; i++) {
+    box = taps[i].coef == taps[0].coef;
+  }
+
+  if (box) {
+    kind = PLAN_BOX;
+    return;
+  }
+
+  // tap j mirrors tap first+last-j. A pair is added when its first tap is
+  // visited, and every other tap is computed on its own.
+  for (unsigned i=0; i < taps.size(); i++) {
+
+    unsigned j = taps[i].offset;
+    unsigned mirror = first+last-j;
+
+    if (j < mirror && kernel[mirror] == kernel[j]) {
+      Pair pair = {j, mirror, taps[i].coef};
+      pairs.push_back(pair);
+    }
+    else if (j <= mirror || kernel[mirror] != kernel[j]) {
+      singles.push_back(taps[i]);
+    }
+  }
+
+  kind = pairs.empty() ? PLAN_TAPS : PLAN_SYMMETRIC;
+}
+
+
+TapPlan::Kind TapPlan::getKind() const {
+
+  return kind;
+}
+
+
+unsigned TapPlan::getMultiplies() const {
+
+  switch (kind) {
+  case PLAN_ZERO: return 0;
+  case PLAN_BOX: return 1;
+  default: return pairs.size()+singles.size();
+  }
+}
+
+
+void TapPlan::convolve(const unsigned short* input, unsigned int inputSize,
+                       unsigned short *output, unsigned int begin, unsigned int end,
+                       unsigned int outputBase) const {
+
+  assert(outputBase <= begin || begin >= end);
+
+  if (kind == PLAN_ZERO) {
+    for (unsigned i=begin; i < end; i++) {
+      output[i-outputBase] = 0;
+    }
+    return;
+  }
+
+  if (kind == PLAN_BOX) {
+    convolveBox(input, inputSize, output, begin, end, outputBase);
+    return;
+  }
+
+  // every tap of outputs [lo, hi) overlaps the input
+  unsigned lo = max(begin, last);
+  unsigned hi = min(end, inputSize+first);
+  if (lo >= hi) lo = hi = end;
+
+  for (unsigned i=begin; i < lo; i++) {
+    output[i-outputBase] = convolveEdge(input, inputSize, i);
+  }
+
+  if (wide)
+    convolveInterior<unsigned long long>(input, output, lo, hi, outputBase);
+  else
+    convolveInterior<unsigned int>(input, output, lo, hi, outputBase);
+
+  for (unsigned i=max(begin, hi); i < end; i++) {
+    output[i-outputBase] = convolveEdge(input, inputSize, i);
+  }
+}
+
+
+template <class Sum>
+void TapPlan::convolveInterior(const unsigned short* input, unsigned short *output,
+                               unsigned int begin, unsigned int end,
+                               unsigned int outputBase) const {
+
+  const Pair *pairTaps = pairs.empty() ? NULL : &pairs[0];
+  const Tap *singleTaps = singles.empty() ? NULL : &singles[0];
+  const unsigned numPairs = pairs.size(), numSingles = singles.size();
+
+  for (unsigned i=begin; i < end; i++) {
+
+    Sum sum = 0;
+    for (unsigned t=0; t < numPairs; t++) {
+      const Pair &pair = pairTaps[t];
+      sum += (Sum) pair.coef*(input[i-pair.offset]+input[i-pair.mirror]);
+    }
+    for (unsigned t=0; t < numSingles; t++) {
+      sum += (Sum) singleTaps[t].coef*input[i-singleTaps[t].offset];
+    }
+    output[i-outputBase] = sum > 0xffff ? 0xffff : sum;
+  }
+}
+
+
+void TapPlan::convolveBox(const unsigned short* input, unsigned int inputSize,
+                          unsigned short *output, unsigned int begin, unsigned int end,
+                          unsigned int outputBase) const {
+
+  const unsigned long long coef = taps[0].coef;
+
+  // window holds the sum of inputs [i-last, i-first] that exist
+  unsigned long long window = 0;
+  if (begin >= first) {
+    unsigned from = begin >= last ? begin-last : 0;
+    for (unsigned t=from; t <= begin-first && t < inputSize; t++) {
+      window += input[t];
+    }
+  }
+
+  for (unsigned i=begin; i < end; i++) {
+
+    unsigned long long sum = coef*window;
+    output[i-outputBase] = sum > 0xffff ? 0xffff : sum;
+
+    // slide to output i+1
+    if (i+1 >= first && i+1-first < inputSize) window += input[i+1-first];
+    if (i >= last && i-last < inputSize) window -= input[i-last];
+  }
+}
+
+
+unsigned short TapPlan::convolveEdge(const unsigned short* input, unsigned int inputSize,
+                                     unsigned int i) const {
+
+  unsigned long long sum = 0;
+  for (unsigned t=0; t < taps.size(); t++) {
+    if (taps[t].offset <= i && i-taps[t].offset < inputSize)
+      sum += (unsigned long long) taps[t].coef*input[i-taps[t].offset];
+  }
+  return sum > 0xffff ? 0xffff : sum;
+}
+
+SWEngine::SWEngine(unsigned numThreads) : numThreads(numThreads), tasks(numThreads),
+                                          threads(numThreads), numRunning(0),
+                                          startTime(0.0), stopTime(0.0) {
+
+  assert(numThreads > 0);
+}
+
+
+SWEngine::~SWEngine() {
+
+  wait();
+}
+
+
+unsigned SWEngine::getNumThreads() const {
+
+  return numThreads;
+}
+
+
+double SWEngine::currentTime() {
+
+   timeval st;
+   gettimeofday(&st,NULL);
+   return st.tv_sec + st.tv_usec*1e-6;
+}
+
+
+void *SWEngine::run(void *arg) {
+
+  Task *task = (Task *) arg;
+  task->plan->convolve(task->input, task->inputSize, task->output, task->begin, task->end,
+                       task->outputBase);
+  task->stopTime = currentTime();
+  return NULL;
+}
+
+
+void SWEngine::start(const unsigned short* input, unsigned int inputSize,
+                     const unsigned short* kernel, unsigned int kernelSize,
+                     unsigned short *output, unsigned int begin, unsigned int end,
+                     unsigned int outputBase) {
+
+  wait();
+  startTime = currentTime();
+  stopTime = startTime;
+
+  plan.compile(kernel, kernelSize);
+
+  unsigned size = end > begin ? end-begin : 0;
+  unsigned perThread = (size+numThreads-1)/numThreads;
+
+  for (unsigned i=0; i < numThreads && begin < end; i++) {
+
+    Task &task = tasks[i];
+    task.input = input;
+    task.inputSize = inputSize;
+    task.kernel = kernel;
+    task.kernelSize = kernelSize;
+    task.output = output;
+    task.begin = begin;
+    task.end = begin+perThread < end ? begin+perThread : end;
+    task.outputBase = outputBase;
+    task.plan = &plan;
+    begin = task.end;
+
+    pthread_create(&threads[i], NULL, run, &task);
+    numRunning++;
+  }
+}
+
+
+void SWEngine::wait() {
+
+  for (unsigned i=0; i < numRunning; i++) {
+
+    pthread_join(threads[i], NULL);
+    if (tasks[i].stopTime > stopTime)
+      stopTime = tasks[i].stopTime;
+  }
+
+  numRunning = 0;
+}
+
+
+void SWEngine::convolve(const unsigned short* input, unsigned int inputSize,
+                        const unsigned short* kernel, unsigned int kernelSize,
+                        unsigned short *output, unsigned int begin, unsigned int end) {
+
+  start(input, inputSize, kernel, kernelSize, output, begin, end);
+  wait();
+}
+
+
+void SWEngine::convolve(const unsigned short* input, unsigned int inputSize,
+                        const unsigned short* kernel, unsigned int kernelSize,
+                        unsigned short *output, OutputMode mode) {
+
+  unsigned begin, end;
+  getOutputRange(mode, inputSize, kernelSize, begin, end);
+  start(input, inputSize, kernel, kernelSize, output, begin, end, begin);
+  wait();
+}
+
+
+double SWEngine::elapsedTime() const {
+
+  return stopTime-startTime;
+}
@@ -0,0 +1,242 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _CONVOLVE_SW_H_
+#define _CONVOLVE_SW_H_
+
+#include <vector>
+#include <pthread.h>
+
+#include "OutputMode.h"
+#include "OutputEvent.h"
+
+/** \brief Software reference for the accelerator. Every product and
+ *  partial sum saturates at 0xffff, like the hardware's clipped output.
+ */
+void convolveSW(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output);
+
+/** \brief Only the outputs of convolveSW kept by mode, written to output[0],
+ *  output[1], ....
+ */
+void convolveSW(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output, OutputMode mode);
+
+/** \brief Threshold detection on convolveSW: stores the first maxEvents
+ *  outputs above threshold, in index order, and returns how many outputs
+ *  are above it in all. Like the accelerator's detection mode, the outputs
+ *  themselves are never stored.
+ */
+unsigned int convolveSWThreshold(const unsigned short* input, unsigned int inputSize,
+                                 const unsigned short* kernel, unsigned int kernelSize,
+                                 unsigned short threshold, OutputEvent *events,
+                                 unsigned int maxEvents);
+
+/** \brief Computes only outputs [begin, end) of convolveSW, writing output i
+ *  to output[i-outputBase]. The rest of output is untouched. The input can
+ *  be any unsigned sample type no wider than 16 bits (e.g., a mapped u8 file).
+ */
+template <class T>
+void convolveSWRange(const T* input, unsigned int inputSize,
+                     const unsigned short* kernel, unsigned int kernelSize,
+                     unsigned short *output, unsigned int begin, unsigned int end,
+                     unsigned int outputBase=0);
+
+
+/** \brief Outputs 0, factor, 2*factor, ... of convolveSW, written to
+ *  output[0], output[1], .... Only the kept outputs are computed, each from
+ *  the input phase it needs. output needs room for
+ *  (inputSize+kernelSize-1+factor-1)/factor samples.
+ */
+void convolveSWDecimate(const unsigned short* input, unsigned int inputSize,
+                        const unsigned short* kernel, unsigned int kernelSize,
+                        unsigned short *output, unsigned int factor);
+
+/** \brief convolveSW of the input upsampled by factor (factor-1 zeros after
+ *  every sample). Output phase p only uses taps p, p+factor, ... (polyphase
+ *  decomposition), so the zeros are never multiplied. output needs room
+ *  for inputSize*factor+kernelSize-1 samples.
+ */
+void convolveSWInterpolate(const unsigned short* input, unsigned int inputSize,
+                           const unsigned short* kernel, unsigned int kernelSize,
+                           unsigned short *output, unsigned int factor);
+
+
+/** \brief Kernel compiled once into the cheapest way to compute its outputs.
+ *
+ * For unsigned samples every product is nonnegative, so the saturating
+ * products and sums of convolveSW equal a single clamp of the wide sum.
+ * The plan therefore skips zero taps, pre-adds the two samples of each pair
+ * of equal symmetric taps (one multiply per pair), and computes kernels
+ * whose nonzero taps are one contiguous run of a single value (box and
+ * constant kernels) with a running sum in O(1) per output. Sums use 32 bits
+ * when the largest possible sum fits, and 64 bits otherwise. Outputs are
+ * identical to convolveSWRange.
+ */
+
+class TapPlan {
+
+ public:
+  enum Kind {
+    PLAN_ZERO,
+    PLAN_BOX,
+    PLAN_SYMMETRIC,
+
+    // nonzero taps one at a time
+    PLAN_TAPS
+  };
+
+  TapPlan();
+  TapPlan(const unsigned short* kernel, unsigned int kernelSize);
+
+  void compile(const unsigned short* kernel, unsigned int kernelSize);
+
+  Kind getKind() const;
+
+  // multiplies per output away from the ends of the signal
+  unsigned getMultiplies() const;
+
+  // outputs [begin, end) of convolveSW, like convolveSWRange. Output i is
+  // written to output[i-outputBase].
+  void convolve(const unsigned short* input, unsigned int inputSize,
+                unsigned short *output, unsigned int begin, unsigned int end,
+                unsigned int outputBase=0) const;
+
+ protected:
+  struct Tap {
+    unsigned offset;
+    unsigned coef;
+  };
+
+  struct Pair {
+    unsigned offset;
+    unsigned mirror;
+    unsigned coef;
+  };
+
+  Kind kind;
+
+  // nonzero taps are within [first, last]
+  unsigned first;
+  unsigned last;
+
+  // every nonzero tap, for outputs near the ends of the signal
+  std::vector<Tap> taps;
+
+  // equal symmetric taps and the taps without a partner
+  std::vector<Pair> pairs;
+  std::vector<Tap> singles;
+
+  bool wide;
+
+  template <class Sum>
+    void convolveInterior(const unsigned short* input, unsigned short *output,
+                          unsigned int begin, unsigned int end,
+                          unsigned int outputBase) const;
+  void convolveBox(const unsigned short* input, unsigned int inputSize,
+                   unsigned short *output, unsigned int begin, unsigned int end,
+                   unsigned int outputBase) const;
+  unsigned short convolveEdge(const unsigned short* input, unsigned int inputSize,
+                              unsigned int i) const;
+};
+
+
+/** \brief Multithreaded software convolution engine.
+ *
+ * Splits a range of outputs evenly across worker threads, which share a
+ * TapPlan compiled by start(). start() returns
+ * immediately so the caller can do other work (e.g., drive the FPGA) while
+ * the threads run, and wait() blocks until all of them have finished.
+ */
+
+class SWEngine {
+
+ public:
+  SWEngine(unsigned numThreads);
+  ~SWEngine();
+
+  unsigned getNumThreads() const;
+
+  // output i is written to output[i-outputBase]
+  void start(const unsigned short* input, unsigned int inputSize,
+             const unsigned short* kernel, unsigned int kernelSize,
+             unsigned short *output, unsigned int begin, unsigned int end,
+             unsigned int outputBase=0);
+  void wait();
+
+  // convenience function for start() followed by wait()
+  void convolve(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output, unsigned int begin, unsigned int end);
+
+  // computes only the outputs kept by mode, written to output[0], ...
+  void convolve(const unsigned short* input, unsigned int inputSize,
+                const unsigned short* kernel, unsigned int kernelSize,
+                unsigned short *output, OutputMode mode);
+
+  // time in seconds from start() until the last thread finished
+  double elapsedTime() const;
+
+ protected:
+  struct Task {
+    const unsigned short *input;
+    unsigned int inputSize;
+    const unsigned short *kernel;
+    unsigned int kernelSize;
+    unsigned short *output;
+    unsigned int begin;
+    unsigned int end;
+    unsigned int outputBase;
+    const TapPlan *plan;
+    double stopTime;
+  };
+
+  unsigned numThreads;
+  TapPlan plan;
+  std::vector<Task> tasks;
+  std::vector<pthread_t> threads;
+  unsigned numRunning;
+  double startTime;
+  double stopTime;
+
+  static void *run(void *task);
+  static double currentTime();
+};
+
+
+// output i of convolveSW
+template <class T>
+inline unsigned short convolveSWAt(const T* input, unsigned int inputSize,
+                                   const unsigned short* kernel, unsigned int kernelSize,
+                                   unsigned int i) {
+
+  unsigned int sum = 0;
+
+  // only the taps that overlap the input contribute
+  unsigned first = i >= inputSize ? i-inputSize+1 : 0;
+  unsigned last = i < kernelSize ? i+1 : kernelSize;
+
+  for (unsigned j=first; j < last; j++) {
+
+    unsigned int product = (unsigned int) kernel[j]*input[i-j];
+    product = product > 0xffff ? 0xffff : product;
+    sum = sum+product > 0xffff ? 0xffff : sum+product;
+  }
+  return sum;
+}
+
+
+template <class T>
+void convolveSWRange(const T* input, unsigned int inputSize,
+                     const unsigned short* kernel, unsigned int kernelSize,
+                     unsigned short *output, unsigned int begin, unsigned int end,
+                     unsigned int outputBase) {
+
+  for (unsigned i=begin; i < end; i++) {
+    output[i-outputBase] = convolveSWAt(input, inputSize, kernel, kernelSize, i);
+  }
+}
+
+#endif
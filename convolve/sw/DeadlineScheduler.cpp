@@ -0,0 +1,210 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include <time.h>
+
+#include "DeadlineScheduler.h"
+
+using namespace std;
+
+DeadlineScheduler::DeadlineScheduler(Board &board, unsigned int sliceSize) :
+  convolve(board), sliceSize(sliceSize), nextTicket(1), stopping(false) {
+
+  if (this->sliceSize == 0 || this->sliceSize > Convolve::MAX_SIGNAL_SIZE)
+    this->sliceSize = Convolve::MAX_SIGNAL_SIZE;
+
+  // every slice has to get past the overlap it resends
+  if (this->sliceSize < 2*Convolve::MAX_KERNEL_SIZE)
+    this->sliceSize = 2*Convolve::MAX_KERNEL_SIZE;
+
+  scratch = (appWord_t *) App::allocBuffer(App::getSafeTransferSize(Convolve::MAX_OUTPUT_SIZE, sizeof(appWord_t)));
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  pthread_create(&thread, NULL, schedulerThread, this);
+}
+
+
+DeadlineScheduler::~DeadlineScheduler() {
+
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+
+  // the thread runs every queued task before it stops, and deletes each
+  // one as it completes. Only the results of tickets that were never
+  // waited for are left.
+  assert(ready.empty());
+  finished.clear();
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&workCond);
+  pthread_mutex_destroy(&mutex);
+  App::releaseBuffer(scratch);
+}
+
+
+bool DeadlineScheduler::LessUrgent::operator()(const Task *a, const Task *b) const {
+
+  if (a->deadline != b->deadline) return a->deadline > b->deadline;
+  if (a->priority != b->priority) return a->priority < b->priority;
+  return a->ticket > b->ticket;
+}
+
+
+double DeadlineScheduler::currentTime() {
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec+now.tv_nsec*1e-9;
+}
+
+
+DeadlineScheduler::ticket_t DeadlineScheduler::submit(const ConvolveJob &job, double deadline,
+                                                      int priority, unsigned jobClass) {
+
+  assert(job.signal != NULL);
+  assert(job.kernel != NULL);
+  assert(job.output != NULL);
+
+  Task *task = new Task;
+  task->job = job;
+  task->priority = priority;
+  task->jobClass = jobClass;
+  task->submitTime = currentTime();
+  task->deadline = task->submitTime+deadline;
+  task->next = 0;
+  task->failed = false;
+
+  pthread_mutex_lock(&mutex);
+  task->ticket = nextTicket++;
+  ready.push(task);
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+
+  return task->ticket;
+}
+
+
+bool DeadlineScheduler::wait(ticket_t ticket) {
+
+  pthread_mutex_lock(&mutex);
+  while (finished.find(ticket) == finished.end()) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  bool ok = finished[ticket];
+  finished.erase(ticket);
+  pthread_mutex_unlock(&mutex);
+
+  return ok;
+}
+
+
+DeadlineScheduler::ClassStats DeadlineScheduler::getStats(unsigned jobClass) {
+
+  ClassStats classStats;
+  memset(&classStats, 0, sizeof(classStats));
+
+  pthread_mutex_lock(&mutex);
+  if (stats.find(jobClass) != stats.end())
+    classStats = stats[jobClass];
+  pthread_mutex_unlock(&mutex);
+
+  return classStats;
+}
+
+
+bool DeadlineScheduler::runSlice(Task &task) {
+
+  const ConvolveJob &job = task.job;
+  const unsigned overlap = job.kernelSize-1;
+  const unsigned outputSize = job.signalSize+overlap;
+
+  // outputs [a,b) depend on inputs [a-overlap, b). A slice sends at most
+  // sliceSize inputs, and the one that reaches the end of the signal also
+  // produces the kernelSize-1 outputs past it.
+  unsigned a = task.next;
+  unsigned inStart = a > overlap ? a-overlap : 0;
+  unsigned b = inStart+sliceSize;
+  if (b >= job.signalSize) b = outputSize;
+  unsigned inEnd = min(b, job.signalSize);
+
+  try {
+    convolve.start(job.signal+inStart, inEnd-inStart, job.kernel, job.kernelSize);
+    while (!convolve.isDone());
+
+    // unsliced jobs are read straight into the output
+    if (a == 0 && b == outputSize) {
+      convolve.getOutput(job.output, outputSize);
+    }
+    else {
+      // the FPGA's output t is global output inStart+t
+      convolve.getOutput(scratch, b-inStart);
+      memcpy(job.output+a, scratch+(a-inStart), (b-a)*sizeof(appWord_t));
+    }
+  }
+  catch(...) {
+    task.failed = true;
+    return true;
+  }
+
+  task.next = b;
+  return b == outputSize;
+}
+
+
+void DeadlineScheduler::complete(Task *task) {
+
+  // called with the mutex locked
+  double latency = currentTime()-task->submitTime;
+  ClassStats &classStats = stats[task->jobClass];
+
+  classStats.jobs++;
+  if (task->failed) classStats.failed++;
+  if (latency+task->submitTime > task->deadline) classStats.misses++;
+  classStats.meanLatency += (latency-classStats.meanLatency)/classStats.jobs;
+  classStats.maxLatency = max(classStats.maxLatency, latency);
+
+  finished[task->ticket] = !task->failed;
+  pthread_cond_broadcast(&doneCond);
+  delete task;
+}
+
+
+void *DeadlineScheduler::schedulerThread(void *arg) {
+
+  DeadlineScheduler *scheduler = (DeadlineScheduler *) arg;
+
+  pthread_mutex_lock(&scheduler->mutex);
+  while (true) {
+
+    while (scheduler->ready.empty() && !scheduler->stopping) {
+      pthread_cond_wait(&scheduler->workCond, &scheduler->mutex);
+    }
+
+    if (scheduler->ready.empty()) break;
+
+    Task *task = scheduler->ready.top();
+    scheduler->ready.pop();
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    bool done = scheduler->runSlice(*task);
+
+    pthread_mutex_lock(&scheduler->mutex);
+    if (done)
+      scheduler->complete(task);
+    else
+      scheduler->ready.push(task);
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+
+  return NULL;
+}
@@ -0,0 +1,103 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _DEADLINE_SCHEDULER_H_
+#define _DEADLINE_SCHEDULER_H_
+
+#include <map>
+#include <queue>
+#include <vector>
+#include <pthread.h>
+
+#include "Convolve.h"
+#include "ConvolvePool.h"
+
+/** \brief Runs jobs on one accelerator in earliest-deadline-first order.
+ *
+ * Jobs are submitted with a deadline, a priority that breaks ties between
+ * equal deadlines, and a class that statistics are kept for. A scheduler
+ * thread owns the Board and runs the job with the earliest deadline. Jobs
+ * with more than sliceSize outputs are split into overlap-save slices (each
+ * sent with the kernelSize-1 preceding samples it depends on), and the
+ * earliest deadline is picked again after every slice, so an urgent job
+ * only waits for the current slice of a large one.
+ */
+
+class DeadlineScheduler {
+
+ public:
+  typedef unsigned long ticket_t;
+
+  struct ClassStats {
+    unsigned long jobs;
+    unsigned long misses;
+    unsigned long failed;
+
+    // seconds from submission to completion
+    double meanLatency;
+    double maxLatency;
+  };
+
+  // sliceSize is in input samples. 0 uses the largest slices that fit in
+  // the FPGA.
+  DeadlineScheduler(Board &board, unsigned int sliceSize=DEFAULT_SLICE_SIZE);
+
+  // finishes every submitted job first
+  ~DeadlineScheduler();
+
+  // deadline is in seconds from now. The job's buffers must stay valid
+  // until wait() returns, and its output needs room for a safe transfer
+  // of signalSize+kernelSize-1 samples.
+  ticket_t submit(const ConvolveJob &job, double deadline, int priority=0,
+                  unsigned jobClass=0);
+
+  // returns false if the job failed. A finished job's result is kept until
+  // its ticket is waited for, so every ticket should be.
+  bool wait(ticket_t ticket);
+
+  ClassStats getStats(unsigned jobClass);
+
+  static const unsigned int DEFAULT_SLICE_SIZE = 4096;
+
+ protected:
+  struct Task {
+    ConvolveJob job;
+    ticket_t ticket;
+    int priority;
+    unsigned jobClass;
+    double submitTime;
+    double deadline;
+
+    // next output to compute
+    unsigned int next;
+    bool failed;
+  };
+
+  // orders the ready queue so that top() is the most urgent task
+  struct LessUrgent {
+    bool operator()(const Task *a, const Task *b) const;
+  };
+
+  Convolve convolve;
+  unsigned int sliceSize;
+  appWord_t *scratch;
+
+  std::priority_queue<Task *, std::vector<Task *>, LessUrgent> ready;
+  std::map<ticket_t, bool> finished;
+  std::map<unsigned, ClassStats> stats;
+  ticket_t nextTicket;
+  bool stopping;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t workCond;
+  pthread_cond_t doneCond;
+
+  bool runSlice(Task &task);
+  void complete(Task *task);
+
+  static double currentTime();
+  static void *schedulerThread(void *scheduler);
+};
+
+#endif
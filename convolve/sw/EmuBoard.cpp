@@ -0,0 +1,328 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+
+#include <time.h>
+
+#include "EmuBoard.h"
+#include "Convolve.h"
+
+using namespace std;
+
+EmuBoard::EmuBoard(double pathBandwidth, double computeRate) : ram0(RAM_WORDS, 0), ram1(RAM_WORDS, 0),
+                       ram0Addr(0), ram1Addr(0),
+                       kernel(Convolve::MAX_KERNEL_SIZE, 0),
+                       signalSize(0), signalAddr(0), bank(0), decimateFactor(1),
+                       cascade(false), cascadeAddr(0), threshold(0), maxEvents(0),
+                       eventCount(0), done(false),
+                       pathBandwidth(pathBandwidth), computeRate(computeRate),
+                       running(false), doneTime(0.0), jobSignalSize(0),
+                       jobRam0Base(0), jobRam1Base(0), jobDecimateFactor(1),
+                       jobCascade(false), jobCascadeAddr(0), jobThreshold(0),
+                       jobMaxEvents(0) {
+
+}
+
+
+EmuBoard::~EmuBoard() {
+
+  finishJob();
+
+}
+
+
+bool EmuBoard::write(unsigned *data, unsigned long addr, unsigned long words) {
+
+  unsigned long streamed = 0;
+
+  for (unsigned long i=0; i < words; i++, addr++) {
+
+    if (addr < RAM_WORDS) {
+
+      if (ram0Addr+addr >= RAM_WORDS) return false;
+      ram0[ram0Addr+addr] = data[i];
+      streamed++;
+    }
+    else {
+      writeReg(addr, data[i]);
+    }
+  }
+
+  transferDelay(streamed);
+
+  return true;
+}
+
+
+bool EmuBoard::read(unsigned *data, unsigned long addr, unsigned long words) {
+
+  unsigned long streamed = 0;
+
+  for (unsigned long i=0; i < words; i++, addr++) {
+
+    if (addr < RAM_WORDS) {
+
+      if (ram1Addr+addr >= RAM_WORDS) return false;
+      data[i] = ram1[ram1Addr+addr];
+      streamed++;
+    }
+    else {
+      data[i] = readReg(addr);
+    }
+  }
+
+  transferDelay(streamed);
+
+  return true;
+}
+
+
+void EmuBoard::writeReg(unsigned long addr, boardWord_t data) {
+
+  switch (addr) {
+
+  case RAM0_CONFIG_ADDR:
+    ram0Addr = data & (RAM_WORDS-1);
+    break;
+
+  case RAM1_CONFIG_ADDR:
+    ram1Addr = data & (RAM_WORDS-1);
+    break;
+
+  case RST_ADDR:
+    if (data & 1) {
+      finishJob();
+      done = false;
+      cascade = false;
+      maxEvents = 0;
+      eventCount = 0;
+
+      // only a reset with RST_KEEP_SIGNAL is guaranteed to preserve RAM0, so
+      // clear it otherwise to catch software that relies on stale contents
+      if (!(data & RST_KEEP_SIGNAL))
+        fill(ram0.begin(), ram0.end(), 0);
+    }
+    break;
+
+  case SIGNAL_SIZE_ADDR:
+    signalSize = data;
+    break;
+
+  case SIGNAL_ADDR_ADDR:
+    signalAddr = data & (RAM_WORDS-1);
+    break;
+
+  case BANK_ADDR:
+    bank = data & 1;
+    break;
+
+  case DECIMATE_ADDR:
+    // the number of kept outputs above the factor only sizes the FPGA's
+    // RAM1 transfer
+    decimateFactor = data & ((1 << DECIMATE_FACTOR_BITS)-1);
+    break;
+
+  case CASCADE_ADDR:
+    cascade = data & CASCADE_ENABLE;
+    cascadeAddr = (data >> 1) & (RAM_WORDS-1);
+    break;
+
+  case THRESHOLD_ADDR:
+    threshold = data & 0xffff;
+    maxEvents = min(data >> THRESHOLD_MAX_EVENTS_SHIFT, (boardWord_t) RAM_WORDS);
+    break;
+
+  case KERNEL_DATA_ADDR:
+    // shift the new tap in, dropping the oldest one
+    kernel.erase(kernel.begin());
+    kernel.push_back(data & 0xffff);
+    break;
+
+  case GO_ADDR:
+    if (data & 1) {
+
+      finishJob();
+      done = false;
+
+      unsigned long ram0Base = (signalAddr+bank*BANK_WORDS)*2;
+      unsigned long ram1Base = bank*BANK_WORDS;
+
+      if (computeRate > 0.0) {
+        jobKernel = kernel;
+        jobSignalSize = signalSize;
+        jobRam0Base = ram0Base;
+        jobRam1Base = ram1Base;
+        jobDecimateFactor = decimateFactor;
+        jobCascade = cascade;
+        jobCascadeAddr = cascadeAddr;
+        jobThreshold = threshold;
+        jobMaxEvents = maxEvents;
+        doneTime = currentTime()+(signalSize+kernel.size()-1)/computeRate;
+        running = true;
+        pthread_create(&computeThread, NULL, computeJob, this);
+      }
+      else {
+        compute(kernel, signalSize, ram0Base, ram1Base, decimateFactor, cascade, cascadeAddr,
+                threshold, maxEvents);
+        done = true;
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+
+boardWord_t EmuBoard::readReg(unsigned long addr) {
+
+  switch (addr) {
+
+  case SIGNAL_SIZE_ADDR:
+    return signalSize;
+
+  case SIGNAL_ADDR_ADDR:
+    return signalAddr;
+
+  case BANK_ADDR:
+    return bank;
+
+  case DECIMATE_ADDR:
+    return decimateFactor;
+
+  case CASCADE_ADDR:
+    return (cascadeAddr << 1) | (cascade ? CASCADE_ENABLE : 0);
+
+  case THRESHOLD_ADDR:
+    return (maxEvents << THRESHOLD_MAX_EVENTS_SHIFT) | threshold;
+
+  case EVENT_COUNT_ADDR:
+    // only valid once the job is done
+    return running ? 0 : eventCount;
+
+  case KERNEL_LOADED_ADDR:
+    return 1;
+
+  case DONE_ADDR:
+    if (running && currentTime() >= doneTime) {
+      finishJob();
+      done = true;
+    }
+    return done ? 1 : 0;
+
+  default:
+    return 0;
+  }
+}
+
+
+unsigned short EmuBoard::ram0Sample(unsigned long i) const {
+
+  // like the DRAM read address, wrap at the end of RAM0
+  return (ram0[(i/2) % ram0.size()] >> ((i%2)*16)) & 0xffff;
+}
+
+
+void EmuBoard::finishJob() {
+
+  if (running) {
+    pthread_join(computeThread, NULL);
+    running = false;
+  }
+}
+
+
+void *EmuBoard::computeJob(void *arg) {
+
+  EmuBoard *board = (EmuBoard *) arg;
+  board->compute(board->jobKernel, board->jobSignalSize, board->jobRam0Base,
+                 board->jobRam1Base, board->jobDecimateFactor, board->jobCascade,
+                 board->jobCascadeAddr, board->jobThreshold, board->jobMaxEvents);
+  return NULL;
+}
+
+
+void EmuBoard::compute(const vector<unsigned> &kernel, unsigned signalSize,
+                       unsigned long ram0Base, unsigned long ram1Base, unsigned factor,
+                       bool cascade, unsigned long cascadeAddr, unsigned threshold,
+                       unsigned maxEvents) {
+
+  const unsigned kernelSize = kernel.size();
+  if (factor == 0) factor = 1;
+  unsigned long outputSize = signalSize+kernelSize-1;
+
+  if (outputSize > RAM_WORDS*2) {
+    cerr << "EmuBoard: signal size " << signalSize << " exceeds RAM1" << endl;
+    outputSize = RAM_WORDS*2;
+  }
+
+  // like the FPGA, pad the unpadded signal in RAM0 with kernelSize-1 zeros
+  // on both sides, so output i covers signal samples (i-kernelSize, i]
+  // outputs that a decimating FPGA discards are skipped, and kept output i
+  // is written to position i/factor
+  unsigned count = 0;
+  for (unsigned long i=0; i < outputSize; i += factor) {
+
+    unsigned long long sum = 0;
+    for (unsigned j=0; j < kernelSize; j++) {
+      if (i >= j && i-j < signalSize)
+        sum += (unsigned long long) kernel[j]*ram0Sample(ram0Base+i-j);
+    }
+
+    unsigned short clipped = sum > 0xffff ? 0xffff : sum;
+    unsigned long pos = i/factor;
+    unsigned shift = (pos%2)*16;
+    unsigned long word;
+
+    // when detecting, the outputs above the threshold are written as events
+    // (16-bit index, then value) instead, and only the first maxEvents of
+    // them are stored
+    if (maxEvents > 0) {
+      if (clipped > threshold) {
+        if (count < maxEvents)
+          ram1[(ram1Base+count) % ram1.size()] = (pos & 0xffff) | ((unsigned) clipped << 16);
+        count++;
+      }
+    }
+    else {
+      word = (ram1Base+pos/2) % ram1.size();
+      ram1[word] = (ram1[word] & ~(0xffffu << shift)) | ((unsigned) clipped << shift);
+    }
+
+    // the loopback packs the same outputs into RAM0, and an odd last
+    // output gets a 0 in the upper half of its word
+    if (cascade) {
+      word = (cascadeAddr+pos/2) % ram0.size();
+      ram0[word] = shift ? (ram0[word] & 0xffff) | ((unsigned) clipped << 16) : clipped;
+    }
+  }
+
+  // the FPGA's RAM1 transfer is always maxEvents words, so the rest are 0
+  for (unsigned e=count; e < maxEvents; e++) {
+    ram1[(ram1Base+e) % ram1.size()] = 0;
+  }
+  eventCount = count;
+}
+
+
+void EmuBoard::transferDelay(unsigned long words) const {
+
+  if (pathBandwidth <= 0.0 || words == 0) return;
+
+  // spin instead of sleeping, since sleeps are much longer than the
+  // transfer of a single upload block
+  double end = currentTime()+words*sizeof(boardWord_t)/pathBandwidth;
+  while (currentTime() < end);
+}
+
+
+double EmuBoard::currentTime() {
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec+now.tv_nsec*1e-9;
+}
@@ -0,0 +1,105 @@
+// Greg Stitt
+// University of Florida
+// EmuBoard class
+// This class emulates the convolution accelerator's memory map in software
+// so that the host code can run (and be traced/replayed) without a ZedBoard.
+// Writes below RAM_WORDS stream into RAM0, reads below RAM_WORDS return
+// RAM1, and the registers defined in Convolve.h behave like the ones in
+// memory_map_conv. As in the FPGA, RAM0 holds the unpadded signal and the
+// zero padding is added while computing. The signal is read from
+// SIGNAL_ADDR_ADDR onwards, so RAM0 also models a DRAM that holds a staged
+// signal larger than one window. BANK_ADDR selects the half of RAM0 and
+// RAM1 that the computation uses, and DECIMATE_ADDR makes it write only
+// every factor-th output to RAM1. CASCADE_ADDR makes it also write its
+// outputs, packed two per word, to RAM0, where the next stage reads them.
+// A nonzero maximum in THRESHOLD_ADDR replaces the outputs in RAM1 with
+// (index, value) events for the outputs above the threshold, zero-filled up
+// to the maximum, and EVENT_COUNT_ADDR counts them.
+//
+// Optionally, the emulator also models time: DMA transfers take
+// words/pathBandwidth and a computation takes outputs/computeRate seconds.
+// The computation then runs on its own thread, with the registers it was
+// started with, while software keeps using the memory map. Like on the FPGA,
+// software must not touch the RAM0/RAM1 half of a running job.
+
+#ifndef _EMU_BOARD_H_
+#define _EMU_BOARD_H_
+
+#include <vector>
+#include <pthread.h>
+
+#include "Board.h"
+
+class EmuBoard : public Board {
+
+ public:
+  EmuBoard(double pathBandwidth=0.0, double computeRate=0.0);
+  virtual ~EmuBoard();
+
+  virtual bool write(unsigned *data, unsigned long addr, unsigned long words);
+  virtual bool read(unsigned *data, unsigned long addr, unsigned long words);
+
+ protected:
+  std::vector<boardWord_t> ram0;
+  std::vector<boardWord_t> ram1;
+
+  // DMA start addresses (in words) from the last RAM0/RAM1 config writes
+  unsigned long ram0Addr;
+  unsigned long ram1Addr;
+
+  // kernel buffer in the order the taps were written. Like the hardware
+  // kernel buffer, this is only cleared by a global reset, not by RST_ADDR.
+  std::vector<unsigned> kernel;
+
+  unsigned signalSize;
+
+  // word address in RAM0 of the first signal sample
+  unsigned long signalAddr;
+  unsigned bank;
+  unsigned decimateFactor;
+
+  // RAM0 word address that outputs are looped back to, valid if cascade
+  bool cascade;
+  unsigned long cascadeAddr;
+
+  // threshold detection is on while maxEvents > 0. eventCount is set by the
+  // last job.
+  unsigned threshold;
+  unsigned maxEvents;
+  unsigned eventCount;
+  bool done;
+
+  // bytes/second of DMA transfers and outputs/second of the computation,
+  // 0 for no delay
+  double pathBandwidth;
+  double computeRate;
+
+  // a job started by GO that completes at doneTime, and the registers it
+  // was started with
+  bool running;
+  double doneTime;
+  pthread_t computeThread;
+  std::vector<unsigned> jobKernel;
+  unsigned jobSignalSize;
+  unsigned long jobRam0Base;
+  unsigned long jobRam1Base;
+  unsigned jobDecimateFactor;
+  bool jobCascade;
+  unsigned long jobCascadeAddr;
+  unsigned jobThreshold;
+  unsigned jobMaxEvents;
+
+  void writeReg(unsigned long addr, boardWord_t data);
+  boardWord_t readReg(unsigned long addr);
+  unsigned short ram0Sample(unsigned long i) const;
+  void compute(const std::vector<unsigned> &kernel, unsigned signalSize,
+               unsigned long ram0Base, unsigned long ram1Base, unsigned factor,
+               bool cascade, unsigned long cascadeAddr, unsigned threshold,
+               unsigned maxEvents);
+  void finishJob();
+  static void *computeJob(void *board);
+  void transferDelay(unsigned long words) const;
+  static double currentTime();
+};
+
+#endif
@@ -0,0 +1,90 @@
+// Greg Stitt
+// University of Florida
+
+#include <cassert>
+#include <algorithm>
+
+#include "HybridConvolve.h"
+#include "Timer.h"
+
+using namespace std;
+
+const double HybridConvolve::SMOOTHING = 0.5;
+
+// never give either engine less than this fraction, so that both keep
+// getting measured
+#define MIN_RATIO 0.05
+#define MAX_RATIO 0.95
+
+HybridConvolve::HybridConvolve(Convolve &convolve, SWEngine &engine, double hwRatio)
+  : hw(convolve), sw(engine), hwRatio(hwRatio), hwTime(0.0), swTime(0.0) {
+
+}
+
+
+HybridConvolve::~HybridConvolve() {
+
+}
+
+
+double HybridConvolve::getRatio() const {
+
+  return hwRatio;
+}
+
+
+double HybridConvolve::getHWTime() const {
+
+  return hwTime;
+}
+
+
+double HybridConvolve::getSWTime() const {
+
+  return swTime;
+}
+
+
+void HybridConvolve::convolve(const appWord_t *signal, unsigned int signalSize,
+                              const appWord_t *kernel, unsigned int kernelSize,
+                              appWord_t *output) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+  assert(output != NULL);
+
+  unsigned outputSize = signalSize+kernelSize-1;
+
+  // The split is kept even so that the FPGA's last word of outputs doesn't
+  // overwrite the first output computed by software.
+  unsigned split = (unsigned) (hwRatio*outputSize);
+  split = min(split, min(signalSize, Convolve::MAX_SIGNAL_SIZE));
+  split &= ~1u;
+
+  // start the software threads first so they run during the upload
+  sw.start(signal, signalSize, kernel, kernelSize, output, split, outputSize);
+
+  Timer timer;
+  timer.start();
+  if (split > 0) {
+    hw.start(signal, split, kernel, kernelSize);
+    while (!hw.isDone());
+    hw.getOutput(output, split);
+  }
+  timer.stop();
+  hwTime = timer.elapsedTime();
+
+  sw.wait();
+  swTime = sw.elapsedTime();
+
+  // rebalance using the throughput (outputs/second) of each engine
+  if (split > 0 && split < outputSize && hwTime > 0.0 && swTime > 0.0) {
+
+    double hwRate = split/hwTime;
+    double swRate = (outputSize-split)/swTime;
+    double target = hwRate/(hwRate+swRate);
+
+    hwRatio = (1.0-SMOOTHING)*hwRatio + SMOOTHING*target;
+    hwRatio = max(MIN_RATIO, min(MAX_RATIO, hwRatio));
+  }
+}
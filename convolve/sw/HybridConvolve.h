@@ -0,0 +1,53 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _HYBRID_CONVOLVE_H_
+#define _HYBRID_CONVOLVE_H_
+
+#include "Convolve.h"
+#include "ConvolveSW.h"
+
+/** \brief Co-executes a single convolution on the FPGA and the CPU.
+ *
+ * The outputs are split at a single point: the accelerator computes
+ * outputs [0, split) from inputs [0, split), and the software engine
+ * computes outputs [split, end) directly from the full input, so the
+ * kernelSize-1 samples of overlap at the boundary need no extra handling.
+ * Both halves are written in place into the caller's output array.
+ *
+ * The split is chosen in proportion to the throughput of each engine,
+ * measured on every call, so that both finish at about the same time.
+ */
+
+class HybridConvolve {
+
+ public:
+  HybridConvolve(Convolve &convolve, SWEngine &engine, double hwRatio=0.5);
+  ~HybridConvolve();
+
+  /** \brief output must hold App::getSafeTransferSize(signalSize+kernelSize-1,
+   *  sizeof(appWord_t)) bytes and be word aligned.
+   */
+  void convolve(const appWord_t *signal, unsigned int signalSize,
+                const appWord_t *kernel, unsigned int kernelSize,
+                appWord_t *output);
+
+  // fraction of the outputs given to the FPGA on the next call
+  double getRatio() const;
+
+  // times of the last call, in seconds
+  double getHWTime() const;
+  double getSWTime() const;
+
+ protected:
+  Convolve &hw;
+  SWEngine &sw;
+  double hwRatio;
+  double hwTime;
+  double swTime;
+
+  // weight of the newest measurement when updating hwRatio
+  static const double SMOOTHING;
+};
+
+#endif
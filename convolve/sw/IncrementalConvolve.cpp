@@ -0,0 +1,187 @@
+// Greg Stitt
+// University of Florida
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "IncrementalConvolve.h"
+#include "ConvolveSW.h"
+#include "Timer.h"
+
+using namespace std;
+
+const double IncrementalConvolve::SMOOTHING = 0.25;
+
+// outputs computed in software when calibrating its model
+#define CALIBRATION_OUTPUTS 256
+
+IncrementalConvolve::IncrementalConvolve(Convolve &convolve, const appWord_t *kernel,
+                                         unsigned int kernelSize) :
+  hw(convolve), kernel(kernel, kernel+kernelSize), plan(kernel, kernelSize), hwFixed(0.0), hwPerSample(0.0),
+  swPerOutput(0.0) {
+
+  assert(kernelSize > 0 && kernelSize <= Convolve::MAX_KERNEL_SIZE);
+  scratch = (appWord_t *) App::allocBuffer(App::getSafeTransferSize(Convolve::MAX_OUTPUT_SIZE, sizeof(appWord_t)));
+}
+
+
+IncrementalConvolve::~IncrementalConvolve() {
+
+  App::releaseBuffer(scratch);
+}
+
+
+appWord_t *IncrementalConvolve::getSignal() {
+
+  return signal.empty() ? NULL : &signal[0];
+}
+
+
+unsigned int IncrementalConvolve::getSignalSize() const {
+
+  return signal.size();
+}
+
+
+const appWord_t *IncrementalConvolve::getOutput() const {
+
+  return output.empty() ? NULL : &output[0];
+}
+
+
+unsigned int IncrementalConvolve::getOutputSize() const {
+
+  return output.size();
+}
+
+
+void IncrementalConvolve::setSignal(const appWord_t *signal, unsigned int signalSize) {
+
+  assert(signalSize > 0);
+
+  this->signal.assign(signal, signal+signalSize);
+  output.assign(signalSize+kernel.size()-1, 0);
+  dirty.clear();
+
+  // the full pass gives the cost per sample, a window of one output gives
+  // the fixed cost, and a short software range gives the software cost
+  Timer timer;
+  timer.start();
+  runHW(0, output.size());
+  timer.stop();
+  double fullTime = timer.elapsedTime();
+
+  timer.start();
+  runHW(0, 1);
+  timer.stop();
+  hwFixed = timer.elapsedTime();
+  hwPerSample = max(fullTime-hwFixed, 0.0)/(signalSize+output.size());
+
+  unsigned swOutputs = min((unsigned) output.size(), (unsigned) CALIBRATION_OUTPUTS);
+  timer.start();
+  runSW(0, swOutputs);
+  timer.stop();
+  swPerOutput = timer.elapsedTime()/swOutputs;
+}
+
+
+void IncrementalConvolve::edit(unsigned int start, const appWord_t *samples, unsigned int size) {
+
+  assert(start+size <= signal.size());
+
+  memcpy(&signal[start], samples, size*sizeof(appWord_t));
+  markDirty(start, start+size);
+}
+
+
+void IncrementalConvolve::markDirty(unsigned int start, unsigned int end) {
+
+  assert(start <= end && end <= signal.size());
+
+  if (start < end)
+    dirty.push_back(make_pair(start, end));
+}
+
+
+IncrementalConvolve::UpdateStats IncrementalConvolve::update() {
+
+  UpdateStats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  if (dirty.empty()) return stats;
+
+  const unsigned overlap = kernel.size()-1;
+  sort(dirty.begin(), dirty.end());
+
+  unsigned i = 0;
+  while (i < dirty.size()) {
+
+    // merge the ranges whose output windows overlap this one
+    unsigned begin = dirty[i].first;
+    unsigned end = dirty[i].second+overlap;
+    for (i++; i < dirty.size() && dirty[i].first < end; i++) {
+      end = max(end, dirty[i].second+overlap);
+    }
+
+    // an FPGA window sends the outputs' inputs and receives the outputs
+    unsigned inputs = min(end, (unsigned) signal.size())-(begin > overlap ? begin-overlap : 0);
+    unsigned calls = (inputs+Convolve::MAX_SIGNAL_SIZE-1)/Convolve::MAX_SIGNAL_SIZE;
+    double hwCost = calls*hwFixed + (inputs+end-begin)*hwPerSample;
+    double swCost = (end-begin)*swPerOutput;
+
+    Timer timer;
+    timer.start();
+    if (hwCost < swCost) {
+      runHW(begin, end);
+      timer.stop();
+      double perSample = max(timer.elapsedTime()-calls*hwFixed, 0.0)/(inputs+end-begin);
+      hwPerSample = (1.0-SMOOTHING)*hwPerSample + SMOOTHING*perSample;
+      stats.hwWindows++;
+    }
+    else {
+      runSW(begin, end);
+      timer.stop();
+      swPerOutput = (1.0-SMOOTHING)*swPerOutput + SMOOTHING*timer.elapsedTime()/(end-begin);
+    }
+
+    stats.windows++;
+    stats.outputs += end-begin;
+  }
+
+  dirty.clear();
+  return stats;
+}
+
+
+void IncrementalConvolve::runSW(unsigned int begin, unsigned int end) {
+
+  plan.convolve(&signal[0], signal.size(), &output[0], begin, end);
+}
+
+
+void IncrementalConvolve::runHW(unsigned int begin, unsigned int end) {
+
+  const unsigned overlap = kernel.size()-1;
+  const unsigned signalSize = signal.size();
+  unsigned a = begin;
+
+  // outputs [a,b) depend on inputs [a-overlap, b), in calls of at most
+  // MAX_SIGNAL_SIZE inputs. The call that reaches the end of the signal
+  // also produces the outputs past it.
+  while (a < end) {
+
+    unsigned inStart = a > overlap ? a-overlap : 0;
+    unsigned b = inStart+Convolve::MAX_SIGNAL_SIZE;
+    if (b >= signalSize) b = output.size();
+    b = min(b, end);
+    unsigned inEnd = min(b, signalSize);
+
+    // the FPGA's output t is output inStart+t
+    hw.start(&signal[inStart], inEnd-inStart, &kernel[0], kernel.size());
+    while (!hw.isDone());
+    hw.getOutput(scratch, b-inStart);
+    memcpy(&output[a], scratch+(a-inStart), (b-a)*sizeof(appWord_t));
+    a = b;
+  }
+}
@@ -0,0 +1,77 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _INCREMENTAL_CONVOLVE_H_
+#define _INCREMENTAL_CONVOLVE_H_
+
+#include <vector>
+#include <utility>
+
+#include "Convolve.h"
+#include "ConvolveSW.h"
+
+/** \brief Keeps a signal and its convolution, and recomputes only the
+ *  outputs that edits to the signal can change.
+ *
+ * Editing inputs [start, end) can only change outputs
+ * [start, end+kernelSize-1). update() merges the dirty ranges whose
+ * output windows overlap, and recomputes each window in place in the
+ * stored output on the FPGA or in software, whichever is expected to be
+ * faster. The FPGA is modeled as a fixed cost per call plus a cost per
+ * sample, and software as a cost per output. Both models are calibrated
+ * by setSignal() and updated with every window they run.
+ */
+
+class IncrementalConvolve {
+
+ public:
+  struct UpdateStats {
+    unsigned windows;
+    unsigned hwWindows;
+    unsigned long outputs;
+  };
+
+  IncrementalConvolve(Convolve &convolve, const appWord_t *kernel, unsigned int kernelSize);
+  ~IncrementalConvolve();
+
+  // copies the signal and computes all of its outputs
+  void setSignal(const appWord_t *signal, unsigned int signalSize);
+
+  // overwrites inputs [start, start+size)
+  void edit(unsigned int start, const appWord_t *samples, unsigned int size);
+
+  // for inputs changed through getSignal()
+  void markDirty(unsigned int start, unsigned int end);
+
+  UpdateStats update();
+
+  appWord_t *getSignal();
+  unsigned int getSignalSize() const;
+  const appWord_t *getOutput() const;
+  unsigned int getOutputSize() const;
+
+ protected:
+  Convolve &hw;
+  std::vector<appWord_t> kernel;
+  TapPlan plan;
+  std::vector<appWord_t> signal;
+  std::vector<appWord_t> output;
+
+  // dirty input ranges [first, second)
+  std::vector<std::pair<unsigned, unsigned> > dirty;
+
+  appWord_t *scratch;
+
+  // seconds per FPGA call, per sample sent or received, and per software output
+  double hwFixed;
+  double hwPerSample;
+  double swPerOutput;
+
+  void runHW(unsigned int begin, unsigned int end);
+  void runSW(unsigned int begin, unsigned int end);
+
+  // weight of the newest measurement when updating the models
+  static const double SMOOTHING;
+};
+
+#endif
@@ -0,0 +1,292 @@
+// Greg Stitt
+// University of Florida
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+
+#include "JobRunner.h"
+#include "Timer.h"
+
+using namespace std;
+
+JobRunner::JobRunner(Convolve *convolve, SWEngine &engine, unsigned numReaders,
+                     unsigned numWriters, unsigned queueDepth)
+  : convolve(convolve), engine(engine),
+    numReaders(numReaders > 0 ? numReaders : 1),
+    numWriters(numWriters > 0 ? numWriters : 1),
+    readQueue(queueDepth), writeQueue(queueDepth),
+    entries(NULL), nextEntry(0), numFailed(0), wallTime(0.0) {
+
+  pthread_mutex_init(&mutex, NULL);
+}
+
+
+JobRunner::~JobRunner() {
+
+  pthread_mutex_destroy(&mutex);
+}
+
+
+bool JobRunner::readManifest(const char *file, vector<BatchEntry> &entries) {
+
+  ifstream manifest(file);
+  if (!manifest) {
+    cerr << "Error opening " << file << endl;
+    return false;
+  }
+
+  string line;
+  unsigned lineNum = 0;
+  while (getline(manifest, line)) {
+
+    lineNum++;
+    if (line.empty() || line[0] == '#') continue;
+
+    istringstream fields(line);
+    BatchEntry entry;
+    if (!(fields >> entry.input >> entry.kernel >> entry.output)) {
+      cerr << "Error: " << file << ":" << lineNum << " needs input, kernel and output" << endl;
+      return false;
+    }
+    entries.push_back(entry);
+  }
+
+  return true;
+}
+
+
+void JobRunner::addStats(Stage stage, double busyTime, unsigned long jobs) {
+
+  pthread_mutex_lock(&mutex);
+  stats[stage].busyTime += busyTime;
+  stats[stage].jobs += jobs;
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void JobRunner::readJob(Job *job) {
+
+  try {
+
+    job->input = new SignalFile(job->entry->input.c_str());
+
+    // fault the input in here so the compute stage never waits on the disk.
+    // Only a window is mapped at a time, since the input can be larger than
+    // the address space.
+    const SignalFile &input = *job->input;
+    input.prefetch();
+    unsigned sampleBytes = input.getFormat() == SAMPLE_U16 ? 2 : 1;
+    unsigned long windowSamples = MappedFile::WINDOW_BYTES/sampleBytes;
+    unsigned long pageSize = sysconf(_SC_PAGESIZE);
+    for (unsigned long long first=0; first < input.getSize(); first += windowSamples) {
+
+      unsigned long count = min((unsigned long long) windowSamples, input.getSize()-first);
+      const volatile unsigned char *bytes = input.getFormat() == SAMPLE_U16 ?
+        (const unsigned char *) input.getU16(first, count) : input.getU8(first, count);
+      for (unsigned long i=0; i < count*sampleBytes; i += pageSize) {
+        (void) bytes[i];
+      }
+    }
+
+    SignalFile kernel(job->entry->kernel.c_str());
+    job->kernel.resize(kernel.getSize());
+    for (unsigned i=0; i < job->kernel.size(); i++) {
+      job->kernel[i] = kernel.getFormat() == SAMPLE_U16 ? kernel.getU16()[i] : kernel.getU8()[i];
+    }
+
+    unsigned long long outputSize = job->input->getSize()+job->kernel.size()-1;
+    unsigned sampleRate = job->input->getSampleRate();
+    job->output = new OutputSignalFile(job->entry->output.c_str(), outputSize,
+                                       sampleRate ? sampleRate : 8000);
+    job->ok = !job->kernel.empty();
+  }
+  catch(...) {
+    job->ok = false;
+  }
+}
+
+
+void JobRunner::computeJob(Job *job) {
+
+  if (!job->ok) return;
+
+  const SignalFile &input = *job->input;
+  unsigned long long inputSize = input.getSize();
+  unsigned kernelSize = job->kernel.size();
+  unsigned long long outputSize = inputSize+kernelSize-1;
+
+  try {
+
+    if (convolve != NULL && inputSize <= Convolve::MAX_SIGNAL_SIZE &&
+        kernelSize <= Convolve::MAX_KERNEL_SIZE) {
+
+      if (input.getFormat() == SAMPLE_U16)
+        convolve->start(input.getU16(), inputSize, &job->kernel[0], kernelSize);
+      else
+        convolve->start(input.getU8(), inputSize, &job->kernel[0], kernelSize);
+      while (!convolve->isDone());
+      convolve->getOutput(job->output->getData(), outputSize);
+    }
+    else {
+      // u8 inputs use convolveSWRange
+      convolveSWFile(input, &job->kernel[0], kernelSize, *job->output, &engine);
+    }
+  }
+  catch(...) {
+    job->ok = false;
+  }
+}
+
+
+void JobRunner::writeJob(Job *job) {
+
+  if (job->output != NULL) {
+    job->output->sync();
+    job->output->close();
+  }
+
+  if (!job->ok) {
+    cerr << "Error: failed to convolve " << job->entry->input << endl;
+    pthread_mutex_lock(&mutex);
+    numFailed++;
+    pthread_mutex_unlock(&mutex);
+  }
+
+  delete job->output;
+  delete job->input;
+  delete job;
+}
+
+
+void *JobRunner::readerThread(void *arg) {
+
+  JobRunner *runner = (JobRunner *) arg;
+  Timer timer;
+
+  while (true) {
+
+    pthread_mutex_lock(&runner->mutex);
+    unsigned next = runner->nextEntry++;
+    pthread_mutex_unlock(&runner->mutex);
+    if (next >= runner->entries->size()) break;
+
+    Job *job = new Job;
+    job->entry = &(*runner->entries)[next];
+    job->input = NULL;
+    job->output = NULL;
+
+    timer.start();
+    runner->readJob(job);
+    timer.stop();
+    runner->addStats(STAGE_READ, timer.elapsedTime(), 1);
+
+    runner->readQueue.push(job);
+  }
+
+  return NULL;
+}
+
+
+void *JobRunner::computeThread(void *arg) {
+
+  JobRunner *runner = (JobRunner *) arg;
+  Timer timer;
+  Job *job;
+
+  while (runner->readQueue.pop(job)) {
+
+    timer.start();
+    runner->computeJob(job);
+    timer.stop();
+    runner->addStats(STAGE_COMPUTE, timer.elapsedTime(), 1);
+
+    runner->writeQueue.push(job);
+  }
+
+  return NULL;
+}
+
+
+void *JobRunner::writerThread(void *arg) {
+
+  JobRunner *runner = (JobRunner *) arg;
+  Timer timer;
+  Job *job;
+
+  while (runner->writeQueue.pop(job)) {
+
+    timer.start();
+    runner->writeJob(job);
+    timer.stop();
+    runner->addStats(STAGE_WRITE, timer.elapsedTime(), 1);
+  }
+
+  return NULL;
+}
+
+
+unsigned JobRunner::run(const vector<BatchEntry> &entries) {
+
+  this->entries = &entries;
+  nextEntry = 0;
+  numFailed = 0;
+
+  stats[STAGE_READ].threads = numReaders;
+  stats[STAGE_COMPUTE].threads = 1;
+  stats[STAGE_WRITE].threads = numWriters;
+  for (unsigned i=0; i < STAGE_LAST; i++) {
+    stats[i].jobs = 0;
+    stats[i].busyTime = 0.0;
+  }
+
+  vector<pthread_t> readers(numReaders), writers(numWriters);
+  pthread_t compute;
+  Timer wall;
+  wall.start();
+
+  for (unsigned i=0; i < numReaders; i++) {
+    pthread_create(&readers[i], NULL, readerThread, this);
+  }
+  pthread_create(&compute, NULL, computeThread, this);
+  for (unsigned i=0; i < numWriters; i++) {
+    pthread_create(&writers[i], NULL, writerThread, this);
+  }
+
+  // close each queue once every thread feeding it has finished
+  for (unsigned i=0; i < numReaders; i++) {
+    pthread_join(readers[i], NULL);
+  }
+  readQueue.close();
+  pthread_join(compute, NULL);
+  writeQueue.close();
+  for (unsigned i=0; i < numWriters; i++) {
+    pthread_join(writers[i], NULL);
+  }
+
+  wall.stop();
+  wallTime = wall.elapsedTime();
+  return numFailed;
+}
+
+
+void JobRunner::printStats(ostream &stream) const {
+
+  static const char *names[STAGE_LAST] = {"read", "compute", "write"};
+
+  stream << setw(10) << left << "stage" << right << setw(9) << "threads"
+         << setw(8) << "jobs" << setw(12) << "busy(s)" << setw(14) << "utilization" << endl;
+
+  for (unsigned i=0; i < STAGE_LAST; i++) {
+
+    double utilization = wallTime > 0.0 ? stats[i].busyTime/(wallTime*stats[i].threads) : 0.0;
+    stream << setw(10) << left << names[i] << right << setw(9) << stats[i].threads
+           << setw(8) << stats[i].jobs << setw(12) << fixed << setprecision(4) << stats[i].busyTime
+           << setw(13) << setprecision(1) << utilization*100.0 << "%" << endl;
+  }
+
+  stream << "Wall time = " << setprecision(4) << wallTime << " s"
+         << ", queue depth = " << readQueue.getDepth() << endl;
+}
@@ -0,0 +1,97 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _JOB_RUNNER_H_
+#define _JOB_RUNNER_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <pthread.h>
+
+#include "Convolve.h"
+#include "ConvolveSW.h"
+#include "SignalFile.h"
+#include "BoundedQueue.h"
+
+// one line of a manifest: input, kernel and output file
+struct BatchEntry {
+  std::string input;
+  std::string kernel;
+  std::string output;
+};
+
+
+/** \brief Runs a manifest of file convolutions as a three-stage pipeline.
+ *
+ * Reader threads map each input and kernel, fault the input in, and
+ * preallocate the mapped output file. A single compute thread owns the
+ * device (or the software engine) and writes outputs directly into the
+ * mapped output. Writer threads flush and close the outputs. The stages
+ * are connected by bounded queues, so reads and writes of neighbouring
+ * jobs overlap with computation. Busy time is accumulated per stage to
+ * show which one is the bottleneck.
+ */
+
+class JobRunner {
+
+ public:
+  // convolve can be NULL, in which case every job runs on engine
+  JobRunner(Convolve *convolve, SWEngine &engine, unsigned numReaders,
+            unsigned numWriters, unsigned queueDepth);
+  ~JobRunner();
+
+  static bool readManifest(const char *file, std::vector<BatchEntry> &entries);
+
+  // returns the number of jobs that failed
+  unsigned run(const std::vector<BatchEntry> &entries);
+
+  void printStats(std::ostream &stream) const;
+
+ protected:
+  struct Job {
+    const BatchEntry *entry;
+    SignalFile *input;
+    std::vector<unsigned short> kernel;
+    OutputSignalFile *output;
+    bool ok;
+  };
+
+  enum Stage {
+    STAGE_READ,
+    STAGE_COMPUTE,
+    STAGE_WRITE,
+    STAGE_LAST
+  };
+
+  struct StageStats {
+    unsigned threads;
+    unsigned long jobs;
+    double busyTime;
+  };
+
+  Convolve *convolve;
+  SWEngine &engine;
+  unsigned numReaders;
+  unsigned numWriters;
+  BoundedQueue<Job *> readQueue;
+  BoundedQueue<Job *> writeQueue;
+
+  const std::vector<BatchEntry> *entries;
+  unsigned nextEntry;
+  unsigned numFailed;
+  StageStats stats[STAGE_LAST];
+  double wallTime;
+  pthread_mutex_t mutex;
+
+  void readJob(Job *job);
+  void computeJob(Job *job);
+  void writeJob(Job *job);
+  void addStats(Stage stage, double busyTime, unsigned long jobs);
+
+  static void *readerThread(void *runner);
+  static void *computeThread(void *runner);
+  static void *writerThread(void *runner);
+};
+
+#endif
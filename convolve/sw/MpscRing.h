@@ -0,0 +1,145 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _MPSC_RING_H_
+#define _MPSC_RING_H_
+
+/** \brief Bounded lock-free ring for many producers and one consumer.
+ *
+ * Each cell has a sequence number that tells whether it is free for the
+ * producer that claimed its position (sequence == position) or holds an
+ * item for the consumer (sequence == position+1). Producers claim positions
+ * with a compare-and-swap on the enqueue position, so tryPush() never blocks
+ * behind another thread. All shared accesses use the GCC __sync builtins,
+ * which are full barriers. The capacity is rounded up to a power of 2.
+ */
+
+template <class T>
+class MpscRing {
+
+ public:
+  MpscRing(unsigned long capacity);
+  ~MpscRing();
+
+  // return false if the ring is full/empty
+  bool tryPush(const T &item);
+  bool tryPop(T &item);
+
+  // number of items in the ring, for the consumer. Pushes in progress
+  // are counted.
+  unsigned long getSize();
+  unsigned long getCapacity() const;
+
+ protected:
+  struct Cell {
+    unsigned long sequence;
+    T data;
+  };
+
+  Cell *cells;
+  unsigned long mask;
+  unsigned long enqueuePos;
+
+  // only used by the consumer
+  unsigned long dequeuePos;
+
+  static unsigned long load(unsigned long &value);
+};
+
+
+template <class T>
+MpscRing<T>::MpscRing(unsigned long capacity) : enqueuePos(0), dequeuePos(0) {
+
+  unsigned long size = 2;
+  while (size < capacity) size *= 2;
+
+  cells = new Cell[size];
+  mask = size-1;
+  for (unsigned long i=0; i < size; i++) {
+    cells[i].sequence = i;
+  }
+  __sync_synchronize();
+}
+
+
+template <class T>
+MpscRing<T>::~MpscRing() {
+
+  delete[] cells;
+}
+
+
+template <class T>
+unsigned long MpscRing<T>::load(unsigned long &value) {
+
+  return __sync_fetch_and_add(&value, 0);
+}
+
+
+template <class T>
+bool MpscRing<T>::tryPush(const T &item) {
+
+  unsigned long pos = load(enqueuePos);
+  Cell *cell;
+
+  while (true) {
+
+    cell = &cells[pos & mask];
+    long diff = (long) (load(cell->sequence)-pos);
+
+    if (diff == 0) {
+      // the cell is free, so try to claim its position
+      if (__sync_bool_compare_and_swap(&enqueuePos, pos, pos+1))
+        break;
+      pos = load(enqueuePos);
+    }
+    else if (diff < 0) {
+      // the consumer hasn't freed the cell from the last lap
+      return false;
+    }
+    else {
+      // another producer claimed this position first
+      pos = load(enqueuePos);
+    }
+  }
+
+  cell->data = item;
+
+  // publish the item (sequence becomes pos+1)
+  __sync_fetch_and_add(&cell->sequence, 1);
+  return true;
+}
+
+
+template <class T>
+bool MpscRing<T>::tryPop(T &item) {
+
+  Cell *cell = &cells[dequeuePos & mask];
+
+  if (load(cell->sequence) != dequeuePos+1)
+    return false;
+
+  item = cell->data;
+
+  // free the cell for the producer of the next lap
+  // (sequence becomes dequeuePos+capacity)
+  __sync_fetch_and_add(&cell->sequence, mask);
+  dequeuePos++;
+  return true;
+}
+
+
+template <class T>
+unsigned long MpscRing<T>::getSize() {
+
+  return load(enqueuePos)-dequeuePos;
+}
+
+
+template <class T>
+unsigned long MpscRing<T>::getCapacity() const {
+
+  return mask+1;
+}
+
+#endif
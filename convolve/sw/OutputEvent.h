@@ -0,0 +1,15 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _OUTPUT_EVENT_H_
+#define _OUTPUT_EVENT_H_
+
+/** \brief An output above a detection threshold and its index in the full
+ *  convolution.
+ */
+struct OutputEvent {
+  unsigned int index;
+  unsigned short value;
+};
+
+#endif
@@ -0,0 +1,45 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _OUTPUT_MODE_H_
+#define _OUTPUT_MODE_H_
+
+/** \brief Part of the full convolution that a caller wants.
+ *
+ * OUTPUT_FULL is all inputSize+kernelSize-1 outputs. OUTPUT_SAME is the
+ * inputSize outputs centered on the input, starting at output
+ * (kernelSize-1)/2. OUTPUT_VALID is the inputSize-kernelSize+1 outputs
+ * whose taps all overlap the input, starting at output kernelSize-1, and
+ * is empty if the kernel is longer than the input.
+ */
+enum OutputMode {
+  OUTPUT_FULL,
+  OUTPUT_SAME,
+  OUTPUT_VALID
+};
+
+
+// outputs [begin, end) of the full convolution kept by mode
+inline void getOutputRange(OutputMode mode, unsigned int inputSize, unsigned int kernelSize,
+                           unsigned int &begin, unsigned int &end) {
+
+  switch (mode) {
+
+  case OUTPUT_SAME:
+    begin = (kernelSize-1)/2;
+    end = begin+inputSize;
+    break;
+
+  case OUTPUT_VALID:
+    begin = kernelSize-1;
+    end = inputSize >= kernelSize ? inputSize : begin;
+    break;
+
+  default:
+    begin = 0;
+    end = inputSize+kernelSize-1;
+    break;
+  }
+}
+
+#endif
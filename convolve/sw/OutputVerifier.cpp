@@ -0,0 +1,220 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <ctime>
+#include <sched.h>
+
+#include "OutputVerifier.h"
+#include "ConvolveSW.h"
+
+using namespace std;
+
+OutputVerifier::OutputVerifier(unsigned int samplesPerJob, unsigned int escalateJobs,
+                               unsigned int maxPending) :
+  samplesPerJob(samplesPerJob), escalateJobs(escalateJobs),
+  maxPending(maxPending > 0 ? maxPending : 1), escalated(0), busy(false),
+  stopping(false) {
+
+  stats.jobs = 0;
+  stats.skipped = 0;
+  stats.samplesChecked = 0;
+  stats.fullChecks = 0;
+  stats.alerts = 0;
+  stats.mismatches = 0;
+
+  // xorshift needs a nonzero state
+  randState = (unsigned int) time(NULL) | 1;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  pthread_create(&thread, NULL, verifyThread, this);
+}
+
+
+OutputVerifier::~OutputVerifier() {
+
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+
+  for (unsigned i=0; i < freeJobs.size(); i++) {
+    delete freeJobs[i];
+  }
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&workCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+void OutputVerifier::submit(const appWord_t *signal, unsigned int signalSize,
+                            const appWord_t *kernel, unsigned int kernelSize,
+                            const appWord_t *output) {
+
+  assert(signal != NULL);
+  assert(kernel != NULL);
+  assert(output != NULL);
+
+  // nothing to check
+  if (signalSize == 0 || kernelSize == 0) return;
+
+  unsigned outputSize = signalSize+kernelSize-1;
+
+  pthread_mutex_lock(&mutex);
+  stats.jobs++;
+
+  bool full = escalated > 0;
+  if (full) {
+    escalated--;
+    while (pending.size() >= maxPending) {
+      pthread_cond_wait(&doneCond, &mutex);
+    }
+  }
+  else if (pending.size() >= maxPending) {
+    stats.skipped++;
+    pthread_mutex_unlock(&mutex);
+    return;
+  }
+
+  Job *job;
+  if (freeJobs.empty()) {
+    job = new Job;
+  }
+  else {
+    job = freeJobs.back();
+    freeJobs.pop_back();
+  }
+  pthread_mutex_unlock(&mutex);
+
+  // the copies reuse the capacity of earlier jobs
+  job->signal.assign(signal, signal+signalSize);
+  job->kernel.assign(kernel, kernel+kernelSize);
+  job->output.assign(output, output+outputSize);
+  job->full = full;
+
+  pthread_mutex_lock(&mutex);
+  pending.push_back(job);
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void OutputVerifier::drain() {
+
+  pthread_mutex_lock(&mutex);
+  while (!pending.empty() || busy) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+
+unsigned long OutputVerifier::getAlerts() {
+
+  pthread_mutex_lock(&mutex);
+  unsigned long alerts = stats.alerts;
+  pthread_mutex_unlock(&mutex);
+  return alerts;
+}
+
+
+OutputVerifier::Stats OutputVerifier::getStats() {
+
+  pthread_mutex_lock(&mutex);
+  Stats s = stats;
+  pthread_mutex_unlock(&mutex);
+  return s;
+}
+
+
+unsigned int OutputVerifier::nextRandom() {
+
+  randState ^= randState << 13;
+  randState ^= randState >> 17;
+  randState ^= randState << 5;
+  return randState;
+}
+
+
+void OutputVerifier::verify(Job &job) {
+
+  const appWord_t *signal = &job.signal[0];
+  const appWord_t *kernel = &job.kernel[0];
+  unsigned signalSize = job.signal.size();
+  unsigned kernelSize = job.kernel.size();
+  unsigned outputSize = job.output.size();
+  unsigned long samples = 0;
+  // as many samples as outputs is a full check
+  bool full = job.full || samplesPerJob >= outputSize;
+
+  for (unsigned s=0; s < samplesPerJob && !full; s++) {
+
+    unsigned i = nextRandom() % outputSize;
+    samples++;
+    if (convolveSWAt(signal, signalSize, kernel, kernelSize, i) != job.output[i])
+      full = true;
+  }
+
+  unsigned long mismatches = 0;
+  if (full) {
+    for (unsigned i=0; i < outputSize; i++) {
+      if (convolveSWAt(signal, signalSize, kernel, kernelSize, i) != job.output[i])
+        mismatches++;
+    }
+  }
+
+  pthread_mutex_lock(&mutex);
+  stats.samplesChecked += samples;
+  if (full) stats.fullChecks++;
+  if (mismatches > 0) {
+    stats.alerts++;
+    stats.mismatches += mismatches;
+    escalated = escalateJobs;
+    cerr << "Warning: " << mismatches << " of " << outputSize
+         << " hardware outputs are wrong, verifying the next "
+         << escalateJobs << " jobs in full" << endl;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void *OutputVerifier::verifyThread(void *arg) {
+
+  OutputVerifier *verifier = (OutputVerifier *) arg;
+
+#ifdef SCHED_IDLE
+  // only use cycles that nothing else wants. Failing just leaves the
+  // normal priority.
+  sched_param param;
+  param.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+  pthread_mutex_lock(&verifier->mutex);
+  while (true) {
+
+    while (verifier->pending.empty() && !verifier->stopping) {
+      pthread_cond_wait(&verifier->workCond, &verifier->mutex);
+    }
+    if (verifier->pending.empty()) break;
+
+    Job *job = verifier->pending.front();
+    verifier->pending.pop_front();
+    verifier->busy = true;
+    pthread_mutex_unlock(&verifier->mutex);
+
+    verifier->verify(*job);
+
+    pthread_mutex_lock(&verifier->mutex);
+    verifier->freeJobs.push_back(job);
+    verifier->busy = false;
+    pthread_cond_broadcast(&verifier->doneCond);
+  }
+  pthread_mutex_unlock(&verifier->mutex);
+
+  return NULL;
+}
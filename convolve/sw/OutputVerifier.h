@@ -0,0 +1,92 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _OUTPUT_VERIFIER_H_
+#define _OUTPUT_VERIFIER_H_
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+#include "Convolve.h"
+
+/** \brief Spot-checks accelerator outputs in the background.
+ *
+ * submit() copies a finished job and returns, so the next job can start on
+ * the FPGA while a low-priority (SCHED_IDLE) thread checks samplesPerJob
+ * random outputs of this one, each against its own convolveSWAt(). A job
+ * with any wrong sample is then checked in full and counts as an alert,
+ * and the next escalateJobs jobs after an alert are checked in full too.
+ *
+ * While not escalated, jobs submitted while maxPending jobs are waiting are
+ * skipped rather than stalling the caller. Escalated jobs are never skipped,
+ * so submit() waits for room then.
+ */
+
+class OutputVerifier {
+
+ public:
+  struct Stats {
+    unsigned long jobs;
+    unsigned long skipped;
+    unsigned long samplesChecked;
+    unsigned long fullChecks;
+
+    // jobs with at least one wrong output, and the wrong outputs in them
+    unsigned long alerts;
+    unsigned long mismatches;
+  };
+
+  OutputVerifier(unsigned int samplesPerJob=64, unsigned int escalateJobs=16,
+                 unsigned int maxPending=4);
+
+  // verifies the jobs still pending and stops the thread
+  ~OutputVerifier();
+
+  // output holds the signalSize+kernelSize-1 outputs read from the FPGA
+  void submit(const appWord_t *signal, unsigned int signalSize,
+              const appWord_t *kernel, unsigned int kernelSize,
+              const appWord_t *output);
+
+  // waits until every submitted job has been verified
+  void drain();
+
+  // cheap enough to poll after every job
+  unsigned long getAlerts();
+  Stats getStats();
+
+ protected:
+  struct Job {
+    std::vector<appWord_t> signal;
+    std::vector<appWord_t> kernel;
+    std::vector<appWord_t> output;
+    bool full;
+  };
+
+  unsigned int samplesPerJob;
+  unsigned int escalateJobs;
+  unsigned int maxPending;
+
+  // jobs still to be checked in full after the last alert
+  unsigned int escalated;
+
+  std::deque<Job *> pending;
+  std::vector<Job *> freeJobs;
+  bool busy;
+  bool stopping;
+  Stats stats;
+  pthread_mutex_t mutex;
+  pthread_cond_t workCond;
+  pthread_cond_t doneCond;
+  pthread_t thread;
+
+  // only used by the verifier thread
+  unsigned int randState;
+
+  void verify(Job &job);
+  unsigned int nextRandom();
+
+  static void *verifyThread(void *verifier);
+};
+
+#endif
@@ -0,0 +1,69 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+
+#include "Quantizer.h"
+
+using namespace std;
+
+// rounds to the nearest sample. The comparisons are written so that NaN
+// fails both and ends up as 0, and the rounding is added before clamping so
+// that the compiler can vectorize the loops that call this.
+static inline unsigned short saturate(float value) {
+
+  value += 0.5f;
+  value = value > 0.0f ? value : 0.0f;
+  value = value < (float) Quantizer::MAX_SAMPLE ? value : (float) Quantizer::MAX_SAMPLE;
+  return (unsigned short) (int) value;
+}
+
+
+Quantizer::Quantizer(float scale, float offset) : scale(scale), offset(offset) {
+
+  if (scale == 0.0f) {
+    cerr << "Error: quantizer scale must be nonzero" << endl;
+    throw 1;
+  }
+  invScale = 1.0f/scale;
+}
+
+
+float Quantizer::getScale() const {
+
+  return scale;
+}
+
+
+float Quantizer::getOffset() const {
+
+  return offset;
+}
+
+
+void Quantizer::quantize(const float *input, unsigned int size, unsigned short *output) const {
+
+  // copies keep the compiler from assuming the stores alias them
+  const float s = scale, o = offset;
+  for (unsigned i=0; i < size; i++) {
+    output[i] = saturate(input[i]*s+o);
+  }
+}
+
+
+void Quantizer::quantize(const int *input, unsigned int size, unsigned short *output) const {
+
+  const float s = scale, o = offset;
+  for (unsigned i=0; i < size; i++) {
+    output[i] = saturate((float) input[i]*s+o);
+  }
+}
+
+
+void Quantizer::dequantize(const unsigned short *input, unsigned int size, float *output) const {
+
+  const float s = invScale, o = offset;
+  for (unsigned i=0; i < size; i++) {
+    output[i] = ((float) input[i]-o)*s;
+  }
+}
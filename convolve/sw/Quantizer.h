@@ -0,0 +1,37 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _QUANTIZER_H_
+#define _QUANTIZER_H_
+
+/** \brief Converts between real-valued samples and the accelerator's
+ *  unsigned 16-bit samples.
+ *
+ * quantize() maps x to round(x*scale+offset), saturated to [0, 0xffff]
+ * (NaN becomes 0), and dequantize() maps a sample q back to
+ * (q-offset)/scale. The loops have no branches or calls and work on
+ * blocks of independent samples, so the compiler turns them into SIMD
+ * code (SSE on the emulator host, NEON with -mfpu=neon on the board).
+ */
+
+class Quantizer {
+
+ public:
+  Quantizer(float scale=1.0f, float offset=0.0f);
+
+  float getScale() const;
+  float getOffset() const;
+
+  void quantize(const float *input, unsigned int size, unsigned short *output) const;
+  void quantize(const int *input, unsigned int size, unsigned short *output) const;
+  void dequantize(const unsigned short *input, unsigned int size, float *output) const;
+
+  static const unsigned short MAX_SAMPLE = 0xffff;
+
+ protected:
+  float scale;
+  float offset;
+  float invScale;
+};
+
+#endif
@@ -0,0 +1,392 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SignalFile.h"
+#include "App.h"
+#include "ConvolveSW.h"
+
+using namespace std;
+
+#define WAV_HEADER_BYTES 44
+#define WAV_FORMAT_PCM 1
+
+static void fileError(const string &msg, const char *file) {
+
+  cerr << "Error: " << msg << " " << file << endl;
+  throw 1;
+}
+
+
+static unsigned readLE16(const unsigned char *p) {
+
+  return p[0] | (p[1] << 8);
+}
+
+
+static unsigned readLE32(const unsigned char *p) {
+
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned) p[3] << 24);
+}
+
+
+static void writeLE16(unsigned char *p, unsigned value) {
+
+  p[0] = value & 0xff;
+  p[1] = (value >> 8) & 0xff;
+}
+
+
+static void writeLE32(unsigned char *p, unsigned value) {
+
+  writeLE16(p, value & 0xffff);
+  writeLE16(p+2, value >> 16);
+}
+
+
+MappedFile::MappedFile(int prot) : fd(-1), prot(prot), fileBytes(0), map(NULL),
+                                   mapBytes(0), mapOffset(0) {
+
+}
+
+
+MappedFile::~MappedFile() {
+
+  closeFile();
+}
+
+
+unsigned char *MappedFile::mapRange(unsigned long long offset, unsigned long long bytes) const {
+
+  if (map != NULL && offset >= mapOffset && offset+bytes <= mapOffset+mapBytes)
+    return (unsigned char *) map+(offset-mapOffset);
+
+  unmap();
+
+  // windows start on a page, and normally extend WINDOW_BYTES past offset
+  unsigned long long pageBytes = sysconf(_SC_PAGESIZE);
+  unsigned long long start = offset-offset % pageBytes;
+  unsigned long long len = offset-start+(bytes > WINDOW_BYTES ? bytes : WINDOW_BYTES);
+  if (start+len > fileBytes) len = fileBytes-start;
+
+  if (offset+bytes > fileBytes || len != (size_t) len) {
+    cerr << "Error: can't map bytes " << offset << " to " << offset+bytes
+         << " of a " << fileBytes << " byte file" << endl;
+    throw 1;
+  }
+
+  void *window = mmap(NULL, len, prot, MAP_SHARED, fd, start);
+  if (window == MAP_FAILED) {
+    cerr << "Error: can't map " << len << " bytes of a file" << endl;
+    throw 1;
+  }
+  madvise(window, len, MADV_SEQUENTIAL);
+
+  map = window;
+  mapBytes = len;
+  mapOffset = start;
+  return (unsigned char *) map+(offset-mapOffset);
+}
+
+
+void MappedFile::unmap() const {
+
+  if (map != NULL) {
+    munmap(map, mapBytes);
+    map = NULL;
+  }
+}
+
+
+void MappedFile::closeFile() {
+
+  unmap();
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+
+SignalFile::SignalFile(const char *file, SampleFormat rawFormat) : MappedFile(PROT_READ),
+                                                                   dataOffset(0),
+                                                                   sampleRate(0) {
+
+  // the MappedFile destructor closes the file if anything below throws
+  fd = open(file, O_RDONLY);
+  if (fd < 0) fileError("can't open", file);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) fileError("can't read", file);
+  fileBytes = st.st_size;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  size_t headerBytes = fileBytes < WINDOW_BYTES ? fileBytes : WINDOW_BYTES;
+  const unsigned char *header = mapRange(0, headerBytes);
+  if (!parseWav(header, headerBytes)) {
+
+    if (headerBytes > 4 && memcmp(header, "RIFF", 4) == 0)
+      fileError("unsupported WAV format in", file);
+
+    format = rawFormat;
+    dataOffset = 0;
+    size = format == SAMPLE_U16 ? fileBytes/2 : fileBytes;
+  }
+}
+
+
+bool SignalFile::parseWav(const unsigned char *file, size_t bytes) {
+
+  if (bytes < WAV_HEADER_BYTES || memcmp(file, "RIFF", 4) != 0 ||
+      memcmp(file+8, "WAVE", 4) != 0)
+    return false;
+
+  bool haveFormat = false;
+  unsigned bits = 0;
+  size_t pos = 12;
+
+  while (pos+8 <= bytes) {
+
+    const unsigned char *chunk = file+pos;
+    unsigned long long chunkBytes = readLE32(chunk+4);
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunkBytes >= 16) {
+
+      // only mono PCM can be convolved directly
+      if (readLE16(chunk+8) != WAV_FORMAT_PCM || readLE16(chunk+10) != 1)
+        return false;
+
+      sampleRate = readLE32(chunk+12);
+      bits = readLE16(chunk+22);
+      if (bits != 8 && bits != 16)
+        return false;
+      haveFormat = true;
+    }
+    else if (memcmp(chunk, "data", 4) == 0 && haveFormat) {
+
+      // only the header has to be in the first window, not the samples
+      if (pos+8+chunkBytes > fileBytes)
+        chunkBytes = fileBytes-pos-8;
+
+      format = bits == 8 ? SAMPLE_U8 : SAMPLE_U16;
+      dataOffset = pos+8;
+      size = format == SAMPLE_U16 ? chunkBytes/2 : chunkBytes;
+      return true;
+    }
+
+    // chunks are padded to an even number of bytes
+    pos += 8+chunkBytes+(chunkBytes & 1);
+  }
+
+  return false;
+}
+
+
+SampleFormat SignalFile::getFormat() const {
+
+  return format;
+}
+
+
+unsigned long long SignalFile::getSize() const {
+
+  return size;
+}
+
+
+unsigned SignalFile::getSampleRate() const {
+
+  return sampleRate;
+}
+
+
+const unsigned char *SignalFile::mapSamples(unsigned long long first, unsigned long count) const {
+
+  assert(first+count <= size);
+  unsigned sampleBytes = format == SAMPLE_U16 ? 2 : 1;
+  return mapRange(dataOffset+first*sampleBytes, (unsigned long long) count*sampleBytes);
+}
+
+
+const unsigned short *SignalFile::getU16() const {
+
+  if (size != (unsigned long) size) {
+    cerr << "Error: a " << size << " sample signal doesn't fit in memory" << endl;
+    throw 1;
+  }
+  return getU16(0, size);
+}
+
+
+const unsigned char *SignalFile::getU8() const {
+
+  if (size != (unsigned long) size) {
+    cerr << "Error: a " << size << " sample signal doesn't fit in memory" << endl;
+    throw 1;
+  }
+  return getU8(0, size);
+}
+
+
+const unsigned short *SignalFile::getU16(unsigned long long first, unsigned long count) const {
+
+  return format == SAMPLE_U16 ? (const unsigned short *) mapSamples(first, count) : NULL;
+}
+
+
+const unsigned char *SignalFile::getU8(unsigned long long first, unsigned long count) const {
+
+  return format == SAMPLE_U8 ? mapSamples(first, count) : NULL;
+}
+
+
+void SignalFile::prefetch() const {
+
+  posix_fadvise(fd, dataOffset, size*(format == SAMPLE_U16 ? 2 : 1), POSIX_FADV_WILLNEED);
+}
+
+
+OutputSignalFile::OutputSignalFile(const char *file, unsigned long long size,
+                                   unsigned sampleRate) :
+  MappedFile(PROT_READ|PROT_WRITE), size(size) {
+
+  size_t len = strlen(file);
+  bool wav = len > 4 && strcmp(file+len-4, ".wav") == 0;
+  headerBytes = wav ? WAV_HEADER_BYTES : 0;
+
+  unsigned long long dataBytes = size*sizeof(unsigned short);
+  if (wav && dataBytes > 0xffffffffull-(WAV_HEADER_BYTES-8))
+    fileError("too many samples for a WAV file:", file);
+
+  // leave room for whole-word transfers directly into the file
+  const unsigned wordBytes = sizeof(boardWord_t);
+  fileBytes = headerBytes+(dataBytes+wordBytes-1)/wordBytes*wordBytes;
+
+  // the MappedFile destructor closes the file if anything below throws
+  fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0644);
+  if (fd < 0) fileError("can't create", file);
+
+  if (ftruncate(fd, fileBytes) != 0 || posix_fallocate(fd, 0, fileBytes) != 0)
+    fileError("can't allocate", file);
+
+  if (wav) {
+
+    unsigned char *bytes = mapRange(0, headerBytes);
+    memcpy(bytes, "RIFF", 4);
+    writeLE32(bytes+4, WAV_HEADER_BYTES-8+dataBytes);
+    memcpy(bytes+8, "WAVEfmt ", 8);
+    writeLE32(bytes+16, 16);
+    writeLE16(bytes+20, WAV_FORMAT_PCM);
+    writeLE16(bytes+22, 1);
+    writeLE32(bytes+24, sampleRate);
+    writeLE32(bytes+28, sampleRate*sizeof(unsigned short));
+    writeLE16(bytes+32, sizeof(unsigned short));
+    writeLE16(bytes+34, 16);
+    memcpy(bytes+36, "data", 4);
+    writeLE32(bytes+40, dataBytes);
+  }
+}
+
+
+OutputSignalFile::~OutputSignalFile() {
+
+  close();
+}
+
+
+void OutputSignalFile::sync() {
+
+  if (fd < 0) return;
+
+  // earlier windows are already unmapped, but still have to reach the disk
+  if (map != NULL)
+    msync(map, mapBytes, MS_SYNC);
+  fsync(fd);
+}
+
+
+void OutputSignalFile::close() {
+
+  if (fd < 0) return;
+
+  unmap();
+  if (ftruncate(fd, headerBytes+size*sizeof(unsigned short)) != 0)
+    cerr << "Error: can't truncate output file" << endl;
+  closeFile();
+}
+
+
+unsigned short *OutputSignalFile::getData() {
+
+  if (size != (unsigned long) size) {
+    cerr << "Error: a " << size << " sample signal doesn't fit in memory" << endl;
+    throw 1;
+  }
+
+  // includes the room for whole-word transfers
+  return (unsigned short *) mapRange(headerBytes, fileBytes-headerBytes);
+}
+
+
+unsigned short *OutputSignalFile::getData(unsigned long long first, unsigned long count) {
+
+  assert(first+count <= size);
+  return (unsigned short *) mapRange(headerBytes+first*sizeof(unsigned short),
+                                     (unsigned long long) count*sizeof(unsigned short));
+}
+
+
+unsigned long long OutputSignalFile::getSize() const {
+
+  return size;
+}
+
+
+void convolveSWFile(const SignalFile &input, const unsigned short *kernel,
+                    unsigned int kernelSize, OutputSignalFile &output,
+                    SWEngine *engine) {
+
+  assert(kernelSize > 0);
+
+  const unsigned long long inputSize = input.getSize();
+  const unsigned long long outputSize = inputSize+kernelSize-1;
+  const unsigned long block = MappedFile::WINDOW_BYTES/sizeof(unsigned short);
+
+  assert(output.getSize() >= outputSize);
+
+  for (unsigned long long begin=0; begin < outputSize; begin += block) {
+
+    unsigned long long end = begin+block < outputSize ? begin+block : outputSize;
+
+    // outputs [begin, end) only cover the inputs [first, last), and the
+    // window's own edges are real edges wherever a tap crosses them
+    unsigned long long first = begin >= kernelSize-1 ? begin-(kernelSize-1) : 0;
+    unsigned long long last = end < inputSize ? end : inputSize;
+    unsigned count = last-first;
+    unsigned b = begin-first, e = end-first;
+
+    unsigned short *window = output.getData(begin, end-begin);
+
+    if (input.getFormat() == SAMPLE_U16) {
+      const unsigned short *samples = input.getU16(first, count);
+      if (engine != NULL) {
+        engine->start(samples, count, kernel, kernelSize, window, b, e, b);
+        engine->wait();
+      }
+      else {
+        convolveSWRange(samples, count, kernel, kernelSize, window, b, e, b);
+      }
+    }
+    else {
+      convolveSWRange(input.getU8(first, count), count, kernel, kernelSize, window, b, e, b);
+    }
+  }
+}
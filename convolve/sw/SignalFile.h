@@ -0,0 +1,141 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _SIGNAL_FILE_H_
+#define _SIGNAL_FILE_H_
+
+#include <cstddef>
+
+enum SampleFormat {
+  SAMPLE_U8,
+  SAMPLE_U16
+};
+
+class SWEngine;
+
+
+/** \brief A file that is memory-mapped a window at a time.
+ *
+ * Only WINDOW_BYTES (or a single larger request) are mapped at once, so
+ * files larger than the address space, such as multi-GB recordings on the
+ * 32-bit board, can still be used. File offsets are 64-bit, which needs
+ * the -D_FILE_OFFSET_BITS=64 in the Makefile on 32-bit targets. Closes the
+ * file when destroyed, including when a derived constructor throws.
+ */
+
+class MappedFile {
+
+ public:
+  static const size_t WINDOW_BYTES = 64 << 20;
+
+ protected:
+  MappedFile(int prot);
+  ~MappedFile();
+
+  int fd;
+  int prot;
+  unsigned long long fileBytes;
+
+  // the current window
+  mutable void *map;
+  mutable size_t mapBytes;
+  mutable unsigned long long mapOffset;
+
+  // returns the mapping of [offset, offset+bytes), mapping a new window if
+  // the current one doesn't hold all of it
+  unsigned char *mapRange(unsigned long long offset, unsigned long long bytes) const;
+  void unmap() const;
+  void closeFile();
+};
+
+
+/** \brief Read-only, memory-mapped signal file.
+ *
+ * Supports raw little-endian u8/u16 samples and mono PCM WAV files
+ * (detected from the RIFF header). The samples are used in place from the
+ * mapping, which is advised for sequential access, so they can be passed
+ * directly to Convolve::start or the software engines without being
+ * copied. 8-bit WAV samples are unsigned. 16-bit WAV samples are used as
+ * their raw 16-bit pattern.
+ *
+ * Each get call returns a pointer that is valid until the next one, which
+ * may map another window.
+ */
+
+class SignalFile : public MappedFile {
+
+ public:
+  SignalFile(const char *file, SampleFormat rawFormat=SAMPLE_U16);
+
+  SampleFormat getFormat() const;
+  unsigned long long getSize() const;
+
+  // 0 for raw files
+  unsigned getSampleRate() const;
+
+  // the whole signal, which has to fit in the address space. Return NULL
+  // if the file has the other format.
+  const unsigned short *getU16() const;
+  const unsigned char *getU8() const;
+
+  // samples [first, first+count) only
+  const unsigned short *getU16(unsigned long long first, unsigned long count) const;
+  const unsigned char *getU8(unsigned long long first, unsigned long count) const;
+
+  // asks the kernel to start reading the whole file in the background
+  void prefetch() const;
+
+ protected:
+  // byte offset of the first sample in the file
+  unsigned long long dataOffset;
+  unsigned long long size;
+  SampleFormat format;
+  unsigned sampleRate;
+
+  bool parseWav(const unsigned char *header, size_t headerBytes);
+  const unsigned char *mapSamples(unsigned long long first, unsigned long count) const;
+};
+
+
+/** \brief Write-only, memory-mapped u16 signal file.
+ *
+ * The file is preallocated to a safe transfer size and mapped, so outputs
+ * can be written directly into it by Convolve::getOutput or the software
+ * engines. The file is truncated to its exact size when closed. Files
+ * named *.wav get a 16-bit mono PCM header. Like SignalFile, pointers are
+ * valid until the next getData().
+ */
+
+class OutputSignalFile : public MappedFile {
+
+ public:
+  OutputSignalFile(const char *file, unsigned long long size, unsigned sampleRate=8000);
+  ~OutputSignalFile();
+
+  // the whole signal, which has to fit in the address space
+  unsigned short *getData();
+
+  // outputs [first, first+count) only
+  unsigned short *getData(unsigned long long first, unsigned long count);
+  unsigned long long getSize() const;
+
+  // writes the outputs back to the file
+  void sync();
+  void close();
+
+ protected:
+  size_t headerBytes;
+  unsigned long long size;
+};
+
+
+/** \brief Convolves a whole file in software, one window of outputs at a
+ *  time, so the input and output files never have to be mapped whole.
+ *  Uses engine for u16 inputs if it isn't NULL, and convolveSWRange
+ *  otherwise. output needs input.getSize()+kernelSize-1 samples.
+ */
+void convolveSWFile(const SignalFile &input, const unsigned short *kernel,
+                    unsigned int kernelSize, OutputSignalFile &output,
+                    SWEngine *engine=NULL);
+
+#endif
@@ -0,0 +1,155 @@
+// Greg Stitt
+// University of Florida
+
+#include <cassert>
+
+#include "StreamingConvolver.h"
+#include "Timer.h"
+
+using namespace std;
+
+StreamingConvolver::StreamingConvolver(Convolve &convolve, const appWord_t *kernel,
+                                       unsigned int kernelSize, double deadline)
+  : hw(&convolve), sw(NULL), kernel(kernel, kernel+kernelSize), deadline(deadline) {
+
+  init();
+}
+
+
+StreamingConvolver::StreamingConvolver(SWEngine &engine, const appWord_t *kernel,
+                                       unsigned int kernelSize, double deadline)
+  : hw(NULL), sw(&engine), kernel(kernel, kernel+kernelSize), deadline(deadline) {
+
+  init();
+}
+
+
+StreamingConvolver::~StreamingConvolver() {
+
+  App::releaseBuffer(staging);
+  App::releaseBuffer(scratch);
+}
+
+
+void StreamingConvolver::init() {
+
+  assert(!kernel.empty() && kernel.size() <= Convolve::MAX_KERNEL_SIZE);
+
+  overlap = kernel.size()-1;
+  maxChunk = Convolve::MAX_SIGNAL_SIZE-overlap;
+  history.assign(overlap, 0);
+  historyHead = 0;
+
+  staging = (appWord_t *) App::allocBuffer(Convolve::MAX_SIGNAL_SIZE*sizeof(appWord_t));
+  scratch = (appWord_t *) App::allocBuffer(Convolve::MAX_OUTPUT_SIZE*sizeof(appWord_t));
+
+  numBlocks = 0;
+  numMisses = 0;
+  lastLatency = 0.0;
+  maxLatency = 0.0;
+  totalLatency = 0.0;
+}
+
+
+unsigned int StreamingConvolver::getMaxChunk() const {
+
+  return maxChunk;
+}
+
+
+void StreamingConvolver::processChunk(const appWord_t *chunk, unsigned int size,
+                                      appWord_t *output) {
+
+  // linearize the ring buffer in front of the new samples
+  for (unsigned i=0; i < overlap; i++) {
+    staging[i] = history[(historyHead+i) % overlap];
+  }
+  memcpy(staging+overlap, chunk, size*sizeof(appWord_t));
+
+  // outputs [overlap, overlap+size) of the staged signal are the next
+  // size outputs of the stream
+  unsigned stagedSize = size+overlap;
+  if (hw != NULL) {
+    hw->start(staging, stagedSize, &kernel[0], kernel.size());
+    while (!hw->isDone());
+    hw->getOutput(scratch, stagedSize);
+  }
+  else {
+    sw->convolve(staging, stagedSize, &kernel[0], kernel.size(),
+                 scratch, overlap, stagedSize);
+  }
+  memcpy(output, scratch+overlap, size*sizeof(appWord_t));
+
+  // keep the newest overlap samples, replacing the oldest ones
+  for (unsigned i=0; i < overlap; i++) {
+    history[historyHead] = staging[size+i];
+    historyHead = (historyHead+1) % overlap;
+  }
+}
+
+
+void StreamingConvolver::process(const appWord_t *block, unsigned int blockSize,
+                                 appWord_t *output) {
+
+  assert(block != NULL || blockSize == 0);
+  assert(output != NULL || blockSize == 0);
+
+  Timer timer;
+  timer.start();
+
+  for (unsigned i=0; i < blockSize; i += maxChunk) {
+
+    unsigned size = blockSize-i < maxChunk ? blockSize-i : maxChunk;
+    processChunk(block+i, size, output+i);
+  }
+
+  timer.stop();
+  lastLatency = timer.elapsedTime();
+  totalLatency += lastLatency;
+  if (lastLatency > maxLatency) maxLatency = lastLatency;
+  if (lastLatency > deadline) numMisses++;
+  numBlocks++;
+}
+
+
+void StreamingConvolver::flush(appWord_t *output) {
+
+  // the tail of the stream is what the carried samples produce when
+  // followed by zeros
+  vector<appWord_t> zeros(overlap, 0);
+  if (overlap > 0)
+    processChunk(&zeros[0], overlap, output);
+
+  history.assign(overlap, 0);
+  historyHead = 0;
+}
+
+
+unsigned long StreamingConvolver::getNumBlocks() const {
+
+  return numBlocks;
+}
+
+
+unsigned long StreamingConvolver::getNumMisses() const {
+
+  return numMisses;
+}
+
+
+double StreamingConvolver::getLastLatency() const {
+
+  return lastLatency;
+}
+
+
+double StreamingConvolver::getMaxLatency() const {
+
+  return maxLatency;
+}
+
+
+double StreamingConvolver::getMeanLatency() const {
+
+  return numBlocks > 0 ? totalLatency/numBlocks : 0.0;
+}
@@ -0,0 +1,76 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _STREAMING_CONVOLVER_H_
+#define _STREAMING_CONVOLVER_H_
+
+#include <vector>
+
+#include "Convolve.h"
+#include "ConvolveSW.h"
+
+/** \brief Convolves a continuous stream that arrives in blocks.
+ *
+ * Unlike Convolve::start, which treats every call as an isolated signal,
+ * the convolver carries the last kernelSize-1 input samples from block to
+ * block in a ring buffer, so every block of n samples produces exactly the
+ * n matching outputs with no edge artifacts. Blocks are processed in
+ * chunks of at most getMaxChunk() samples, which bounds the work (and
+ * latency) of each accelerator or software call regardless of block size.
+ *
+ * The latency of every block is compared against a deadline.
+ */
+
+class StreamingConvolver {
+
+ public:
+  StreamingConvolver(Convolve &convolve, const appWord_t *kernel,
+                     unsigned int kernelSize, double deadline);
+  StreamingConvolver(SWEngine &engine, const appWord_t *kernel,
+                     unsigned int kernelSize, double deadline);
+  ~StreamingConvolver();
+
+  /** \brief Processes the next block and writes blockSize outputs. */
+  void process(const appWord_t *block, unsigned int blockSize, appWord_t *output);
+
+  /** \brief Ends the stream: writes the final kernelSize-1 outputs and
+   *  clears the carried state so a new stream can start.
+   */
+  void flush(appWord_t *output);
+
+  unsigned int getMaxChunk() const;
+
+  // latency statistics, in seconds
+  unsigned long getNumBlocks() const;
+  unsigned long getNumMisses() const;
+  double getLastLatency() const;
+  double getMaxLatency() const;
+  double getMeanLatency() const;
+
+ protected:
+  Convolve *hw;
+  SWEngine *sw;
+  std::vector<appWord_t> kernel;
+  unsigned int overlap;
+  unsigned int maxChunk;
+
+  // the last overlap input samples; the oldest is at historyHead
+  std::vector<appWord_t> history;
+  unsigned int historyHead;
+
+  // history followed by the current chunk, and the outputs of a chunk
+  appWord_t *staging;
+  appWord_t *scratch;
+
+  double deadline;
+  unsigned long numBlocks;
+  unsigned long numMisses;
+  double lastLatency;
+  double maxLatency;
+  double totalLatency;
+
+  void init();
+  void processChunk(const appWord_t *chunk, unsigned int size, appWord_t *output);
+};
+
+#endif
@@ -0,0 +1,113 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <time.h>
+
+#include "TraceBoard.h"
+
+using namespace std;
+
+TraceBoard::TraceBoard(Board &board, const char *traceFile, bool hashPayload)
+  : board(board), hashPayload(hashPayload), numBuffered(0) {
+
+  this->traceFile = fopen(traceFile, "wb");
+  if (this->traceFile == NULL) {
+    cerr << "Error opening " << traceFile << endl;
+    throw 1;
+  }
+
+  TraceHeader header;
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.flags = hashPayload ? TRACE_FLAG_HASH : 0;
+  header.recordBytes = sizeof(TraceRecord);
+  fwrite(&header, sizeof(TraceHeader), 1, this->traceFile);
+
+  buffer = new TraceRecord[BUFFER_RECORDS];
+  startTime = currentTime();
+}
+
+
+TraceBoard::~TraceBoard() {
+
+  flush();
+  fclose(traceFile);
+  delete[] buffer;
+}
+
+
+uint64_t TraceBoard::currentTime() {
+
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+
+uint32_t TraceBoard::hash(const unsigned *data, unsigned long words) {
+
+  // 32-bit FNV-1a over the transferred words
+  uint32_t h = 2166136261u;
+  const unsigned char *bytes = (const unsigned char *) data;
+
+  for (unsigned long i=0; i < words*sizeof(boardWord_t); i++) {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+
+void TraceBoard::flush() {
+
+  if (numBuffered > 0) {
+    fwrite(buffer, sizeof(TraceRecord), numBuffered, traceFile);
+    numBuffered = 0;
+  }
+  fflush(traceFile);
+}
+
+
+bool TraceBoard::write(unsigned *data, unsigned long addr, unsigned long words) {
+
+  uint64_t start = currentTime();
+  bool ok = board.write(data, addr, words);
+  uint64_t stop = currentTime();
+  record(false, data, addr, words, start, stop);
+  return ok;
+}
+
+
+bool TraceBoard::read(unsigned *data, unsigned long addr, unsigned long words) {
+
+  uint64_t start = currentTime();
+  bool ok = board.read(data, addr, words);
+  uint64_t stop = currentTime();
+  record(true, data, addr, words, start, stop);
+  return ok;
+}
+
+
+void TraceBoard::record(bool isRead, const unsigned *data, unsigned long addr,
+                        unsigned long words, uint64_t start, uint64_t stop) {
+
+  TraceRecord &r = buffer[numBuffered];
+  r.time = start - startTime;
+  r.duration = stop - start;
+  r.addr = addr | (isRead ? TRACE_READ_BIT : 0);
+  r.words = words;
+
+  if (words == 1)
+    r.payload = data[0];
+  else if (hashPayload)
+    r.payload = hash(data, words);
+  else
+    r.payload = 0;
+
+  if (++numBuffered == BUFFER_RECORDS) {
+    fwrite(buffer, sizeof(TraceRecord), numBuffered, traceFile);
+    numBuffered = 0;
+  }
+}
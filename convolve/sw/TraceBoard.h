@@ -0,0 +1,74 @@
+// Greg Stitt
+// University of Florida
+// TraceBoard class
+// This class decorates another Board and records every read and write that
+// passes through it to a compact binary trace file. The trace can later be
+// replayed against an EmuBoard or the real board with trace_replay.
+
+#ifndef _TRACE_BOARD_H_
+#define _TRACE_BOARD_H_
+
+#include <cstdio>
+#include <stdint.h>
+
+#include "Board.h"
+
+#define TRACE_MAGIC 0x43525443  // "CTRC"
+#define TRACE_VERSION 1
+
+// set in TraceHeader::flags when bulk payloads were hashed
+#define TRACE_FLAG_HASH 0x1
+
+// set in TraceRecord::addr for reads
+#define TRACE_READ_BIT 0x80000000u
+
+struct TraceHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t recordBytes;
+};
+
+// One record per Board::read/write. For single-word transfers (i.e.,
+// register accesses) payload is the word itself, which is what allows a
+// trace to be replayed. For larger transfers it is an FNV-1a hash of the
+// data if hashing was enabled, and 0 otherwise.
+struct TraceRecord {
+  uint64_t time;      // ns from the start of the trace to the access
+  uint32_t duration;  // ns spent in the decorated board
+  uint32_t addr;      // word address, or'ed with TRACE_READ_BIT for reads
+  uint32_t words;
+  uint32_t payload;
+};
+
+class TraceBoard : public Board {
+
+ public:
+  TraceBoard(Board &board, const char *traceFile, bool hashPayload=false);
+  virtual ~TraceBoard();
+
+  virtual bool write(unsigned *data, unsigned long addr, unsigned long words);
+  virtual bool read(unsigned *data, unsigned long addr, unsigned long words);
+
+  void flush();
+
+  static uint64_t currentTime();
+  static uint32_t hash(const unsigned *data, unsigned long words);
+
+ protected:
+  Board &board;
+  FILE *traceFile;
+  bool hashPayload;
+  uint64_t startTime;
+
+  // records are buffered and written in blocks to keep the overhead of
+  // tracing small relative to the transfers being traced
+  static const unsigned BUFFER_RECORDS = 4096;
+  TraceRecord *buffer;
+  unsigned numBuffered;
+
+  void record(bool isRead, const unsigned *data, unsigned long addr,
+              unsigned long words, uint64_t start, uint64_t stop);
+};
+
+#endif
@@ -0,0 +1,84 @@
+// Greg Stitt
+// University of Florida
+// batch.cpp
+//
+// Description: Convolves every (input, kernel, output) entry of a manifest
+// with a pipeline of reader, compute and writer threads, and reports how
+// busy each stage was.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "Board.h"
+#include "EmuBoard.h"
+#include "Convolve.h"
+#include "ConvolveSW.h"
+#include "JobRunner.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+
+  unsigned numReaders = 2;
+  unsigned numWriters = 2;
+  unsigned numThreads = 1;
+  unsigned queueDepth = 4;
+  bool badArgs = argc < 3;
+
+  for (int i=3; i < argc && !badArgs; i++) {
+    if (strcmp(argv[i], "-readers") == 0 && i+1 < argc)
+      numReaders = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-writers") == 0 && i+1 < argc)
+      numWriters = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-threads") == 0 && i+1 < argc)
+      numThreads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-depth") == 0 && i+1 < argc)
+      queueDepth = atoi(argv[++i]);
+    else
+      badArgs = true;
+  }
+
+  if (badArgs || numThreads == 0) {
+    cerr << "Usage: " << argv[0] << " manifest (bitfile | -emu | -sw)" << endl
+         << "       [-readers n] [-writers n] [-threads n] [-depth n]" << endl;
+    cerr << "Each manifest line is: input kernel output" << endl;
+    return -1;
+  }
+
+  vector<BatchEntry> entries;
+  if (!JobRunner::readManifest(argv[1], entries)) {
+    return -1;
+  }
+
+  // setup clock frequencies
+  vector<float> clocks(Board::NUM_FPGA_CLOCKS);
+  clocks[0] = 100.0;
+  clocks[1] = 133.0;
+  clocks[2] = 100.0;
+  clocks[3] = 100.0;
+
+  // initialize board, unless only software is used
+  Board *board = NULL;
+  try {
+    if (strcmp(argv[2], "-emu") == 0)
+      board = new EmuBoard();
+    else if (strcmp(argv[2], "-sw") != 0)
+      board = new Board(argv[2], clocks);
+  }
+  catch(...) {
+    exit(-1);
+  }
+
+  Convolve *convolve = board != NULL ? new Convolve(*board) : NULL;
+  SWEngine engine(numThreads);
+  JobRunner runner(convolve, engine, numReaders, numWriters, queueDepth);
+
+  unsigned failed = runner.run(entries);
+  cout << "Convolved " << entries.size()-failed << " of " << entries.size() << " entries" << endl << endl;
+  runner.printStats(cout);
+
+  delete convolve;
+  delete board;
+  return failed == 0 ? 0 : -1;
+}
@@ -11,12 +11,25 @@
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 
 #include <unistd.h>
 
 #include "Board.h"
+#include "EmuBoard.h"
+#include "TraceBoard.h"
 #include "Timer.h"
 #include "Convolve.h"
+#include "ConvolvePool.h"
+#include "ConvolveSW.h"
+#include "HybridConvolve.h"
+#include "StreamingConvolver.h"
+#include "SignalFile.h"
+#include "ConvolveDispatcher.h"
+#include "DeadlineScheduler.h"
+#include "ConvolveCache.h"
+#include "IncrementalConvolve.h"
+#include "OutputVerifier.h"
 
 using namespace std;
 
@@ -31,30 +44,6 @@ using namespace std;
 #define SMALL_SIGNAL 10
 
 
-void convolveSW(const unsigned short* input, unsigned int inputSize,
-                const unsigned short* kernel, unsigned int kernelSize,
-                unsigned short *output) {
-
-  unsigned int i,j;
-  unsigned int outputSize = inputSize+kernelSize-1;
-  memset(output, 0, sizeof(unsigned short)*outputSize);
-
-  for (i=0; i < outputSize; i++) {
-    for (j=0; j < kernelSize; j++) {
-
-      unsigned int temp;
-      unsigned int product;
-      unsigned int sum;
-      temp = (i>=j && i-j < inputSize) ? input[i-j] : 0;
-      product = (unsigned int) kernel[j]*temp;      
-      product = product > 0xffff ? 0xffff : product;
-      sum = product + (unsigned int) output[i] > 0xffff ? 0xffff : product+output[i];
-      output[i] = sum; 
-    }
-  }
-}
-
-
 bool convolveHW(Convolve &convolve,
                 const unsigned short* input, unsigned int inputSize,
                 const unsigned short* kernel, unsigned int kernelSize,
@@ -208,167 +197,1933 @@ void testRand(Convolve &convolve,
 }
 
 
-int main(int argc, char* argv[]) {
-   
-  if (argc != 2) {
-    cerr << "Usage: " << argv[0] << " bitfile" << endl;
-    return -1;
-  }
+void testSharded(ConvolvePool &pool, unsigned int inputSize,
+                 unsigned int kernelSize,
+                 float &percentCorrect, float &speedup) {
 
-  // setup clock frequencies
-  vector<float> clocks(Board::NUM_FPGA_CLOCKS);
-  clocks[0] = 100.0;
-  clocks[1] = 133.0;
-  clocks[2] = 100.0;
-  clocks[3] = 100.0;
-  
-  cout << "Programming FPGA....";
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *swOutput = new unsigned short[outputSize];
+  unsigned short *hwOutput = new unsigned short[outputSize];
+  Timer sw, hw;
 
-  // initialize board
-  Board *board;
-  try {
-    board = new Board(argv[1], clocks);
+  for (unsigned i=0; i < inputSize; i++) {
+      input[i] = rand();
   }
-  catch(...) {
-    exit(-1);
+
+  for (unsigned i=0; i < kernelSize; i++) {
+      kernel[i] = rand();
   }
 
-  Convolve convolve(*board);
-  unsigned short *input;
-  unsigned short *kernel;
-  unsigned short *hwOutput;
-  unsigned short *swOutput;
-  unsigned int transferSize;
-  float percentCorrect, speedup, score;
+  hw.start();
+  pool.convolve(input, inputSize, kernel, kernelSize, hwOutput);
+  hw.stop();
 
-  transferSize = App::getSafeTransferSize(Convolve::MAX_SIGNAL_SIZE, sizeof(unsigned short));
-  input = new unsigned short[transferSize];
-  transferSize = App::getSafeTransferSize(Convolve::MAX_KERNEL_SIZE, sizeof(unsigned short));
-  kernel = new unsigned short[transferSize];
-  transferSize = App::getSafeTransferSize(Convolve::MAX_OUTPUT_SIZE, sizeof(unsigned short));
-  hwOutput = new unsigned short[transferSize];
-  swOutput = new unsigned short[Convolve::MAX_OUTPUT_SIZE];
+  sw.start();
+  convolveSW(input, inputSize, kernel, kernelSize, swOutput);
+  sw.stop();
 
-  score = 0.0;
-  
-  /////////////////////////////////////////////////////////////////////////////
+  speedup = (sw.elapsedTime())/(hw.elapsedTime());
+  checkOutput(swOutput, hwOutput, outputSize, percentCorrect);
 
-  cout << "Testing small signal/kernel with all 0s..." << endl;
+  delete[] input;
+  delete[] kernel;
+  delete[] swOutput;
+  delete[] hwOutput;
+}
 
-  testZeros(convolve, input, SMALL_SIGNAL, 
-            kernel, SMALL_KERNEL, 
-            swOutput, hwOutput, 
-            percentCorrect, speedup);
 
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
+void testJobs(ConvolvePool &pool, unsigned int numJobs,
+              unsigned int inputSize, unsigned int kernelSize,
+              float &percentCorrect, float &speedup) {
 
-  score += percentCorrect*.05;
-  
-  /////////////////////////////////////////////////////////////////////////////
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  unsigned short *input = new unsigned short[numJobs*inputSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *hwOutput = new unsigned short[numJobs*transferSize];
+  unsigned short *swOutput = new unsigned short[numJobs*outputSize];
+  vector<ConvolveJob> jobs(numJobs);
+  unsigned errors = 0;
+  Timer sw, hw;
 
-  cout << "Testing small signal/kernel with all 1s..." << endl;
+  for (unsigned i=0; i < numJobs*inputSize; i++) {
+      input[i] = rand();
+  }
 
-  testOnes(convolve, input, SMALL_SIGNAL, 
-           kernel, SMALL_KERNEL, 
-           swOutput, hwOutput, 
-           percentCorrect, speedup);
+  for (unsigned i=0; i < kernelSize; i++) {
+      kernel[i] = rand();
+  }
 
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
+  for (unsigned i=0; i < numJobs; i++) {
+      jobs[i].signal = input+i*inputSize;
+      jobs[i].signalSize = inputSize;
+      jobs[i].kernel = kernel;
+      jobs[i].kernelSize = kernelSize;
+      jobs[i].output = hwOutput+i*transferSize;
+  }
 
-  score += percentCorrect*.10;
+  hw.start();
+  pool.run(jobs);
+  hw.stop();
 
-  /////////////////////////////////////////////////////////////////////////////
+  sw.start();
+  for (unsigned i=0; i < numJobs; i++) {
+      convolveSW(jobs[i].signal, inputSize, kernel, kernelSize, swOutput+i*outputSize);
+  }
+  sw.stop();
 
-  cout << "Testing small signal/kernel with random values (no clipping)..." << endl;
+  // verified outside of the software time
+  for (unsigned i=0; i < numJobs; i++) {
+      if (!checkOutput(swOutput+i*outputSize, jobs[i].output, outputSize, percentCorrect))
+          errors++;
+  }
 
-  testRandNoClip(convolve, input, SMALL_SIGNAL, 
-                 kernel, SMALL_KERNEL, 
-                 swOutput, hwOutput, 
-                 percentCorrect, speedup);
-  
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
-  
-  score += percentCorrect*.10;
+  percentCorrect = (numJobs-errors) / (float) numJobs;
+  speedup = (sw.elapsedTime())/(hw.elapsedTime());
 
-  /////////////////////////////////////////////////////////////////////////////
-  
-  cout << "Testing medium signal/kernel with random values (no clipping)..." << endl;
-  
-  testRandNoClip(convolve, input, MEDIUM_SIGNAL, 
-                 kernel, MEDIUM_KERNEL, 
-                 swOutput, hwOutput, 
-                 percentCorrect, speedup);
-  
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
+  delete[] input;
+  delete[] kernel;
+  delete[] swOutput;
+  delete[] hwOutput;
+}
 
-  score += percentCorrect*.15;
-  
-  /////////////////////////////////////////////////////////////////////////////
-  
-  cout << "Testing big signal/kernel with random values (no clipping)..." << endl;
-  
-  testRandNoClip(convolve, input, BIG_SIGNAL, 
-                 kernel, BIG_KERNEL, 
-                 swOutput, hwOutput, 
-                 percentCorrect, speedup);
-  
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
-  
-  score += percentCorrect*.15;
 
-   /////////////////////////////////////////////////////////////////////////////
+void testHybrid(HybridConvolve &hybrid, unsigned int iterations,
+                unsigned int inputSize, unsigned int kernelSize,
+                float &percentCorrect, float &speedup) {
 
-  cout << "Testing small signal/kernel with random values..." << endl;
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *swOutput = new unsigned short[outputSize];
+  unsigned short *hwOutput = new unsigned short[transferSize];
+  Timer sw, hw;
 
-  testRand(convolve, input, SMALL_SIGNAL, 
-           kernel, SMALL_KERNEL, 
-           swOutput, hwOutput, 
-           percentCorrect, speedup);
-  
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
-  
-  score += percentCorrect*.1;
+  for (unsigned i=0; i < inputSize; i++) {
+      input[i] = rand();
+  }
 
-  /////////////////////////////////////////////////////////////////////////////
-  
-  cout << "Testing medium signal/kernel with random values..." << endl;
-  
-  testRand(convolve, input, MEDIUM_SIGNAL, 
-           kernel, MEDIUM_KERNEL, 
-           swOutput, hwOutput, 
-           percentCorrect, speedup);
-  
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
+  for (unsigned i=0; i < kernelSize; i++) {
+      kernel[i] = rand();
+  }
 
-  score += percentCorrect*.15;
-  
-  /////////////////////////////////////////////////////////////////////////////
-  
-  cout << "Testing big signal/kernel with random values..." << endl;
-  
-  testRand(convolve, input, BIG_SIGNAL, 
-           kernel, BIG_KERNEL, 
-           swOutput, hwOutput, 
-           percentCorrect, speedup);
-  
-  score += percentCorrect*.20;
+  double firstRatio = hybrid.getRatio();
+  for (unsigned i=0; i < iterations; i++) {
 
-  cout << "Percent correct = " << percentCorrect*100.0 << endl;
-  cout << "Speedup = " << speedup << endl << endl;
-  cout << "TOTAL SCORE = " << score*100 << " out of " << 100 << endl;
-  
+      hw.start();
+      hybrid.convolve(input, inputSize, kernel, kernelSize, hwOutput);
+      hw.stop();
+  }
+
+  cout << "FPGA share = " << firstRatio*100.0 << "% -> " << hybrid.getRatio()*100.0
+       << "% (last FPGA time = " << hybrid.getHWTime() << ", CPU time = "
+       << hybrid.getSWTime() << ")" << endl;
+
+  sw.start();
+  convolveSW(input, inputSize, kernel, kernelSize, swOutput);
+  sw.stop();
+
+  speedup = (sw.elapsedTime())/(hw.elapsedTime());
+  checkOutput(swOutput, hwOutput, outputSize, percentCorrect);
 
   delete[] input;
   delete[] kernel;
   delete[] swOutput;
   delete[] hwOutput;
+}
+
+
+void testStreaming(StreamingConvolver &stream,
+                   const unsigned short* input, unsigned int inputSize,
+                   const unsigned short* kernel, unsigned int kernelSize,
+                   unsigned int blockSize,
+                   unsigned short *swOutput, unsigned short *hwOutput,
+                   float &percentCorrect) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+
+  for (unsigned i=0; i < inputSize; i += blockSize) {
+      unsigned size = min(blockSize, inputSize-i);
+      stream.process(input+i, size, hwOutput+i);
+  }
+  stream.flush(hwOutput+inputSize);
+
+  convolveSW(input, inputSize, kernel, kernelSize, swOutput);
+  checkOutput(swOutput, hwOutput, outputSize, percentCorrect);
+}
+
+
+void testFilterBank(Convolve &convolve, unsigned int numKernels,
+                    unsigned int inputSize, unsigned int kernelSize,
+                    float &percentCorrect, float &speedup) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *swOutput = new unsigned short[outputSize];
+  vector<unsigned short *> kernels(numKernels), outputs(numKernels);
+  vector<unsigned> kernelSizes(numKernels, kernelSize);
+  Timer separate, bank;
+
+  for (unsigned i=0; i < inputSize; i++) {
+      input[i] = rand();
+  }
+
+  for (unsigned i=0; i < numKernels; i++) {
+      kernels[i] = new unsigned short[kernelSize];
+      outputs[i] = new unsigned short[transferSize];
+      for (unsigned j=0; j < kernelSize; j++) {
+          kernels[i][j] = rand();
+      }
+  }
+
+  // one full upload per kernel
+  separate.start();
+  for (unsigned i=0; i < numKernels; i++) {
+      convolveHW(convolve, input, inputSize, kernels[i], kernelSize, outputs[i]);
+  }
+  separate.stop();
+
+  bank.start();
+  convolve.filterBank(input, inputSize, &kernels[0], &kernelSizes[0],
+                      numKernels, &outputs[0]);
+  bank.stop();
+
+  percentCorrect = 0.0;
+  for (unsigned i=0; i < numKernels; i++) {
+
+      float kernelCorrect;
+      convolveSW(input, inputSize, kernels[i], kernelSize, swOutput);
+      checkOutput(swOutput, outputs[i], outputSize, kernelCorrect);
+      percentCorrect += kernelCorrect/numKernels;
+  }
+
+  speedup = separate.elapsedTime()/bank.elapsedTime();
+
+  for (unsigned i=0; i < numKernels; i++) {
+      delete[] kernels[i];
+      delete[] outputs[i];
+  }
+  delete[] input;
+  delete[] swOutput;
+}
+
+
+// compares separate jobs to runPipelined(), and to the compute-bound limit
+// measured with a resident signal (no transfers at all)
+void testPipelined(Convolve &convolve, unsigned int numJobs, unsigned int inputSize,
+                   unsigned int kernelSize, float &percentCorrect,
+                   double &serialRate, double &pipelinedRate, double &computeRate) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  vector<unsigned short *> inputs(numJobs), kernels(numJobs), outputs(numJobs);
+  vector<unsigned> inputSizes(numJobs, inputSize), kernelSizes(numJobs, kernelSize);
+  unsigned short *swOutput = new unsigned short[outputSize];
+  Timer serial, pipelined, compute;
+
+  for (unsigned i=0; i < numJobs; i++) {
+      inputs[i] = (unsigned short *) App::allocBuffer(inputSize*sizeof(unsigned short));
+      kernels[i] = new unsigned short[kernelSize];
+      outputs[i] = (unsigned short *) App::allocBuffer(transferSize*sizeof(unsigned short));
+
+      for (unsigned j=0; j < inputSize; j++) {
+          inputs[i][j] = rand();
+      }
+      for (unsigned j=0; j < kernelSize; j++) {
+          kernels[i][j] = rand();
+      }
+  }
+
+  percentCorrect = 0.0;
+  try {
+      serial.start();
+      for (unsigned i=0; i < numJobs; i++) {
+          convolveHW(convolve, inputs[i], inputSize, kernels[i], kernelSize, outputs[i]);
+      }
+      serial.stop();
+
+      pipelined.start();
+      convolve.runPipelined(&inputs[0], &inputSizes[0], &kernels[0], &kernelSizes[0],
+                            numJobs, &outputs[0]);
+      pipelined.stop();
+
+      for (unsigned i=0; i < numJobs; i++) {
+
+          float jobCorrect;
+          convolveSW(inputs[i], inputSize, kernels[i], kernelSize, swOutput);
+          checkOutput(swOutput, outputs[i], outputSize, jobCorrect);
+          percentCorrect += jobCorrect/numJobs;
+      }
+
+      convolve.loadSignal(inputs[0], inputSize);
+      compute.start();
+      for (unsigned i=0; i < numJobs; i++) {
+          convolve.startResident(kernels[i], kernelSize);
+          while (!convolve.isDone());
+      }
+      compute.stop();
+  }
+  catch(...) {
+      fflush(stderr);
+  }
+
+  serialRate = numJobs/serial.elapsedTime();
+  pipelinedRate = numJobs/pipelined.elapsedTime();
+  computeRate = numJobs/compute.elapsedTime();
+
+  for (unsigned i=0; i < numJobs; i++) {
+      App::releaseBuffer(inputs[i]);
+      delete[] kernels[i];
+      App::releaseBuffer(outputs[i]);
+  }
+  delete[] swOutput;
+}
+
+
+// per-thread state of testShared()
+struct SharedContext {
+  // NULL for the global mutex version
+  ConvolveDispatcher *dispatcher;
+  Convolve *convolve;
+  pthread_mutex_t *mutex;
+
+  const vector<unsigned short *> *kernels;
+  unsigned int kernelSize;
+  unsigned int inputSize;
+  unsigned int numJobs;
+  unsigned int seed;
+  unsigned long errors;
+};
+
+
+void *sharedThread(void *arg) {
+
+  SharedContext *context = (SharedContext *) arg;
+  unsigned int outputSize = context->inputSize+context->kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  vector<unsigned short> input(context->inputSize), swOutput(outputSize), hwOutput(transferSize);
+  ConvolveDispatcher::Producer *producer = NULL;
+
+  if (context->dispatcher != NULL)
+    producer = new ConvolveDispatcher::Producer(*context->dispatcher);
+
+  for (unsigned i=0; i < context->numJobs; i++) {
+
+    for (unsigned j=0; j < context->inputSize; j++) {
+      input[j] = rand_r(&context->seed);
+    }
+    const unsigned short *kernel = (*context->kernels)[rand_r(&context->seed) % context->kernels->size()];
+
+    bool ok;
+    if (producer != NULL) {
+      ok = producer->convolve(&input[0], context->inputSize, kernel, context->kernelSize, &hwOutput[0]);
+    }
+    else {
+      pthread_mutex_lock(context->mutex);
+      ok = convolveHW(*context->convolve, &input[0], context->inputSize, kernel,
+                      context->kernelSize, &hwOutput[0]);
+      pthread_mutex_unlock(context->mutex);
+    }
+
+    convolveSW(&input[0], context->inputSize, kernel, context->kernelSize, &swOutput[0]);
+    if (!ok || memcmp(&swOutput[0], &hwOutput[0], outputSize*sizeof(unsigned short)) != 0)
+      context->errors++;
+  }
+
+  delete producer;
+  return NULL;
+}
+
+
+// runs the same jobs from numThreads threads, first sharing the accelerator
+// through a global mutex and then through a dispatcher
+void testShared(Board &board, Convolve &convolve, unsigned int numThreads,
+                unsigned int jobsPerThread, unsigned int inputSize,
+                unsigned int kernelSize, float &percentCorrect,
+                double &mutexTime, double &dispatchTime,
+                ConvolveDispatcher::Stats &stats) {
+
+  const unsigned numKernels = 2;
+  vector<unsigned short *> kernels(numKernels);
+  vector<SharedContext> contexts(numThreads);
+  vector<pthread_t> threads(numThreads);
+  pthread_mutex_t mutex;
+  unsigned long errors = 0;
+
+  pthread_mutex_init(&mutex, NULL);
+  for (unsigned i=0; i < numKernels; i++) {
+    kernels[i] = new unsigned short[kernelSize];
+    for (unsigned j=0; j < kernelSize; j++) {
+      kernels[i][j] = rand();
+    }
+  }
+
+  for (unsigned pass=0; pass < 2; pass++) {
+
+    ConvolveDispatcher *dispatcher = pass == 1 ? new ConvolveDispatcher(board) : NULL;
+    Timer timer;
+
+    timer.start();
+    for (unsigned i=0; i < numThreads; i++) {
+      contexts[i].dispatcher = dispatcher;
+      contexts[i].convolve = &convolve;
+      contexts[i].mutex = &mutex;
+      contexts[i].kernels = &kernels;
+      contexts[i].kernelSize = kernelSize;
+      contexts[i].inputSize = inputSize;
+      contexts[i].numJobs = jobsPerThread;
+      contexts[i].seed = i;
+      contexts[i].errors = 0;
+      pthread_create(&threads[i], NULL, sharedThread, &contexts[i]);
+    }
+
+    for (unsigned i=0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+      errors += contexts[i].errors;
+    }
+    timer.stop();
+
+    if (dispatcher != NULL) {
+      stats = dispatcher->getStats();
+      delete dispatcher;
+      dispatchTime = timer.elapsedTime();
+    }
+    else {
+      mutexTime = timer.elapsedTime();
+    }
+  }
+
+  percentCorrect = 1.0-errors/(2.0*numThreads*jobsPerThread);
+
+  for (unsigned i=0; i < numKernels; i++) {
+    delete[] kernels[i];
+  }
+  pthread_mutex_destroy(&mutex);
+}
+
+
+// submits numBig large jobs with loose deadlines followed by numUrgent small
+// jobs with tight deadlines, once with the largest slices and once with
+// sliceSize, and reports the stats of both classes (0 = bulk, 1 = urgent)
+void testDeadline(Board &board, unsigned int numBig, unsigned int numUrgent,
+                  double urgentDeadline, unsigned int sliceSize,
+                  float &percentCorrect,
+                  DeadlineScheduler::ClassStats stats[2][2]) {
+
+  const unsigned sizes[2] = {BIG_SIGNAL, MEDIUM_SIGNAL};
+  const unsigned numJobs = numBig+numUrgent;
+  vector<ConvolveJob> jobs(numJobs);
+  vector<DeadlineScheduler::ticket_t> tickets(numJobs);
+  unsigned short *kernel = new unsigned short[BIG_KERNEL];
+  unsigned long errors = 0;
+
+  for (unsigned i=0; i < BIG_KERNEL; i++) {
+    kernel[i] = rand();
+  }
+
+  for (unsigned i=0; i < numJobs; i++) {
+
+    unsigned inputSize = sizes[i < numBig ? 0 : 1];
+    unsigned short *input = new unsigned short[inputSize];
+    for (unsigned j=0; j < inputSize; j++) {
+      input[j] = rand();
+    }
+
+    jobs[i].signal = input;
+    jobs[i].signalSize = inputSize;
+    jobs[i].kernel = kernel;
+    jobs[i].kernelSize = BIG_KERNEL;
+    jobs[i].output = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(inputSize+BIG_KERNEL-1, sizeof(unsigned short)));
+  }
+
+  vector<unsigned short> swOutput(BIG_SIGNAL+BIG_KERNEL-1);
+
+  for (unsigned pass=0; pass < 2; pass++) {
+
+    DeadlineScheduler scheduler(board, pass == 0 ? 0 : sliceSize);
+
+    // the bulk jobs are all queued before the urgent ones start arriving
+    for (unsigned i=0; i < numJobs; i++) {
+      if (i < numBig) {
+        tickets[i] = scheduler.submit(jobs[i], 60.0, 0, 0);
+      }
+      else {
+        usleep(500);
+        tickets[i] = scheduler.submit(jobs[i], urgentDeadline, 1, 1);
+      }
+    }
+
+    for (unsigned i=0; i < numJobs; i++) {
+
+      bool ok = scheduler.wait(tickets[i]);
+      unsigned outputSize = jobs[i].signalSize+BIG_KERNEL-1;
+      convolveSW(jobs[i].signal, jobs[i].signalSize, kernel, BIG_KERNEL, &swOutput[0]);
+      if (!ok || memcmp(&swOutput[0], jobs[i].output, outputSize*sizeof(unsigned short)) != 0)
+        errors++;
+      memset(jobs[i].output, 0, outputSize*sizeof(unsigned short));
+    }
+
+    stats[pass][0] = scheduler.getStats(0);
+    stats[pass][1] = scheduler.getStats(1);
+  }
+
+  percentCorrect = 1.0-errors/(2.0*numJobs);
+
+  for (unsigned i=0; i < numJobs; i++) {
+    delete[] jobs[i].signal;
+    App::releaseBuffer(jobs[i].output);
+  }
+  delete[] kernel;
+}
+
+
+// per-thread state of testCache()
+struct CacheContext {
+  // NULL to run every job on the FPGA
+  ConvolveCache *cache;
+  Convolve *convolve;
+  pthread_mutex_t *mutex;
+
+  const vector<unsigned short *> *signals;
+  const vector<unsigned short *> *kernels;
+  unsigned int signalSize;
+  unsigned int kernelSize;
+  unsigned int numJobs;
+  unsigned int seed;
+  unsigned long errors;
+};
+
+
+void *cacheThread(void *arg) {
+
+  CacheContext *context = (CacheContext *) arg;
+  unsigned int outputSize = context->signalSize+context->kernelSize-1;
+  unsigned int transferSize = App::getSafeTransferSize(outputSize, sizeof(unsigned short));
+  vector<unsigned short> swOutput(outputSize), hwOutput(transferSize);
+
+  for (unsigned i=0; i < context->numJobs; i++) {
+
+    // skewed towards the first signals, like repeated calibration signals
+    double r = rand_r(&context->seed)/(RAND_MAX+1.0);
+    const unsigned short *signal = (*context->signals)[(unsigned) (r*r*context->signals->size())];
+    const unsigned short *kernel = (*context->kernels)[rand_r(&context->seed) % context->kernels->size()];
+
+    // the same inputs in different modes must not share results
+    OutputMode mode = (OutputMode) (rand_r(&context->seed) % 3);
+    unsigned begin, end;
+    getOutputRange(mode, context->signalSize, context->kernelSize, begin, end);
+
+    bool ok;
+    if (context->cache != NULL) {
+      ok = context->cache->convolve(signal, context->signalSize, kernel, context->kernelSize,
+                                    &hwOutput[0], mode);
+    }
+    else {
+      pthread_mutex_lock(context->mutex);
+      ok = convolveHW(*context->convolve, signal, context->signalSize, kernel,
+                      context->kernelSize, &hwOutput[0]);
+      pthread_mutex_unlock(context->mutex);
+      memmove(&hwOutput[0], &hwOutput[begin], (end-begin)*sizeof(unsigned short));
+    }
+
+    convolveSW(signal, context->signalSize, kernel, context->kernelSize, &swOutput[0], mode);
+    if (!ok || memcmp(&swOutput[0], &hwOutput[0], (end-begin)*sizeof(unsigned short)) != 0)
+      context->errors++;
+  }
+
+  return NULL;
+}
+
+
+// runs jobs drawn from numSignals signals, 2 kernels and the 3 output modes
+// from numThreads threads, first without a cache and then through a cache
+// that holds about a quarter of the distinct results in memory
+void testCache(Convolve &convolve, unsigned int numThreads, unsigned int jobsPerThread,
+               unsigned int numSignals, unsigned int signalSize, unsigned int kernelSize,
+               const char *spillFile, float &percentCorrect, double &uncachedTime,
+               double &cachedTime, ConvolveCache::Stats &stats) {
+
+  const unsigned numKernels = 2;
+  vector<unsigned short *> signals(numSignals), kernels(numKernels);
+  vector<CacheContext> contexts(numThreads);
+  vector<pthread_t> threads(numThreads);
+  pthread_mutex_t mutex;
+  unsigned long errors = 0;
+
+  pthread_mutex_init(&mutex, NULL);
+  for (unsigned i=0; i < numSignals; i++) {
+    signals[i] = new unsigned short[signalSize];
+    for (unsigned j=0; j < signalSize; j++) {
+      signals[i][j] = rand();
+    }
+  }
+
+  for (unsigned i=0; i < numKernels; i++) {
+    kernels[i] = new unsigned short[kernelSize];
+    for (unsigned j=0; j < kernelSize; j++) {
+      kernels[i][j] = rand();
+    }
+  }
+
+  // each entry also holds its inputs
+  size_t resultBytes = (2*signalSize+2*kernelSize-1)*sizeof(unsigned short);
+  size_t budget = resultBytes*numSignals*numKernels*3/4;
+
+  for (unsigned pass=0; pass < 2; pass++) {
+
+    ConvolveCache *cache = pass == 1 ? new ConvolveCache(convolve, budget, spillFile, 4*budget) : NULL;
+    Timer timer;
+
+    timer.start();
+    for (unsigned i=0; i < numThreads; i++) {
+      contexts[i].cache = cache;
+      contexts[i].convolve = &convolve;
+      contexts[i].mutex = &mutex;
+      contexts[i].signals = &signals;
+      contexts[i].kernels = &kernels;
+      contexts[i].signalSize = signalSize;
+      contexts[i].kernelSize = kernelSize;
+      contexts[i].numJobs = jobsPerThread;
+      contexts[i].seed = i;
+      contexts[i].errors = 0;
+      pthread_create(&threads[i], NULL, cacheThread, &contexts[i]);
+    }
+
+    for (unsigned i=0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+      errors += contexts[i].errors;
+    }
+    timer.stop();
+
+    if (cache != NULL) {
+      stats = cache->getStats();
+      delete cache;
+      cachedTime = timer.elapsedTime();
+    }
+    else {
+      uncachedTime = timer.elapsedTime();
+    }
+  }
+
+  percentCorrect = 1.0-errors/(2.0*numThreads*jobsPerThread);
+
+  for (unsigned i=0; i < numSignals; i++) {
+    delete[] signals[i];
+  }
+  for (unsigned i=0; i < numKernels; i++) {
+    delete[] kernels[i];
+  }
+  pthread_mutex_destroy(&mutex);
+}
+
+
+// edits 1-3 random ranges of up to maxEdit samples per round and compares
+// updating the stored output against recomputing the whole convolution
+void testIncremental(Convolve &convolve, unsigned int numRounds, unsigned int inputSize,
+                     unsigned int kernelSize, unsigned int maxEdit, float &percentCorrect,
+                     double &fullTime, double &incrementalTime, unsigned long &hwWindows,
+                     unsigned long &windows) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *swOutput = new unsigned short[outputSize];
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(outputSize, sizeof(unsigned short)));
+  vector<unsigned short> samples(maxEdit);
+  unsigned long errors = 0;
+
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand();
+  }
+
+  for (unsigned i=0; i < kernelSize; i++) {
+    kernel[i] = rand();
+  }
+
+  IncrementalConvolve incremental(convolve, kernel, kernelSize);
+  incremental.setSignal(input, inputSize);
+
+  fullTime = incrementalTime = 0.0;
+  hwWindows = windows = 0;
+
+  for (unsigned round=0; round < numRounds; round++) {
+
+    unsigned numEdits = 1+rand()%3;
+    for (unsigned i=0; i < numEdits; i++) {
+
+      unsigned size = 1+rand()%maxEdit;
+      unsigned start = rand()%(inputSize-size+1);
+      for (unsigned j=0; j < size; j++) {
+        samples[j] = rand();
+      }
+
+      memcpy(input+start, &samples[0], size*sizeof(unsigned short));
+      incremental.edit(start, &samples[0], size);
+    }
+
+    Timer timer;
+    timer.start();
+    IncrementalConvolve::UpdateStats stats = incremental.update();
+    timer.stop();
+    incrementalTime += timer.elapsedTime();
+    hwWindows += stats.hwWindows;
+    windows += stats.windows;
+
+    timer.start();
+    convolveHW(convolve, input, inputSize, kernel, kernelSize, hwOutput);
+    timer.stop();
+    fullTime += timer.elapsedTime();
+
+    convolveSW(input, inputSize, kernel, kernelSize, swOutput);
+    if (memcmp(swOutput, incremental.getOutput(), outputSize*sizeof(unsigned short)) != 0 ||
+        memcmp(swOutput, hwOutput, outputSize*sizeof(unsigned short)) != 0)
+      errors++;
+  }
+
+  percentCorrect = 1.0-errors/(double) numRounds;
+
+  delete[] input;
+  delete[] kernel;
+  delete[] swOutput;
+  App::releaseBuffer(hwOutput);
+}
+
+
+// checks decimation and interpolation by factor, on the FPGA and in
+// software, against a full convolution followed by subsampling and a full
+// convolution of the zero-stuffed signal
+void testMultirate(Convolve &convolve, unsigned int inputSize, unsigned int kernelSize,
+                   unsigned int factor, float percentCorrect[4], double fullTime[2],
+                   double decimatedTime[2]) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int keptSize = Convolve::getDecimatedSize(outputSize, factor);
+  unsigned int upSize = inputSize*factor;
+  unsigned int upOutputSize = upSize+kernelSize-1;
+
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *upInput = new unsigned short[upSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *swOutput = new unsigned short[upOutputSize];
+  unsigned short *reference = new unsigned short[upOutputSize];
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(upOutputSize, sizeof(unsigned short)));
+  Timer timer;
+
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand();
+  }
+
+  for (unsigned i=0; i < kernelSize; i++) {
+    kernel[i] = rand();
+  }
+
+  memset(upInput, 0, upSize*sizeof(unsigned short));
+  for (unsigned i=0; i < inputSize; i++) {
+    upInput[i*factor] = input[i];
+  }
+
+  for (unsigned i=0; i < 4; i++) {
+    percentCorrect[i] = 0.0;
+  }
+
+  // full convolution then subsample
+  timer.start();
+  convolveSW(input, inputSize, kernel, kernelSize, swOutput);
+  timer.stop();
+  fullTime[1] = timer.elapsedTime();
+  for (unsigned i=0; i < keptSize; i++) {
+    reference[i] = swOutput[i*factor];
+  }
+
+  timer.start();
+  convolveSWDecimate(input, inputSize, kernel, kernelSize, swOutput, factor);
+  timer.stop();
+  decimatedTime[1] = timer.elapsedTime();
+  checkOutput(reference, swOutput, keptSize, percentCorrect[0]);
+
+  try {
+    timer.start();
+    convolveHW(convolve, input, inputSize, kernel, kernelSize, hwOutput);
+    timer.stop();
+    fullTime[0] = timer.elapsedTime();
+
+    timer.start();
+    convolve.startDecimated(input, inputSize, kernel, kernelSize, factor);
+    while (!convolve.isDone());
+    convolve.getOutput(hwOutput, keptSize);
+    timer.stop();
+    decimatedTime[0] = timer.elapsedTime();
+    checkOutput(reference, hwOutput, keptSize, percentCorrect[1]);
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  // full convolution of the zero-stuffed signal
+  convolveSW(upInput, upSize, kernel, kernelSize, reference);
+
+  convolveSWInterpolate(input, inputSize, kernel, kernelSize, swOutput, factor);
+  checkOutput(reference, swOutput, upOutputSize, percentCorrect[2]);
+
+  try {
+    convolve.convolveInterpolated(input, inputSize, kernel, kernelSize, factor, hwOutput);
+    checkOutput(reference, hwOutput, upOutputSize, percentCorrect[3]);
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  delete[] input;
+  delete[] upInput;
+  delete[] kernel;
+  delete[] swOutput;
+  delete[] reference;
+  App::releaseBuffer(hwOutput);
+}
+
+
+// compares the tap plan of kernels of several shapes against
+// convolveSWRange, over the whole output and over random ranges
+void testTapPlans(unsigned int inputSize, unsigned int kernelSize) {
+
+  const char *shapes[] = {"dense", "small taps", "symmetric", "sparse", "box",
+                          "zero padded", "zero"};
+  const char *kinds[] = {"zero", "box", "symmetric", "nonzero taps"};
+  const unsigned numShapes = sizeof(shapes)/sizeof(shapes[0]);
+  unsigned int outputSize = inputSize+kernelSize-1;
+  vector<unsigned short> input(inputSize), kernel(kernelSize);
+  vector<unsigned short> reference(outputSize), output(outputSize);
+
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand();
+  }
+
+  for (unsigned shape=0; shape < numShapes; shape++) {
+
+    for (unsigned j=0; j < kernelSize; j++) {
+      switch (shape) {
+      case 0: kernel[j] = rand(); break;
+      case 1: kernel[j] = rand() % 16; break;
+      case 2: kernel[j] = j <= (kernelSize-1)/2 ? rand() % 256 : kernel[kernelSize-1-j]; break;
+      case 3: kernel[j] = j % 8 == 3 ? rand() % 256 : 0; break;
+      case 4: kernel[j] = j >= 2 && j+2 < kernelSize ? 3 : 0; break;
+      case 5: kernel[j] = j < kernelSize/4 ? rand() % 256 : 0; break;
+      default: kernel[j] = 0; break;
+      }
+    }
+
+    Timer referenceTimer, planTimer;
+    referenceTimer.start();
+    convolveSWRange(&input[0], inputSize, &kernel[0], kernelSize, &reference[0], 0, outputSize);
+    referenceTimer.stop();
+
+    planTimer.start();
+    TapPlan plan(&kernel[0], kernelSize);
+    plan.convolve(&input[0], inputSize, &output[0], 0, outputSize);
+    planTimer.stop();
+
+    unsigned long errors = 0;
+    for (unsigned i=0; i < outputSize; i++) {
+      if (output[i] != reference[i]) errors++;
+    }
+
+    // ranges that start and end near the ends of the signal
+    for (unsigned r=0; r < 20; r++) {
+      unsigned begin = rand() % outputSize;
+      unsigned end = begin+rand() % (outputSize-begin+1);
+      fill(output.begin(), output.end(), 0);
+      plan.convolve(&input[0], inputSize, &output[0], begin, end);
+      for (unsigned i=begin; i < end; i++) {
+        if (output[i] != reference[i]) errors++;
+      }
+    }
+
+    cout << shapes[shape] << ": " << kinds[plan.getKind()] << " plan, "
+         << plan.getMultiplies() << " multiplies/output, errors = " << errors
+         << ", speedup = " << referenceTimer.elapsedTime()/planTimer.elapsedTime() << endl;
+  }
+}
+
+
+// checks every output mode on the FPGA and in software against the
+// matching slice of convolveSW, for all kernel sizes and a few odd and
+// even signal sizes (including signals shorter than the kernel)
+void testModes(Convolve &convolve, float &percentCorrect, unsigned long words[3]) {
+
+  const unsigned signalSizes[] = {1, 2, 3, 10, 1001, MEDIUM_SIGNAL};
+  const unsigned numSizes = sizeof(signalSizes)/sizeof(signalSizes[0]);
+  const OutputMode modes[3] = {OUTPUT_FULL, OUTPUT_SAME, OUTPUT_VALID};
+  const unsigned maxOutputSize = MEDIUM_SIGNAL+BIG_KERNEL;
+  vector<unsigned short> input(MEDIUM_SIGNAL+1), kernel(BIG_KERNEL), full(maxOutputSize);
+  vector<unsigned short> swOutput(maxOutputSize);
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(maxOutputSize, sizeof(unsigned short)));
+  SWEngine engine(2);
+  unsigned long tests = 0, errors = 0;
+
+  words[0] = words[1] = words[2] = 0;
+
+  for (unsigned s=0; s < numSizes; s++) {
+    for (unsigned kernelSize=1; kernelSize <= BIG_KERNEL; kernelSize++) {
+
+      unsigned inputSize = signalSizes[s];
+      for (unsigned i=0; i < inputSize; i++) {
+        input[i] = rand();
+      }
+      for (unsigned i=0; i < kernelSize; i++) {
+        kernel[i] = rand() % 256;
+      }
+
+      convolveSW(&input[0], inputSize, &kernel[0], kernelSize, &full[0]);
+
+      for (unsigned m=0; m < 3; m++) {
+
+        unsigned begin, end;
+        getOutputRange(modes[m], inputSize, kernelSize, begin, end);
+        unsigned size = end-begin;
+        bool ok = true;
+
+        convolveSW(&input[0], inputSize, &kernel[0], kernelSize, &swOutput[0], modes[m]);
+        ok = ok && equal(swOutput.begin(), swOutput.begin()+size, full.begin()+begin);
+
+        engine.convolve(&input[0], inputSize, &kernel[0], kernelSize, &swOutput[0], modes[m]);
+        ok = ok && equal(swOutput.begin(), swOutput.begin()+size, full.begin()+begin);
+
+        try {
+          convolve.start(&input[0], inputSize, &kernel[0], kernelSize);
+          while (!convolve.isDone());
+          ok = ok && convolve.getOutput(hwOutput, inputSize, kernelSize, modes[m]) == size;
+          ok = ok && equal(hwOutput, hwOutput+size, full.begin()+begin);
+        }
+        catch(...) {
+          ok = false;
+        }
+
+        // words read back, counting the extra sample of odd starts
+        words[m] += size > 0 ? (size+begin%2+1)/2 : 0;
+
+        tests++;
+        if (!ok) errors++;
+      }
+    }
+  }
+
+  percentCorrect = 1.0-errors/(double) tests;
+  App::releaseBuffer(hwOutput);
+}
+
+
+// scalar reference for Quantizer::quantize
+unsigned short quantizeSample(float value, const Quantizer &quantizer) {
+
+  float v = value*quantizer.getScale()+quantizer.getOffset()+0.5f;
+  if (!(v > 0.0f)) return 0;
+  if (v >= Quantizer::MAX_SAMPLE) return Quantizer::MAX_SAMPLE;
+  return (unsigned short) v;
+}
+
+
+// convolves float and int32 signals through the quantizing front end and
+// compares against convolveSW of the reference quantization. Also times a
+// separate conversion pass followed by start() against the fused upload.
+void testQuantize(Convolve &convolve, unsigned int inputSize, unsigned int kernelSize,
+                  float percentCorrect[3], double &separateTime, double &fusedTime) {
+
+  unsigned int outputSize = inputSize+kernelSize-1;
+  vector<float> floatInput(inputSize), floatOutput(outputSize);
+  vector<int> intInput(inputSize);
+  vector<unsigned short> reference(inputSize), converted(inputSize), kernel(kernelSize);
+  vector<unsigned short> swOutput(outputSize);
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(outputSize, sizeof(unsigned short)));
+  Quantizer floatQuantizer(1000.0f, 32768.0f), intQuantizer(1.0f/65536.0f, 0.0f);
+  Quantizer outputQuantizer(1000.0f, 0.0f);
+  Timer timer;
+
+  // mostly in range, with some samples that saturate on either side
+  for (unsigned i=0; i < inputSize; i++) {
+    floatInput[i] = (rand()/(float) RAND_MAX-0.5f)*80.0f;
+    intInput[i] = rand()-RAND_MAX/2;
+  }
+  if (inputSize > 2) {
+    floatInput[0] = -1e30f;
+    floatInput[1] = 1e30f;
+    floatInput[2] = sqrt(-1.0f);
+  }
+
+  for (unsigned i=0; i < kernelSize; i++) {
+    kernel[i] = rand() % 4;
+  }
+
+  for (unsigned i=0; i < 3; i++) {
+    percentCorrect[i] = 0.0;
+  }
+
+  for (unsigned i=0; i < inputSize; i++) {
+    reference[i] = quantizeSample(floatInput[i], floatQuantizer);
+  }
+  convolveSW(&reference[0], inputSize, &kernel[0], kernelSize, &swOutput[0]);
+
+  try {
+    timer.start();
+    floatQuantizer.quantize(&floatInput[0], inputSize, &converted[0]);
+    convolve.start(&converted[0], inputSize, &kernel[0], kernelSize);
+    while (!convolve.isDone());
+    convolve.getOutput(hwOutput, outputSize);
+    timer.stop();
+    separateTime = timer.elapsedTime();
+
+    timer.start();
+    convolve.start(&floatInput[0], inputSize, &kernel[0], kernelSize, floatQuantizer);
+    while (!convolve.isDone());
+    convolve.getOutput(hwOutput, outputSize);
+    timer.stop();
+    fusedTime = timer.elapsedTime();
+    checkOutput(&swOutput[0], hwOutput, outputSize, percentCorrect[0]);
+
+    // float readback of the same outputs
+    convolve.getOutput(&floatOutput[0], outputSize, outputQuantizer);
+    unsigned errors = 0;
+    for (unsigned i=0; i < outputSize; i++) {
+      if (fabs(floatOutput[i]-swOutput[i]/1000.0f) > 1e-3f) errors++;
+    }
+    percentCorrect[1] = (outputSize-errors)/(float) outputSize;
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  for (unsigned i=0; i < inputSize; i++) {
+    reference[i] = quantizeSample((float) intInput[i], intQuantizer);
+  }
+  convolveSW(&reference[0], inputSize, &kernel[0], kernelSize, &swOutput[0]);
+
+  try {
+    convolve.start(&intInput[0], inputSize, &kernel[0], kernelSize, intQuantizer);
+    while (!convolve.isDone());
+    convolve.getOutput(hwOutput, outputSize);
+    checkOutput(&swOutput[0], hwOutput, outputSize, percentCorrect[2]);
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  App::releaseBuffer(hwOutput);
+}
+
+
+// runs a chain of numStages kernels on the FPGA, once with a host round
+// trip per stage and once as a cascade, against convolveSW of every stage
+void testCascade(Convolve &convolve, unsigned int numStages, float percentCorrect[2],
+                 double &roundTripTime, double &cascadeTime) {
+
+  vector<unsigned int> kernelSizes(numStages);
+  vector<vector<unsigned short> > kernels(numStages);
+  vector<const unsigned short *> kernelPtrs(numStages);
+
+  for (unsigned i=0; i < numStages; i++) {
+    kernelSizes[i] = 1+rand() % BIG_KERNEL;
+    kernels[i].resize(kernelSizes[i]);
+    for (unsigned j=0; j < kernelSizes[i]; j++) {
+      kernels[i][j] = rand() % 4;
+    }
+    kernelPtrs[i] = &kernels[i][0];
+  }
+
+  unsigned int inputSize = Convolve::MAX_CASCADE_SIGNAL_SIZE-numStages*(BIG_KERNEL-1);
+  unsigned int outputSize = Convolve::getCascadeSize(inputSize, &kernelSizes[0], numStages);
+  vector<unsigned short> input(inputSize), swOutput(outputSize), swStage(outputSize);
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(outputSize, sizeof(unsigned short)));
+  Timer timer;
+
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand() % 256;
+  }
+
+  unsigned size = inputSize;
+  copy(input.begin(), input.end(), swStage.begin());
+  for (unsigned i=0; i < numStages; i++) {
+    convolveSW(&swStage[0], size, kernelPtrs[i], kernelSizes[i], &swOutput[0]);
+    size += kernelSizes[i]-1;
+    copy(swOutput.begin(), swOutput.begin()+size, swStage.begin());
+  }
+
+  percentCorrect[0] = percentCorrect[1] = 0.0;
+
+  try {
+    // every stage's outputs go back through the host as the next signal
+    timer.start();
+    size = inputSize;
+    copy(input.begin(), input.end(), hwOutput);
+    for (unsigned i=0; i < numStages; i++) {
+      convolve.start(hwOutput, size, kernelPtrs[i], kernelSizes[i]);
+      while (!convolve.isDone());
+      size += kernelSizes[i]-1;
+      convolve.getOutput(hwOutput, size);
+    }
+    timer.stop();
+    roundTripTime = timer.elapsedTime();
+    checkOutput(&swOutput[0], hwOutput, outputSize, percentCorrect[0]);
+
+    timer.start();
+    convolve.convolveCascade(&input[0], inputSize, &kernelPtrs[0], &kernelSizes[0],
+                             numStages, hwOutput);
+    timer.stop();
+    cascadeTime = timer.elapsedTime();
+    checkOutput(&swOutput[0], hwOutput, outputSize, percentCorrect[1]);
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  App::releaseBuffer(hwOutput);
+}
+
+
+// plants numPeaks peaks in low-level noise and finds the outputs above a
+// threshold on the FPGA, once by reading back and scanning every output and
+// once with threshold detection, against convolveSWThreshold(). Detection
+// then runs again with room for only a quarter of the events, where the
+// count must still include every output above the threshold.
+void testThreshold(Convolve &convolve, unsigned int numPeaks, float percentCorrect[3],
+                   unsigned int &hwCount, unsigned int &swCount, unsigned int &overflowCount,
+                   double &scanTime, double &eventTime) {
+
+  const unsigned short threshold = 1000;
+  unsigned int inputSize = min((unsigned) BIG_SIGNAL, Convolve::MAX_THRESHOLD_SIGNAL_SIZE);
+  unsigned int kernelSize = BIG_KERNEL;
+  unsigned int outputSize = inputSize+kernelSize-1;
+  unsigned int maxEvents = min(numPeaks*kernelSize, Convolve::MAX_EVENTS);
+  vector<unsigned short> input(inputSize), kernel(kernelSize);
+  vector<OutputEvent> swEvents(maxEvents), hwEvents(maxEvents), scanEvents(maxEvents);
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(outputSize, sizeof(unsigned short)));
+  Timer timer;
+
+  // the noise can't reach the threshold on its own
+  for (unsigned i=0; i < kernelSize; i++) {
+    kernel[i] = 1+rand() % 3;
+  }
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand() % 16;
+  }
+  for (unsigned i=0; i < numPeaks; i++) {
+    input[rand() % inputSize] = threshold+rand() % threshold;
+  }
+
+  swCount = convolveSWThreshold(&input[0], inputSize, &kernel[0], kernelSize,
+                                threshold, &swEvents[0], maxEvents);
+  unsigned swStored = min(swCount, maxEvents);
+
+  percentCorrect[0] = percentCorrect[1] = percentCorrect[2] = 0.0;
+  hwCount = overflowCount = 0;
+
+  try {
+    timer.start();
+    convolve.start(&input[0], inputSize, &kernel[0], kernelSize);
+    while (!convolve.isDone());
+    convolve.getOutput(hwOutput, outputSize);
+    unsigned scanCount = 0;
+    for (unsigned i=0; i < outputSize; i++) {
+      if (hwOutput[i] > threshold) {
+        if (scanCount < maxEvents) {
+          scanEvents[scanCount].index = i;
+          scanEvents[scanCount].value = hwOutput[i];
+        }
+        scanCount++;
+      }
+    }
+    timer.stop();
+    scanTime = timer.elapsedTime();
+
+    timer.start();
+    convolve.startThreshold(&input[0], inputSize, &kernel[0], kernelSize, threshold, maxEvents);
+    while (!convolve.isDone());
+    hwCount = convolve.getEvents(&hwEvents[0]);
+    timer.stop();
+    eventTime = timer.elapsedTime();
+
+    // the events only match if the counts do
+    vector<OutputEvent> *events[2] = {&scanEvents, &hwEvents};
+    unsigned counts[2] = {scanCount, hwCount};
+    for (unsigned k=0; k < 2; k++) {
+
+      if (counts[k] != swCount) continue;
+
+      unsigned matches = 0;
+      for (unsigned i=0; i < swStored; i++) {
+        if ((*events[k])[i].index == swEvents[i].index &&
+            (*events[k])[i].value == swEvents[i].value)
+          matches++;
+      }
+      percentCorrect[k] = swStored > 0 ? (float) matches/swStored : 1.0;
+    }
+
+    // the first events are stored and the rest only counted
+    unsigned overflowMax = swCount > 4 ? swCount/4 : 1;
+    convolve.startThreshold(&input[0], inputSize, &kernel[0], kernelSize, threshold, overflowMax);
+    while (!convolve.isDone());
+    overflowCount = convolve.getEvents(&hwEvents[0]);
+
+    if (overflowCount == swCount) {
+
+      unsigned stored = min(overflowMax, swStored), matches = 0;
+      for (unsigned i=0; i < stored; i++) {
+        if (hwEvents[i].index == swEvents[i].index && hwEvents[i].value == swEvents[i].value)
+          matches++;
+      }
+      percentCorrect[2] = stored > 0 ? (float) matches/stored : 1.0;
+    }
+  }
+  catch(...) {
+    fflush(stderr);
+  }
+
+  App::releaseBuffer(hwOutput);
+}
+
+
+// runs numJobs jobs with each one spot-checked by an OutputVerifier while
+// the next one runs. Every output of the middle job is corrupted to stand
+// in for a bad output path, so any sample of it fails. That must raise
+// exactly one alert and escalate.
+void testVerifier(Convolve &convolve, unsigned int numJobs, unsigned int samplesPerJob,
+                  OutputVerifier::Stats &stats, double &plainTime, double &verifiedTime) {
+
+  unsigned int inputSize = BIG_SIGNAL, kernelSize = BIG_KERNEL;
+  unsigned int outputSize = inputSize+kernelSize-1;
+  vector<unsigned short> input(inputSize), kernel(kernelSize);
+  unsigned short *hwOutput = (unsigned short *) App::allocBuffer(App::getSafeTransferSize(outputSize, sizeof(unsigned short)));
+  OutputVerifier verifier(samplesPerJob);
+  Timer timer;
+
+  for (unsigned i=0; i < inputSize; i++) {
+    input[i] = rand();
+  }
+
+  for (unsigned pass=0; pass < 2; pass++) {
+
+    timer.start();
+    for (unsigned j=0; j < numJobs; j++) {
+
+      // a different signal for each job
+      input[j % inputSize] = rand();
+      for (unsigned i=0; i < kernelSize; i++) {
+        kernel[i] = rand();
+      }
+
+      if (!convolveHW(convolve, &input[0], inputSize, &kernel[0], kernelSize, hwOutput))
+        continue;
+
+      if (pass == 1) {
+        if (j == numJobs/2) {
+          for (unsigned i=0; i < outputSize; i++) {
+            hwOutput[i] ^= 1;
+          }
+
+          // make room so the corrupted job can't be skipped, and wait for
+          // its alert so the following jobs are escalated
+          verifier.drain();
+          verifier.submit(&input[0], inputSize, &kernel[0], kernelSize, hwOutput);
+          verifier.drain();
+        }
+        else {
+          verifier.submit(&input[0], inputSize, &kernel[0], kernelSize, hwOutput);
+        }
+      }
+    }
+    verifier.drain();
+    timer.stop();
+
+    if (pass == 0) plainTime = timer.elapsedTime();
+    else verifiedTime = timer.elapsedTime();
+  }
+
+  stats = verifier.getStats();
+  App::releaseBuffer(hwOutput);
+
+  // only the corrupted job may raise an alert, and it must unless nothing
+  // is sampled
+  assert(stats.alerts == (samplesPerJob > 0 ? 1u : 0u));
+}
+
+
+void testStaged(Convolve &convolve, unsigned long inputSize,
+                unsigned int kernelSize, unsigned int windowSize,
+                float &percentCorrect) {
+
+  unsigned long outputSize = inputSize+kernelSize-1;
+  unsigned short *input = new unsigned short[inputSize];
+  unsigned short *kernel = new unsigned short[kernelSize];
+  unsigned short *swOutput = new unsigned short[outputSize];
+  unsigned short *hwOutput = new unsigned short[outputSize];
+
+  for (unsigned long i=0; i < inputSize; i++) {
+      input[i] = rand();
+  }
+
+  for (unsigned i=0; i < kernelSize; i++) {
+      kernel[i] = rand();
+  }
+
+  percentCorrect = 0.0;
+  try {
+      convolve.convolveStaged(input, inputSize, kernel, kernelSize, hwOutput, windowSize);
+      convolveSWRange(input, inputSize, kernel, kernelSize, swOutput, 0, outputSize);
+      checkOutput(swOutput, hwOutput, outputSize, percentCorrect);
+  }
+  catch(...) {
+      fflush(stderr);
+  }
+
+  delete[] input;
+  delete[] kernel;
+  delete[] swOutput;
+  delete[] hwOutput;
+}
+
+
+bool convolveFile(Convolve &convolve, const char *inputFile,
+                  const char *kernelFile, const char *outputFile) {
+
+  try {
+
+    SignalFile input(inputFile);
+    SignalFile kernelSamples(kernelFile);
+
+    // kernels are tiny, so u8 kernels are simply widened
+    vector<unsigned short> kernel(kernelSamples.getSize());
+    for (unsigned i=0; i < kernel.size(); i++) {
+        kernel[i] = kernelSamples.getFormat() == SAMPLE_U16 ?
+          kernelSamples.getU16()[i] : kernelSamples.getU8()[i];
+    }
+
+    unsigned long long inputSize = input.getSize();
+    unsigned int kernelSize = kernel.size();
+    unsigned long long outputSize = inputSize+kernelSize-1;
+    OutputSignalFile output(outputFile, outputSize,
+                            input.getSampleRate() ? input.getSampleRate() : 8000);
+
+    // the mapped input goes straight to the FPGA or software engine, and
+    // the outputs are written straight into the mapped output file. Larger
+    // files are convolved a window at a time.
+    if (inputSize <= Convolve::MAX_SIGNAL_SIZE && kernelSize <= Convolve::MAX_KERNEL_SIZE) {
+
+      if (input.getFormat() == SAMPLE_U16)
+        convolve.start(input.getU16(), inputSize, &kernel[0], kernelSize);
+      else
+        convolve.start(input.getU8(), inputSize, &kernel[0], kernelSize);
+      while(!convolve.isDone());
+      convolve.getOutput(output.getData(), outputSize);
+    }
+    else {
+      convolveSWFile(input, &kernel[0], kernelSize, output);
+    }
+  }
+  catch(...) {
+
+      fflush(stderr);
+      return false;
+  }
+
+  return true;
+}
+
+
+int main(int argc, char* argv[]) {
+   
+  const char *traceFile = NULL;
+  bool hashTrace = false;
+  unsigned numCores = 1;
+  unsigned numThreads = 0;
+  unsigned streamBlock = 0;
+  unsigned numBankKernels = 0;
+  unsigned long stagedSize = 0;
+  unsigned pipelineJobs = 0;
+  unsigned sharedThreads = 0;
+  unsigned urgentJobs = 0;
+  unsigned cacheJobs = 0;
+  unsigned editRounds = 0;
+  unsigned multirateFactor = 0;
+  unsigned planKernelSize = 0;
+  bool testOutputModes = false;
+  bool testQuantizer = false;
+  unsigned verifyJobs = 0;
+  unsigned cascadeStages = 0;
+  unsigned thresholdPeaks = 0;
+  unsigned verifySamples = 64;
+  const char *spillFile = NULL;
+  double emuRate = 0.0;
+  double emuCompute = 0.0;
+  double deadline = 0.001;
+  const char *fileArgs[3] = {NULL, NULL, NULL};
+  bool badArgs = argc < 2;
+
+  for (int i=2; i < argc && !badArgs; i++) {
+    if (strcmp(argv[i], "-trace") == 0 && i+1 < argc)
+      traceFile = argv[++i];
+    else if (strcmp(argv[i], "-cores") == 0 && i+1 < argc)
+      numCores = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-hybrid") == 0 && i+1 < argc)
+      numThreads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-stream") == 0 && i+1 < argc)
+      streamBlock = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-bank") == 0 && i+1 < argc)
+      numBankKernels = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-staged") == 0 && i+1 < argc)
+      stagedSize = atol(argv[++i]);
+    else if (strcmp(argv[i], "-pipeline") == 0 && i+1 < argc)
+      pipelineJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-shared") == 0 && i+1 < argc)
+      sharedThreads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-edf") == 0 && i+1 < argc)
+      urgentJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-cache") == 0 && i+1 < argc)
+      cacheJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-spill") == 0 && i+1 < argc)
+      spillFile = argv[++i];
+    else if (strcmp(argv[i], "-incremental") == 0 && i+1 < argc)
+      editRounds = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-multirate") == 0 && i+1 < argc)
+      multirateFactor = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-taps") == 0 && i+1 < argc)
+      planKernelSize = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-modes") == 0)
+      testOutputModes = true;
+    else if (strcmp(argv[i], "-quantize") == 0)
+      testQuantizer = true;
+    else if (strcmp(argv[i], "-verify") == 0 && i+1 < argc)
+      verifyJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-samples") == 0 && i+1 < argc)
+      verifySamples = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-cascade") == 0 && i+1 < argc)
+      cascadeStages = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-threshold") == 0 && i+1 < argc)
+      thresholdPeaks = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-emurate") == 0 && i+1 < argc)
+      emuRate = atof(argv[++i])*1e6;
+    else if (strcmp(argv[i], "-emucompute") == 0 && i+1 < argc)
+      emuCompute = atof(argv[++i])*1e6;
+    else if (strcmp(argv[i], "-deadline") == 0 && i+1 < argc)
+      deadline = atof(argv[++i])/1000.0;
+    else if (strcmp(argv[i], "-convolve") == 0 && i+3 < argc) {
+      for (unsigned j=0; j < 3; j++) fileArgs[j] = argv[++i];
+    }
+    else if (strcmp(argv[i], "-hash") == 0)
+      hashTrace = true;
+    else if (strcmp(argv[i], "-huge") == 0)
+      App::setHugePages(true);
+    else
+      badArgs = true;
+  }
+
+  if (badArgs || numCores == 0) {
+    cerr << "Usage: " << argv[0] << " (bitfile | -emu) [-trace file [-hash]] [-huge] [-cores n] [-hybrid threads]" << endl
+         << "       [-stream block [-deadline ms]] [-bank kernels] [-staged size] [-pipeline jobs] [-shared threads]" << endl
+         << "       [-edf urgentJobs [-deadline ms]] [-cache jobs [-spill file]]" << endl
+         << "       [-incremental rounds] [-multirate factor] [-taps kernelSize] [-modes] [-quantize]" << endl
+         << "       [-verify jobs [-samples perJob]] [-cascade stages] [-threshold peaks]" << endl
+         << "       [-emurate MB/s] [-emucompute Msamples/s] [-convolve input kernel output]" << endl;
+    return -1;
+  }
+
+  // setup clock frequencies
+  vector<float> clocks(Board::NUM_FPGA_CLOCKS);
+  clocks[0] = 100.0;
+  clocks[1] = 133.0;
+  clocks[2] = 100.0;
+  clocks[3] = 100.0;
+  
+  cout << "Programming FPGA....";
+
+  // initialize board
+  Board *board;
+  Board *tracedBoard = NULL;
+  vector<Board *> coreBoards;
+  bool emulate = strcmp(argv[1], "-emu") == 0;
+  try {
+    if (emulate)
+      board = new EmuBoard(emuRate, emuCompute);
+    else
+      board = new Board(argv[1], clocks);
+
+    // record all board traffic for trace_replay
+    if (traceFile != NULL)
+      tracedBoard = new TraceBoard(*board, traceFile, hashTrace);
+
+    // the remaining cores are in the same bitfile, one memory map apart
+    coreBoards.push_back(tracedBoard != NULL ? tracedBoard : board);
+    for (unsigned i=1; i < numCores; i++) {
+      if (emulate)
+        coreBoards.push_back(new EmuBoard(emuRate, emuCompute));
+      else
+        coreBoards.push_back(new Board(AXI_MMAP_ADDR+i*AXI_MMAP_STRIDE));
+    }
+  }
+  catch(...) {
+    exit(-1);
+  }
+
+  Convolve convolve(tracedBoard != NULL ? *tracedBoard : *board);
+
+  // convolve files instead of running the tests
+  if (fileArgs[0] != NULL) {
+
+    cout << "SUCCESS" << endl;
+    bool ok = convolveFile(convolve, fileArgs[0], fileArgs[1], fileArgs[2]);
+    cout << (ok ? "Wrote " : "Failed to write ") << fileArgs[2] << endl;
+
+    for (unsigned i=1; i < coreBoards.size(); i++) {
+      delete coreBoards[i];
+    }
+    delete tracedBoard;
+    delete board;
+    return ok ? 0 : -1;
+  }
+  unsigned short *input;
+  unsigned short *kernel;
+  unsigned short *hwOutput;
+  unsigned short *swOutput;
+  float percentCorrect, speedup, score;
+
+  // the transfer buffers come from the pool, already rounded up to a safe
+  // transfer size
+  input = (unsigned short *) App::allocBuffer(Convolve::MAX_SIGNAL_SIZE*sizeof(unsigned short));
+  // the medium tests use kernels larger than MAX_KERNEL_SIZE while testing
+  // with small kernel sizes, so leave room for them
+  kernel = (unsigned short *) App::allocBuffer(max(Convolve::MAX_KERNEL_SIZE, (unsigned) MEDIUM_KERNEL)*sizeof(unsigned short));
+  hwOutput = (unsigned short *) App::allocBuffer(Convolve::MAX_OUTPUT_SIZE*sizeof(unsigned short));
+  swOutput = (unsigned short *) App::allocBuffer(Convolve::MAX_OUTPUT_SIZE*sizeof(unsigned short));
+
+  score = 0.0;
+  
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Testing small signal/kernel with all 0s..." << endl;
+
+  testZeros(convolve, input, SMALL_SIGNAL, 
+            kernel, SMALL_KERNEL, 
+            swOutput, hwOutput, 
+            percentCorrect, speedup);
+
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+
+  score += percentCorrect*.05;
+  
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Testing small signal/kernel with all 1s..." << endl;
+
+  testOnes(convolve, input, SMALL_SIGNAL, 
+           kernel, SMALL_KERNEL, 
+           swOutput, hwOutput, 
+           percentCorrect, speedup);
+
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+
+  score += percentCorrect*.10;
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Testing small signal/kernel with random values (no clipping)..." << endl;
+
+  testRandNoClip(convolve, input, SMALL_SIGNAL, 
+                 kernel, SMALL_KERNEL, 
+                 swOutput, hwOutput, 
+                 percentCorrect, speedup);
+  
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+  
+  score += percentCorrect*.10;
+
+  /////////////////////////////////////////////////////////////////////////////
+  
+  cout << "Testing medium signal/kernel with random values (no clipping)..." << endl;
+  
+  testRandNoClip(convolve, input, MEDIUM_SIGNAL, 
+                 kernel, MEDIUM_KERNEL, 
+                 swOutput, hwOutput, 
+                 percentCorrect, speedup);
+  
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+
+  score += percentCorrect*.15;
+  
+  /////////////////////////////////////////////////////////////////////////////
+  
+  cout << "Testing big signal/kernel with random values (no clipping)..." << endl;
+  
+  testRandNoClip(convolve, input, BIG_SIGNAL, 
+                 kernel, BIG_KERNEL, 
+                 swOutput, hwOutput, 
+                 percentCorrect, speedup);
+  
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+  
+  score += percentCorrect*.15;
+
+   /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Testing small signal/kernel with random values..." << endl;
+
+  testRand(convolve, input, SMALL_SIGNAL, 
+           kernel, SMALL_KERNEL, 
+           swOutput, hwOutput, 
+           percentCorrect, speedup);
+  
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+  
+  score += percentCorrect*.1;
+
+  /////////////////////////////////////////////////////////////////////////////
+  
+  cout << "Testing medium signal/kernel with random values..." << endl;
+  
+  testRand(convolve, input, MEDIUM_SIGNAL, 
+           kernel, MEDIUM_KERNEL, 
+           swOutput, hwOutput, 
+           percentCorrect, speedup);
+  
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+
+  score += percentCorrect*.15;
+  
+  /////////////////////////////////////////////////////////////////////////////
+  
+  cout << "Testing big signal/kernel with random values..." << endl;
+  
+  testRand(convolve, input, BIG_SIGNAL, 
+           kernel, BIG_KERNEL, 
+           swOutput, hwOutput, 
+           percentCorrect, speedup);
+  
+  score += percentCorrect*.20;
+
+  cout << "Percent correct = " << percentCorrect*100.0 << endl;
+  cout << "Speedup = " << speedup << endl << endl;
+  cout << "TOTAL SCORE = " << score*100 << " out of " << 100 << endl;
+  
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (numCores > 1) {
+
+    ConvolvePool pool(coreBoards);
+
+    cout << endl << "Testing " << numCores << "x big signal sharded across " << numCores << " cores..." << endl;
+
+    testSharded(pool, numCores*BIG_SIGNAL, BIG_KERNEL,
+                percentCorrect, speedup);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Speedup = " << speedup << endl << endl;
+
+    cout << "Testing " << 4*numCores << " independent medium jobs across " << numCores << " cores..." << endl;
+
+    testJobs(pool, 4*numCores, MEDIUM_SIGNAL, BIG_KERNEL,
+             percentCorrect, speedup);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Speedup = " << speedup << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (numThreads > 0) {
+
+    SWEngine engine(numThreads);
+    HybridConvolve hybrid(convolve, engine);
+
+    cout << endl << "Testing big signal split between FPGA and " << numThreads << " CPU threads..." << endl;
+
+    testHybrid(hybrid, 8, BIG_SIGNAL, BIG_KERNEL,
+               percentCorrect, speedup);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Speedup = " << speedup << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (streamBlock > 0) {
+
+    for (unsigned i=0; i < BIG_KERNEL; i++) {
+        kernel[i] = rand();
+    }
+    for (unsigned i=0; i < BIG_SIGNAL; i++) {
+        input[i] = rand();
+    }
+
+    StreamingConvolver stream(convolve, kernel, BIG_KERNEL, deadline);
+
+    cout << endl << "Testing big signal streamed in blocks of " << streamBlock << "..." << endl;
+
+    testStreaming(stream, input, BIG_SIGNAL, kernel, BIG_KERNEL, streamBlock,
+                  swOutput, hwOutput, percentCorrect);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Blocks = " << stream.getNumBlocks() << ", deadline misses = " << stream.getNumMisses() << endl;
+    cout << "Mean latency = " << stream.getMeanLatency()*1000.0
+         << " ms, max latency = " << stream.getMaxLatency()*1000.0 << " ms" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (numBankKernels > 0) {
+
+    cout << endl << "Testing big signal with a bank of " << numBankKernels << " resident-signal kernels..." << endl;
+
+    testFilterBank(convolve, numBankKernels, BIG_SIGNAL, BIG_KERNEL,
+                   percentCorrect, speedup);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Speedup over separate uploads = " << speedup << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (stagedSize > 0) {
+
+    unsigned windows[2] = {Convolve::MAX_SIGNAL_SIZE, MEDIUM_SIGNAL};
+
+    for (unsigned i=0; i < 2; i++) {
+
+      cout << endl << "Testing signal of " << stagedSize << " samples staged in DRAM, windows of "
+           << windows[i] << "..." << endl;
+
+      testStaged(convolve, stagedSize, BIG_KERNEL, windows[i], percentCorrect);
+      cout << "Percent correct = " << percentCorrect*100.0 << endl << endl;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (pipelineJobs > 0) {
+
+    double serialRate, pipelinedRate, computeRate;
+
+    cout << endl << "Testing " << pipelineJobs << " ping-pong buffered jobs..." << endl;
+
+    testPipelined(convolve, pipelineJobs, Convolve::MAX_BANK_SIGNAL_SIZE, BIG_KERNEL,
+                  percentCorrect, serialRate, pipelinedRate, computeRate);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Jobs/s: separate = " << serialRate << ", pipelined = " << pipelinedRate
+         << ", compute bound = " << computeRate << " ("
+         << pipelinedRate/computeRate*100.0 << "% of the compute bound)" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (sharedThreads > 0) {
+
+    double mutexTime, dispatchTime;
+    ConvolveDispatcher::Stats stats;
+
+    cout << endl << "Testing " << sharedThreads << " threads sharing the accelerator..." << endl;
+
+    testShared(*coreBoards[0], convolve, sharedThreads, 50, MEDIUM_SIGNAL, SMALL_KERNEL,
+               percentCorrect, mutexTime, dispatchTime, stats);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Time: global mutex = " << mutexTime << " s, dispatcher = " << dispatchTime << " s" << endl;
+    cout << "Kernel loads = " << stats.kernelLoads << " for " << stats.jobs << " jobs in "
+         << stats.batches << " batches" << endl;
+    cout << "Queue depth: mean = " << stats.meanDepth << ", max = " << stats.maxDepth << endl;
+    cout << "Wait: mean = " << stats.meanWait*1000.0 << " ms, max = " << stats.maxWait*1000.0
+         << " ms" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (urgentJobs > 0) {
+
+    const char *passes[2] = {"largest slices", "sliced"};
+    const char *classes[2] = {"bulk", "urgent"};
+    DeadlineScheduler::ClassStats stats[2][2];
+
+    cout << endl << "Testing " << urgentJobs << " urgent jobs behind 4 bulk jobs, deadline = "
+         << deadline*1000.0 << " ms..." << endl;
+
+    testDeadline(*coreBoards[0], 4, urgentJobs, deadline, DeadlineScheduler::DEFAULT_SLICE_SIZE,
+                 percentCorrect, stats);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    for (unsigned i=0; i < 2; i++) {
+      for (unsigned j=0; j < 2; j++) {
+        cout << passes[i] << ", " << classes[j] << ": misses = " << stats[i][j].misses << "/"
+             << stats[i][j].jobs << ", latency mean = " << stats[i][j].meanLatency*1000.0
+             << " ms, max = " << stats[i][j].maxLatency*1000.0 << " ms" << endl;
+      }
+    }
+    cout << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (cacheJobs > 0) {
+
+    double uncachedTime, cachedTime;
+    ConvolveCache::Stats stats;
+
+    cout << endl << "Testing " << cacheJobs << " repeated jobs per thread through a result cache..." << endl;
+
+    testCache(convolve, 4, cacheJobs, 16, MEDIUM_SIGNAL, SMALL_KERNEL, spillFile,
+              percentCorrect, uncachedTime, cachedTime, stats);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Time: uncached = " << uncachedTime << " s, cached = " << cachedTime << " s" << endl;
+    cout << "Hit rate = " << stats.hitRate*100.0 << "% (" << stats.hits << " memory, "
+         << stats.spillHits << " spill, " << stats.shared << " in flight), FPGA jobs = "
+         << stats.misses << endl;
+    cout << "Evictions = " << stats.evictions << ", spills = " << stats.spills
+         << ", bytes saved = " << stats.bytesSaved << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (editRounds > 0) {
+
+    double fullTime, incrementalTime;
+    unsigned long hwWindows, windows;
+
+    cout << endl << "Testing " << editRounds << " rounds of edits to a signal of "
+         << BIG_SIGNAL << " samples..." << endl;
+
+    testIncremental(convolve, editRounds, BIG_SIGNAL, BIG_KERNEL, 300, percentCorrect,
+                    fullTime, incrementalTime, hwWindows, windows);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Time: full = " << fullTime << " s, incremental = " << incrementalTime
+         << " s, speedup = " << fullTime/incrementalTime << endl;
+    cout << "Windows = " << windows << " (" << hwWindows << " on the FPGA)" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (multirateFactor > 0) {
+
+    const char *names[4] = {"SW decimate", "HW decimate", "SW interpolate", "HW interpolate"};
+    float correct[4];
+    double fullTime[2], decimatedTime[2];
+
+    cout << endl << "Testing decimation and interpolation by " << multirateFactor << "..." << endl;
+
+    testMultirate(convolve, BIG_SIGNAL, BIG_KERNEL, multirateFactor, correct, fullTime, decimatedTime);
+
+    for (unsigned i=0; i < 4; i++) {
+      cout << names[i] << ": percent correct = " << correct[i]*100.0 << endl;
+    }
+    cout << "HW time: full = " << fullTime[0] << " s, decimated = " << decimatedTime[0] << " s" << endl;
+    cout << "SW time: full = " << fullTime[1] << " s, decimated = " << decimatedTime[1] << " s" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (planKernelSize > 0) {
+
+    cout << endl << "Testing software tap plans for kernels of " << planKernelSize << " taps..." << endl;
+    testTapPlans(BIG_SIGNAL, planKernelSize);
+    cout << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (testOutputModes) {
+
+    unsigned long words[3];
+
+    cout << endl << "Testing full/same/valid output modes..." << endl;
+    testModes(convolve, percentCorrect, words);
+
+    cout << "Percent correct = " << percentCorrect*100.0 << endl;
+    cout << "Words read back: full = " << words[0] << ", same = " << words[1]
+         << ", valid = " << words[2] << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (testQuantizer) {
+
+    const char *names[3] = {"float input", "float output", "int32 input"};
+    float correct[3];
+    double separateTime = 0.0, fusedTime = 0.0;
+
+    cout << endl << "Testing the quantizing front end..." << endl;
+    testQuantize(convolve, BIG_SIGNAL, BIG_KERNEL, correct, separateTime, fusedTime);
+
+    for (unsigned i=0; i < 3; i++) {
+      cout << names[i] << ": percent correct = " << correct[i]*100.0 << endl;
+    }
+    cout << "Time: separate pass = " << separateTime << " s, fused = " << fusedTime << " s" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (verifyJobs > 0) {
+
+    OutputVerifier::Stats stats;
+    double plainTime = 0.0, verifiedTime = 0.0;
+
+    cout << endl << "Testing sampled verification of " << verifyJobs << " jobs, "
+         << verifySamples << " outputs per job..." << endl;
+    testVerifier(convolve, verifyJobs, verifySamples, stats, plainTime, verifiedTime);
+
+    cout << "Jobs = " << stats.jobs << " (" << stats.skipped << " skipped), samples checked = "
+         << stats.samplesChecked << ", full checks = " << stats.fullChecks << endl;
+    cout << "Alerts = " << stats.alerts << ", wrong outputs = " << stats.mismatches << endl;
+    cout << "Time: unverified = " << plainTime << " s, verified = " << verifiedTime << " s" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (cascadeStages > 0) {
+
+    float correct[2];
+    double roundTripTime = 0.0, cascadeTime = 0.0;
+
+    cout << endl << "Testing a cascade of " << cascadeStages << " filters..." << endl;
+    testCascade(convolve, cascadeStages, correct, roundTripTime, cascadeTime);
+
+    cout << "Round trips: percent correct = " << correct[0]*100.0 << ", time = " << roundTripTime << " s" << endl;
+    cout << "Cascade: percent correct = " << correct[1]*100.0 << ", time = " << cascadeTime << " s" << endl << endl;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (thresholdPeaks > 0) {
+
+    float correct[3];
+    unsigned hwCount = 0, swCount = 0, overflowCount = 0;
+    double scanTime = 0.0, eventTime = 0.0;
+
+    cout << endl << "Testing threshold detection of " << thresholdPeaks << " peaks..." << endl;
+    testThreshold(convolve, thresholdPeaks, correct, hwCount, swCount, overflowCount,
+                  scanTime, eventTime);
+
+    cout << "Outputs above the threshold: hardware = " << hwCount << ", software = " << swCount << endl;
+    cout << "Full readback: percent correct = " << correct[0]*100.0 << ", time = " << scanTime << " s" << endl;
+    cout << "Events: percent correct = " << correct[1]*100.0 << ", time = " << eventTime << " s" << endl;
+    cout << "Events past the maximum: count = " << overflowCount << ", percent correct = "
+         << correct[2]*100.0 << endl << endl;
+  }
+
+  App::releaseBuffer(input);
+  App::releaseBuffer(kernel);
+  App::releaseBuffer(swOutput);
+  App::releaseBuffer(hwOutput);
+  App::freeBufferPool();
+  for (unsigned i=1; i < coreBoards.size(); i++) {
+    delete coreBoards[i];
+  }
+  delete tracedBoard;
   delete board;
   return 0;
 }
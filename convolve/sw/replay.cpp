@@ -0,0 +1,227 @@
+// Greg Stitt
+// University of Florida
+// replay.cpp
+//
+// Description: Replays a trace recorded by TraceBoard against the emulated
+// board or the real board and compares the replayed timing against the
+// recorded timing for each class of access.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <time.h>
+
+#include "Board.h"
+#include "EmuBoard.h"
+#include "TraceBoard.h"
+#include "Convolve.h"
+
+using namespace std;
+
+enum AccessClass {
+  ACCESS_RAM_WRITE,
+  ACCESS_RAM_READ,
+  ACCESS_DONE_POLL,
+  ACCESS_REG_WRITE,
+  ACCESS_REG_READ,
+  ACCESS_LAST
+};
+
+static const char *accessNames[ACCESS_LAST] = {
+  "RAM0 writes", "RAM1 reads", "DONE polls", "register writes", "register reads"
+};
+
+struct AccessStats {
+  unsigned long count;
+  unsigned long long words;
+  unsigned long long recordedTime;
+  unsigned long long replayedTime;
+};
+
+
+AccessClass classify(const TraceRecord &r) {
+
+  bool isRead = (r.addr & TRACE_READ_BIT) != 0;
+  unsigned long addr = r.addr & ~TRACE_READ_BIT;
+
+  if (addr < RAM_WORDS)
+    return isRead ? ACCESS_RAM_READ : ACCESS_RAM_WRITE;
+  if (isRead)
+    return addr == DONE_ADDR ? ACCESS_DONE_POLL : ACCESS_REG_READ;
+  return ACCESS_REG_WRITE;
+}
+
+
+bool readTrace(const char *file, TraceHeader &header, vector<TraceRecord> &records) {
+
+  FILE *inFile = fopen(file, "rb");
+  if (inFile == NULL) {
+    cerr << "Error opening " << file << endl;
+    return false;
+  }
+
+  if (fread(&header, sizeof(TraceHeader), 1, inFile) != 1 ||
+      header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+      header.recordBytes != sizeof(TraceRecord)) {
+    cerr << file << " is not a valid trace" << endl;
+    fclose(inFile);
+    return false;
+  }
+
+  TraceRecord r;
+  while (fread(&r, sizeof(TraceRecord), 1, inFile) == 1) {
+    records.push_back(r);
+  }
+
+  fclose(inFile);
+  return true;
+}
+
+
+void waitUntil(unsigned long long time) {
+
+  while (TraceBoard::currentTime() < time);
+}
+
+
+int main(int argc, char* argv[]) {
+
+  const char *traceFile = NULL;
+  const char *bitfile = NULL;
+  bool paced = false;
+
+  for (int i=1; i < argc; i++) {
+    if (strcmp(argv[i], "-paced") == 0)
+      paced = true;
+    else if (traceFile == NULL)
+      traceFile = argv[i];
+    else if (bitfile == NULL)
+      bitfile = argv[i];
+    else
+      traceFile = NULL;
+  }
+
+  if (traceFile == NULL) {
+    cerr << "Usage: " << argv[0] << " trace [bitfile] [-paced]" << endl;
+    cerr << "Replays against the emulated board when no bitfile is given." << endl;
+    return -1;
+  }
+
+  TraceHeader header;
+  vector<TraceRecord> records;
+  if (!readTrace(traceFile, header, records)) {
+    return -1;
+  }
+
+  Board *board;
+  try {
+    if (bitfile == NULL) {
+      board = new EmuBoard();
+    }
+    else {
+      vector<float> clocks(Board::NUM_FPGA_CLOCKS);
+      clocks[0] = 100.0;
+      clocks[1] = 133.0;
+      clocks[2] = 100.0;
+      clocks[3] = 100.0;
+      board = new Board(bitfile, clocks);
+    }
+  }
+  catch(...) {
+    exit(-1);
+  }
+
+  AccessStats stats[ACCESS_LAST];
+  memset(stats, 0, sizeof(stats));
+  vector<unsigned> buffer;
+  unsigned long mismatches = 0;
+  unsigned long extraPolls = 0;
+
+  unsigned long long replayStart = TraceBoard::currentTime();
+
+  for (unsigned i=0; i < records.size(); i++) {
+
+    const TraceRecord &r = records[i];
+    AccessClass type = classify(r);
+    bool isRead = (r.addr & TRACE_READ_BIT) != 0;
+    unsigned long addr = r.addr & ~TRACE_READ_BIT;
+
+    if (buffer.size() < r.words)
+      buffer.resize(r.words);
+
+    // bulk payloads aren't recorded, but transfer time doesn't depend on
+    // the data, so zeros are sent instead
+    if (!isRead) {
+      if (r.words == 1)
+        buffer[0] = r.payload;
+      else
+        fill(buffer.begin(), buffer.begin()+r.words, 0);
+    }
+
+    if (paced)
+      waitUntil(replayStart + r.time);
+
+    unsigned long long start = TraceBoard::currentTime();
+    if (isRead) {
+      board->read(&buffer[0], addr, r.words);
+
+      // a board slower than the recorded one may need extra polls before
+      // done is asserted, so keep polling to keep the replay correct
+      if (type == ACCESS_DONE_POLL && r.payload == 1) {
+        while (buffer[0] != 1) {
+          board->read(&buffer[0], addr, r.words);
+          extraPolls++;
+        }
+      }
+    }
+    else {
+      board->write(&buffer[0], addr, r.words);
+    }
+    unsigned long long stop = TraceBoard::currentTime();
+
+    if (isRead && r.words == 1 && buffer[0] != r.payload)
+      mismatches++;
+
+    stats[type].count++;
+    stats[type].words += r.words;
+    stats[type].recordedTime += r.duration;
+    stats[type].replayedTime += stop - start;
+  }
+
+  unsigned long long replayTime = TraceBoard::currentTime() - replayStart;
+  unsigned long long recordTime = 0;
+  if (!records.empty())
+    recordTime = records.back().time + records.back().duration;
+
+  cout << "Replayed " << records.size() << " accesses from " << traceFile
+       << " on " << (bitfile == NULL ? "emulated board" : bitfile) << endl << endl;
+
+  cout << setw(16) << left << "class" << right
+       << setw(10) << "count" << setw(12) << "words"
+       << setw(14) << "recorded(us)" << setw(14) << "replayed(us)"
+       << setw(10) << "ratio" << endl;
+
+  for (unsigned i=0; i < ACCESS_LAST; i++) {
+
+    if (stats[i].count == 0) continue;
+    cout << setw(16) << left << accessNames[i] << right
+         << setw(10) << stats[i].count << setw(12) << stats[i].words
+         << setw(14) << fixed << setprecision(1) << stats[i].recordedTime/1000.0
+         << setw(14) << stats[i].replayedTime/1000.0
+         << setw(10) << setprecision(3)
+         << (stats[i].recordedTime ? stats[i].replayedTime/(double) stats[i].recordedTime : 0.0)
+         << endl;
+  }
+
+  cout << endl << "Recorded wall time = " << setprecision(1) << recordTime/1000.0 << " us" << endl;
+  cout << "Replayed wall time = " << replayTime/1000.0 << " us" << endl;
+  cout << "Single-word read mismatches = " << mismatches << endl;
+  cout << "Extra DONE polls = " << extraPolls << endl;
+
+  delete board;
+  return 0;
+}
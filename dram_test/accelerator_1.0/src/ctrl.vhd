@@ -9,6 +9,8 @@ entity ctrl is
          rst          : in  std_logic;
          go           : in  std_logic;
          mem_in_go    : out std_logic;
+         ram0_rd_start : in std_logic_vector(RAM0_ADDR_RANGE);
+         ram1_wr_start : in std_logic_vector(RAM1_ADDR_RANGE);
          ram0_rd_addr : out std_logic_vector(RAM0_ADDR_RANGE);
          ram1_wr_addr : out std_logic_vector(RAM1_ADDR_RANGE);
          mem_out_go   : out std_logic;
@@ -37,7 +39,7 @@ begin
         end if;
     end process;
 
-    process(go, state, done_s, mem_out_done)
+    process(go, state, done_s, mem_out_done, ram0_rd_start, ram1_wr_start)
     begin
 
         -- defaults
@@ -67,8 +69,8 @@ begin
                     mem_out_go  <= '1';
 
                     -- start address of ram0_rd and ram1_wr
-                    ram0_rd_addr <= std_logic_vector(to_unsigned(0, C_RAM0_ADDR_WIDTH));
-                    ram1_wr_addr <= std_logic_vector(to_unsigned(0, C_RAM1_ADDR_WIDTH));
+                    ram0_rd_addr <= ram0_rd_start;
+                    ram1_wr_addr <= ram1_wr_start;
                     next_done_s <= '0';
                     done        <= '0';  -- make sure done updated immediately
                     next_state  <= S_WAIT_DONE;
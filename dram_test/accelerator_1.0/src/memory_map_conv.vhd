@@ -47,7 +47,17 @@ entity memory_map_conv is
         -- circuit interface from software        
         go            : out std_logic;
         sw_rst        : out std_logic;
+        keep_signal   : out std_logic;
         signal_size   : out std_logic_vector(RAM0_RD_SIZE_RANGE);
+        signal_addr   : out std_logic_vector(RAM0_ADDR_RANGE);
+        bank          : out std_logic;
+        decimate_factor : out std_logic_vector(DECIMATE_FACTOR_RANGE);
+        decimate_size   : out std_logic_vector(RAM1_WR_SIZE_RANGE);
+        cascade         : out std_logic;
+        cascade_addr    : out std_logic_vector(RAM0_ADDR_RANGE);
+        threshold       : out std_logic_vector(SIGNAL_WIDTH_RANGE);
+        max_events      : out std_logic_vector(C_MAX_EVENTS_WIDTH-1 downto 0);
+        event_count     : in  std_logic_vector(RAM1_WR_SIZE_RANGE);
         kernel_data   : out std_logic_vector(KERNEL_WIDTH_RANGE);
         kernel_load   : out std_logic;
         kernel_loaded : in  std_logic;
@@ -59,7 +69,16 @@ architecture BHV of memory_map_conv is
 
     signal reg_go          : std_logic;
     signal reg_rst         : std_logic;
+    signal reg_keep_signal : std_logic;
     signal reg_signal_size : std_logic_vector(MAX_SIGNAL_SIZE_RANGE);
+    signal reg_signal_addr : std_logic_vector(RAM0_ADDR_RANGE);
+    signal reg_bank        : std_logic;
+    signal reg_decimate_factor : std_logic_vector(DECIMATE_FACTOR_RANGE);
+    signal reg_decimate_size   : std_logic_vector(RAM1_WR_SIZE_RANGE);
+    signal reg_cascade         : std_logic;
+    signal reg_cascade_addr    : std_logic_vector(RAM0_ADDR_RANGE);
+    signal reg_threshold       : std_logic_vector(SIGNAL_WIDTH_RANGE);
+    signal reg_max_events      : std_logic_vector(C_MAX_EVENTS_WIDTH-1 downto 0);
     signal reg_kernel_data : std_logic_vector(KERNEL_WIDTH_RANGE);
 
     signal ram0_wr_go_s    : std_logic;
@@ -86,7 +105,16 @@ begin
         if (rst = '1') then
             reg_go          <= '0';
             reg_rst         <= '0';
+            reg_keep_signal <= '0';
             reg_signal_size <= (others => '0');
+            reg_signal_addr <= (others => '0');
+            reg_bank        <= '0';
+            reg_decimate_factor <= std_logic_vector(to_unsigned(1, C_DECIMATE_FACTOR_WIDTH));
+            reg_decimate_size   <= (others => '0');
+            reg_cascade         <= '0';
+            reg_cascade_addr    <= (others => '0');
+            reg_threshold       <= (others => '0');
+            reg_max_events      <= (others => '0');
             reg_kernel_data <= (others => '0');
             kernel_load <= '0';
 
@@ -117,9 +145,10 @@ begin
 
         elsif (rising_edge(clk)) then
 
-            reg_go      <= '0';
-            reg_rst     <= '0';
-            kernel_load <= '0';
+            reg_go          <= '0';
+            reg_rst         <= '0';
+            reg_keep_signal <= '0';
+            kernel_load     <= '0';
 
             ram0_wr_clear  <= '0';
             ram0_wr_go_s   <= '0';
@@ -155,7 +184,14 @@ begin
                 case wr_addr is
 
                     when C_RST_ADDR =>
-                        reg_rst <= wr_data(0);
+                        reg_rst         <= wr_data(0);
+                        reg_keep_signal <= wr_data(C_RST_KEEP_SIGNAL_BIT);
+                        -- every stage of a cascade enables the loopback
+                        -- again, and every detection its threshold
+                        if (wr_data(0) = '1') then
+                            reg_cascade    <= '0';
+                            reg_max_events <= (others => '0');
+                        end if;
 
                     when C_GO_ADDR =>
                         reg_go <= wr_data(0);
@@ -163,6 +199,29 @@ begin
                     when C_SIGNAL_SIZE_ADDR =>
                         reg_signal_size <= wr_data(reg_signal_size'range);
 
+                    -- word address in RAM0 of the first signal sample
+                    when C_SIGNAL_ADDR_ADDR =>
+                        reg_signal_addr <= wr_data(reg_signal_addr'range);
+
+                    -- half of RAM0 and RAM1 used by the next go
+                    when C_BANK_ADDR =>
+                        reg_bank <= wr_data(0);
+
+                    -- only every factor-th output is written to RAM1
+                    when C_DECIMATE_ADDR =>
+                        reg_decimate_factor <= wr_data(DECIMATE_FACTOR_RANGE);
+                        reg_decimate_size   <= wr_data(DECIMATE_SIZE_RANGE);
+
+                    -- the next go also loops its outputs back into RAM0
+                    when C_CASCADE_ADDR =>
+                        reg_cascade      <= wr_data(C_CASCADE_ENABLE_BIT);
+                        reg_cascade_addr <= wr_data(CASCADE_ADDR_RANGE);
+
+                    -- only outputs above the threshold are written to RAM1
+                    when C_THRESHOLD_ADDR =>
+                        reg_threshold  <= wr_data(THRESHOLD_RANGE);
+                        reg_max_events <= wr_data(MAX_EVENTS_RANGE);
+
                     when C_KERNEL_DATA_ADDR =>
                         reg_kernel_data <= wr_data(kernel_data'range);
                         kernel_load     <= '1'; 
@@ -219,6 +278,33 @@ begin
                         rd_data                        <= (others => '0');
                         rd_data(reg_signal_size'range) <= reg_signal_size;
 
+                    when C_SIGNAL_ADDR_ADDR =>
+                        rd_data                        <= (others => '0');
+                        rd_data(reg_signal_addr'range) <= reg_signal_addr;
+
+                    when C_BANK_ADDR =>
+                        rd_data    <= (others => '0');
+                        rd_data(0) <= reg_bank;
+
+                    when C_DECIMATE_ADDR =>
+                        rd_data                        <= (others => '0');
+                        rd_data(DECIMATE_FACTOR_RANGE) <= reg_decimate_factor;
+                        rd_data(DECIMATE_SIZE_RANGE)   <= reg_decimate_size;
+
+                    when C_CASCADE_ADDR =>
+                        rd_data                        <= (others => '0');
+                        rd_data(C_CASCADE_ENABLE_BIT)  <= reg_cascade;
+                        rd_data(CASCADE_ADDR_RANGE)    <= reg_cascade_addr;
+
+                    when C_THRESHOLD_ADDR =>
+                        rd_data                        <= (others => '0');
+                        rd_data(THRESHOLD_RANGE)       <= reg_threshold;
+                        rd_data(MAX_EVENTS_RANGE)      <= reg_max_events;
+
+                    when C_EVENT_COUNT_ADDR =>
+                        rd_data                        <= (others => '0');
+                        rd_data(event_count'range)     <= event_count;
+
                     when C_KERNEL_DATA_ADDR =>
                         rd_data                        <= (others => '0');
                         rd_data(reg_kernel_data'range) <= reg_kernel_data;
@@ -240,7 +326,16 @@ begin
 
     go          <= reg_go;
     sw_rst      <= reg_rst;
+    keep_signal <= reg_keep_signal;
     signal_size <= reg_signal_size;
+    signal_addr <= reg_signal_addr;
+    bank        <= reg_bank;
+    decimate_factor <= reg_decimate_factor;
+    decimate_size   <= reg_decimate_size;
+    cascade         <= reg_cascade;
+    cascade_addr    <= reg_cascade_addr;
+    threshold       <= reg_threshold;
+    max_events      <= reg_max_events;
     kernel_data <= reg_kernel_data;
 
 end BHV;
@@ -0,0 +1,120 @@
+-- Greg Stitt
+-- University of Florida
+
+-- Entity: pad_gen
+-- Feeds the signal buffer with the zero-padded signal without the padding
+-- ever being stored in RAM0. After go, the entity shifts pad_size zeros into
+-- the signal buffer, then the size samples read from RAM0, and then
+-- pad_size+1 trailing zeros (the extra zero matches the final window of the
+-- original host-padded layout, which is discarded by the RAM1 write size).
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.config_pkg.all;
+use work.user_pkg.all;
+
+entity pad_gen is
+    generic(pad_size : natural := C_KERNEL_SIZE-1);
+    port(clk       : in  std_logic;
+         rst       : in  std_logic;
+         go        : in  std_logic;
+         size      : in  std_logic_vector(RAM0_RD_SIZE_RANGE);
+         mem_valid : in  std_logic;
+         full      : in  std_logic;
+         mem_rd_en : out std_logic;
+         wr_en     : out std_logic;
+         wr_zero   : out std_logic);
+end pad_gen;
+
+architecture bhv of pad_gen is
+
+    type STATE_TYPE is (S_WAIT_GO, S_LEAD, S_DATA, S_TRAIL);
+    signal state, next_state : STATE_TYPE;
+    signal count, next_count : unsigned(RAM0_RD_SIZE_RANGE);
+
+begin
+
+    process(clk, rst)
+    begin
+        if (rst = '1') then
+            state <= S_WAIT_GO;
+            count <= (others => '0');
+        elsif (clk = '1' and clk'event) then
+            state <= next_state;
+            count <= next_count;
+        end if;
+    end process;
+
+    process(go, state, count, size, mem_valid, full)
+    begin
+
+        -- defaults
+        next_state <= state;
+        next_count <= count;
+
+        mem_rd_en <= '0';
+        wr_en     <= '0';
+        wr_zero   <= '0';
+
+        case state is
+            when S_WAIT_GO =>
+
+                if (go = '1') then
+                    next_count <= (others => '0');
+                    if (pad_size > 0) then
+                        next_state <= S_LEAD;
+                    elsif (unsigned(size) > 0) then
+                        next_state <= S_DATA;
+                    else
+                        next_state <= S_TRAIL;
+                    end if;
+                end if;
+
+            when S_LEAD =>
+
+                if (full = '0') then
+                    wr_en      <= '1';
+                    wr_zero    <= '1';
+                    next_count <= count + 1;
+
+                    if (count = pad_size-1) then
+                        next_count <= (others => '0');
+                        if (unsigned(size) > 0) then
+                            next_state <= S_DATA;
+                        else
+                            next_state <= S_TRAIL;
+                        end if;
+                    end if;
+                end if;
+
+            when S_DATA =>
+
+                -- only works because of first word fall through
+                if (mem_valid = '1' and full = '0') then
+                    mem_rd_en  <= '1';
+                    wr_en      <= '1';
+                    next_count <= count + 1;
+
+                    if (count = unsigned(size)-1) then
+                        next_count <= (others => '0');
+                        next_state <= S_TRAIL;
+                    end if;
+                end if;
+
+            when S_TRAIL =>
+
+                if (full = '0') then
+                    wr_en      <= '1';
+                    wr_zero    <= '1';
+                    next_count <= count + 1;
+
+                    if (count = pad_size) then
+                        next_state <= S_WAIT_GO;
+                    end if;
+                end if;
+
+            when others => null;
+        end case;
+    end process;
+end bhv;
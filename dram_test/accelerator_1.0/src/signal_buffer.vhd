@@ -14,6 +14,8 @@ entity signal_buffer is
         rst      : in std_logic;
         rd_en    : in std_logic;
         wr_en    : in std_logic;
+        -- shifts in a zero instead of input (used for the signal padding)
+        wr_zero  : in std_logic := '0';
         full     : out std_logic;
         empty    : out std_logic;
         input    : in std_logic_vector(width-1 downto 0);
@@ -60,7 +62,11 @@ begin
                     full_s <= '0';
 
                     -- input goes to first array element
-                    output_array(0) <= input;
+                    if (wr_zero = '1') then
+                        output_array(0) <= (others => '0');
+                    else
+                        output_array(0) <= input;
+                    end if;
 
                     -- shift elements by 1 and last element gets shifted out
                     for i in 0 to size-2 loop
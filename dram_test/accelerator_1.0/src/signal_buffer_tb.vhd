@@ -15,7 +15,7 @@ architecture TB of signal_buffer_tb is
 
     signal clk0 : std_logic := '0';
     signal rst  : std_logic := '1';
-    signal en, rd_en, wr_en, full, empty : std_logic;
+    signal en, rd_en, wr_en, wr_zero, full, empty : std_logic;
     signal input : std_logic_vector(width-1 downto 0);
     signal output : std_logic_vector(size*width-1 downto 0);
     signal sim_done : std_logic := '0';
@@ -29,9 +29,9 @@ begin
         port map (
             clk    => clk0,
             rst    => rst,
-            en     => en,
             rd_en  => rd_en,
             wr_en  => wr_en,
+            wr_zero => wr_zero,
             full   => full,
             empty  => empty,
             input  => input,
@@ -64,6 +64,7 @@ begin
         en <= '0';
         rd_en <= '0';
         wr_en <= '0';
+        wr_zero <= '0';
 
         -- wait for 500 ns;
         for i in 0 to 20 loop
@@ -109,6 +110,42 @@ begin
             wait until rising_edge(clk0);
         end loop;
 
+        -- fill the buffer with nonzero values from a reset, read every
+        -- window, and then shift in zeros for the padding while input is
+        -- still nonzero, which should leave an all-zero window
+        rst <= '1';
+        rd_en <= '0';
+        wr_en <= '0';
+        wait until rising_edge(clk0);
+        rst <= '0';
+
+        input <= (others => '1');
+        wr_en <= '1';
+        for i in 0 to size-1 loop
+            wait until rising_edge(clk0);
+        end loop;
+        wr_en <= '0';
+        wait until rising_edge(clk0);
+
+        assert(output = (output'range => '1')) report "Window isn't all ones" severity error;
+
+        rd_en <= '1';
+        for i in 0 to size-1 loop
+            wait until rising_edge(clk0);
+        end loop;
+        rd_en <= '0';
+
+        wr_en <= '1';
+        wr_zero <= '1';
+        for i in 0 to size-1 loop
+            wait until rising_edge(clk0);
+        end loop;
+        wr_en <= '0';
+        wr_zero <= '0';
+        wait until rising_edge(clk0);
+
+        assert(output = (output'range => '0')) report "Padding window isn't all zeros" severity error;
+
         report "SIMULATION FINISHED!!!";
         sim_done <= '1';
         wait;
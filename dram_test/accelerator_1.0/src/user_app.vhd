@@ -71,9 +71,57 @@ architecture default of user_app is
 
     signal go            : std_logic;
     signal sw_rst_s      : std_logic;
+    signal keep_signal_s : std_logic;
     signal rst_s         : std_logic;
     signal unpadded_size : std_logic_vector(RAM0_RD_SIZE_RANGE);
+    signal signal_addr   : std_logic_vector(RAM0_ADDR_RANGE);
+    signal bank          : std_logic;
+    signal bank_offset   : std_logic_vector(RAM0_ADDR_RANGE);
+    signal ram0_rd_start : std_logic_vector(RAM0_ADDR_RANGE);
+    signal ram1_wr_start : std_logic_vector(RAM1_ADDR_RANGE);
+    signal decimate_factor : std_logic_vector(DECIMATE_FACTOR_RANGE);
+    signal decimate_size   : std_logic_vector(RAM1_WR_SIZE_RANGE);
+    signal decimate_phase  : unsigned(DECIMATE_FACTOR_RANGE);
+    signal ram1_wr_size_s  : std_logic_vector(RAM1_WR_SIZE_RANGE);
+    signal out_size_s      : std_logic_vector(RAM1_WR_SIZE_RANGE);
     signal done          : std_logic;
+    signal ctrl_done     : std_logic;
+
+    -- RAM0 writes from software, and the loopback of a cascade stage
+    signal mmap_ram0_wr_clear : std_logic;
+    signal mmap_ram0_wr_go    : std_logic;
+    signal mmap_ram0_wr_valid : std_logic;
+    signal mmap_ram0_wr_data  : std_logic_vector(RAM0_WR_DATA_RANGE);
+    signal mmap_ram0_wr_addr  : std_logic_vector(RAM0_ADDR_RANGE);
+    signal mmap_ram0_wr_size  : std_logic_vector(RAM0_WR_SIZE_RANGE);
+    signal cascade         : std_logic;
+    signal cascade_addr    : std_logic_vector(RAM0_ADDR_RANGE);
+    signal loop_clear      : std_logic;
+    signal loop_go         : std_logic;
+    signal loop_valid      : std_logic;
+    signal loop_data       : std_logic_vector(RAM0_WR_DATA_RANGE);
+    signal loop_low        : std_logic_vector(RAM1_WR_DATA_RANGE);
+    signal loop_half       : std_logic;
+    signal loop_count      : unsigned(RAM1_WR_SIZE_RANGE);
+    signal loop_size       : std_logic_vector(RAM0_WR_SIZE_RANGE);
+
+    -- threshold detection
+    signal threshold       : std_logic_vector(SIGNAL_WIDTH_RANGE);
+    signal max_events      : std_logic_vector(C_MAX_EVENTS_WIDTH-1 downto 0);
+    signal detect          : std_logic;
+    signal out_count       : unsigned(RAM1_WR_SIZE_RANGE);
+    signal event_count     : unsigned(RAM1_WR_SIZE_RANGE);
+    signal events_stored   : unsigned(RAM1_WR_SIZE_RANGE);
+    signal event_fills     : unsigned(RAM1_WR_SIZE_RANGE);
+    signal event_second    : std_logic;
+    signal event_value     : std_logic_vector(RAM1_WR_DATA_RANGE);
+    signal event_hit_s     : std_logic;
+    signal event_fill_s    : std_logic;
+    signal event_valid_s   : std_logic;
+    signal event_data_s    : std_logic_vector(RAM1_WR_DATA_RANGE);
+    signal events_full_s   : std_logic;
+    signal out_ram1_ready_s : std_logic;
+    signal detect_done_s   : std_logic;
 
     -------------------------------------------------------------------------------------------------------------------------------
     -- convolusion signals
@@ -81,6 +129,7 @@ architecture default of user_app is
     signal sb_full_s       : std_logic;
     signal sb_rd_en_s      : std_logic;
     signal sb_wr_en_s      : std_logic;
+    signal sb_wr_zero_s    : std_logic;
 
     signal kernel_empty_s  : std_logic;
     signal kernel_full_s   : std_logic;
@@ -93,6 +142,10 @@ architecture default of user_app is
     signal dp_valid_in_s   : std_logic;
     signal dp_valid_out_s  : std_logic;
     signal ram0_rd_rd_en_s : std_logic;
+    signal dp_write_s      : std_logic;
+    signal dp_keep_s       : std_logic;
+    signal out_write_s     : std_logic;
+    signal out_ready_s     : std_logic;
 
     signal dp_out_s         : std_logic_vector(2*C_SIGNAL_WIDTH+clog2(C_KERNEL_SIZE)-1 downto 0);
     signal dp_out_s_tmp     : std_logic_vector(2*C_SIGNAL_WIDTH+clog2(C_KERNEL_SIZE)-1 downto 0);
@@ -118,12 +171,12 @@ begin
 
             -- dma interface for accessing DRAM from software
             ram0_wr_ready => ram0_wr_ready,
-            ram0_wr_clear => ram0_wr_clear,
-            ram0_wr_go    => ram0_wr_go,
-            ram0_wr_valid => ram0_wr_valid,
-            ram0_wr_data  => ram0_wr_data,
-            ram0_wr_addr  => ram0_wr_addr,
-            ram0_wr_size  => ram0_wr_size,
+            ram0_wr_clear => mmap_ram0_wr_clear,
+            ram0_wr_go    => mmap_ram0_wr_go,
+            ram0_wr_valid => mmap_ram0_wr_valid,
+            ram0_wr_data  => mmap_ram0_wr_data,
+            ram0_wr_addr  => mmap_ram0_wr_addr,
+            ram0_wr_size  => mmap_ram0_wr_size,
             ram0_wr_done  => ram0_wr_done,
 
             ram1_rd_rd_en => ram1_rd_rd_en,
@@ -138,7 +191,17 @@ begin
             -- circuit interface from software
             go        => go,
             sw_rst    => sw_rst_s,
+            keep_signal => keep_signal_s,
             signal_size => unpadded_size,
+            signal_addr => signal_addr,
+            bank        => bank,
+            decimate_factor => decimate_factor,
+            decimate_size   => decimate_size,
+            cascade         => cascade,
+            cascade_addr    => cascade_addr,
+            threshold       => threshold,
+            max_events      => max_events,
+            event_count     => std_logic_vector(event_count),
 
             kernel_data => kernel_data_s,
             kernel_load => kernel_load_s,
@@ -147,7 +210,17 @@ begin
             done => done);
 
     rst_s  <= rst or sw_rst_s;
-    sw_rst <= sw_rst_s;
+
+    -- a reset that keeps the signal only resets the convolution pipeline.
+    -- The wrapper's RAM0 DMA and DRAM are left alone, so the next go reads
+    -- the padded signal from the previous upload again.
+    sw_rst <= sw_rst_s and not keep_signal_s;
+
+    -- the bank selects the half of RAM0 and RAM1 used by the next go, so
+    -- software can fill and drain the other half while it computes
+    bank_offset   <= bank & std_logic_vector(to_unsigned(0, C_RAM0_ADDR_WIDTH-1));
+    ram0_rd_start <= signal_addr + bank_offset;
+    ram1_wr_start <= bank & std_logic_vector(to_unsigned(0, C_RAM1_ADDR_WIDTH-1));
 
     U_CTRL : entity work.ctrl
         port map (
@@ -155,6 +228,9 @@ begin
             rst           => rst_s,
             go            => go,
             mem_in_go     => ram0_rd_go,
+            -- windows of a signal staged in DRAM start at any word
+            ram0_rd_start => ram0_rd_start,
+            ram1_wr_start => ram1_wr_start,
             --ram0_rd_done => ram0_rd_done, I don't think this is needed
             --ram1_wr_done => ram1_wr_done,
             ram0_rd_addr  => ram0_rd_addr,
@@ -163,7 +239,14 @@ begin
             mem_in_clear  => ram0_rd_clear,
             mem_out_clear => ram1_wr_clear,
             mem_out_done  => ram1_wr_done,
-            done          => done);
+            done          => ctrl_done);
+
+    -- a cascade stage is also done once its outputs are in RAM0. When
+    -- detecting, RAM1's transfer can finish once the last event slot is
+    -- written, before every output has been counted, so detection is only
+    -- done once the last output has been seen.
+    detect_done_s <= '1' when detect = '0' or out_count = unsigned(out_size_s) else '0';
+    done <= ctrl_done and (ram0_wr_done or not cascade) and detect_done_s;
 
 
     ---------------------------------------------------------------------------------------------------------------------------------------------
@@ -171,29 +254,194 @@ begin
     -- control signals --
     kernel_loaded_s <= not(kernel_empty_s); -- software can read and verify kernel is loaded
 
-    -- read size including padded 0's
-    ram0_rd_size <= unpadded_size + 2*C_KERNEL_SIZE-1;
+    -- only the real samples are stored in RAM0, since pad_gen supplies the
+    -- padded 0's. Odd sizes are rounded up to a whole 32-bit word.
+    ram0_rd_size <= unpadded_size + unpadded_size(0);
 
     -- TODO verify this size, but should be amount of unique windows 
-    ram1_wr_size  <= unpadded_size+C_KERNEL_SIZE-1;
+    -- When decimating, software provides the number of outputs kept.
+    out_size_s <= decimate_size when unsigned(decimate_factor) > 1 else
+                  unpadded_size+C_KERNEL_SIZE-1;
+
+    -- when detecting, RAM1 always receives max_events events of two
+    -- elements each, so its DMA finishes no matter how many outputs pass
+    detect         <= '1' when unsigned(max_events) > 0 else '0';
+    ram1_wr_size_s <= max_events & '0' when detect = '1' else out_size_s;
+    ram1_wr_size   <= ram1_wr_size_s;
 
-    -- only works because of first word fall through
-    ram0_rd_rd_en_s <= ram0_rd_valid and not(sb_full_s);
     ram0_rd_rd_en <= ram0_rd_rd_en_s;
 
-    -- anytime we read from input memory, we write into signal buffer.
-    sb_rd_en_s <= not(sb_empty_s) and ram1_wr_ready;
-    sb_wr_en_s <= ram0_rd_rd_en_s; 
+    -- a cascade stage also stalls while the loopback into RAM0 is full, and
+    -- detection stalls for a cycle while it writes the value of an event.
+    -- Once every event slot is stored, detection no longer writes RAM1, so
+    -- the outputs that are only counted don't wait for it.
+    events_full_s    <= '1' when events_stored >= unsigned(max_events) else '0';
+    out_ram1_ready_s <= '1' when detect = '1' and events_full_s = '1' else ram1_wr_ready;
+    out_ready_s      <= out_ram1_ready_s and (ram0_wr_ready or not cascade) and not event_second;
+
+    sb_rd_en_s <= not(sb_empty_s) and out_ready_s;
+
+    -- output of user_app into ram1_wr. When decimating, only outputs
+    -- 0, factor, 2*factor, ... are written, so the discarded outputs are
+    -- never read back.
+    dp_write_s    <= dp_valid_out_s and out_ready_s;
+    dp_keep_s     <= '1' when decimate_phase = 0 else '0';
+    out_write_s   <= dp_write_s and dp_keep_s;
+    ram1_wr_valid <= event_valid_s when detect = '1' else out_write_s;
+
+    -- position of the current output within its group of factor outputs.
+    -- A factor of 0 or 1 keeps every output.
+    process(clks(C_CLK_USER), rst_s)
+    begin
+        if (rst_s = '1') then
+            decimate_phase <= (others => '0');
+        elsif (rising_edge(clks(C_CLK_USER))) then
+            if (dp_write_s = '1') then
+                if (decimate_phase+1 >= unsigned(decimate_factor)) then
+                    decimate_phase <= (others => '0');
+                else
+                    decimate_phase <= decimate_phase+1;
+                end if;
+            end if;
+        end if;
+    end process;
+    ram1_wr_data <= event_data_s when detect = '1' else dp_out_clipped_s;
+
+
+    -- threshold detection: each kept output above the threshold is written
+    -- to RAM1 as its index (position among the kept outputs) followed by
+    -- its value, so each event is one 32-bit word with the index in the low
+    -- half. Only the first max_events events are stored, but event_count
+    -- counts all of them, and done waits for the last output. Once every
+    -- output has been seen, the rest of the max_events slots are filled
+    -- with 0's to complete the RAM1 transfer.
+    event_hit_s <= '1' when out_write_s = '1' and unsigned(dp_out_clipped_s) > unsigned(threshold) and
+                   events_full_s = '0' else '0';
+    event_fill_s <= '1' when event_second = '0' and out_count = unsigned(out_size_s) and
+                    (events_stored & '0')+event_fills < unsigned(max_events) & '0' else '0';
+
+    event_valid_s <= event_hit_s or ((event_second or event_fill_s) and ram1_wr_ready);
+    event_data_s  <= std_logic_vector(out_count(RAM1_WR_DATA_RANGE)) when event_hit_s = '1' else
+                     event_value when event_second = '1' else
+                     (others => '0');
+
+    process(clks(C_CLK_USER), rst_s)
+    begin
+        if (rst_s = '1') then
+            out_count     <= (others => '0');
+            event_count   <= (others => '0');
+            events_stored <= (others => '0');
+            event_fills   <= (others => '0');
+            event_second  <= '0';
+            event_value   <= (others => '0');
+        elsif (rising_edge(clks(C_CLK_USER))) then
+
+            if (go = '1') then
+                out_count     <= (others => '0');
+                event_count   <= (others => '0');
+                events_stored <= (others => '0');
+                event_fills   <= (others => '0');
+                event_second  <= '0';
+
+            elsif (detect = '1') then
+
+                if (out_write_s = '1') then
+                    out_count <= out_count+1;
+                    if (unsigned(dp_out_clipped_s) > unsigned(threshold)) then
+                        event_count <= event_count+1;
+                    end if;
+                end if;
+
+                if (event_hit_s = '1') then
+                    event_second <= '1';
+                    event_value  <= dp_out_clipped_s;
+                elsif (event_second = '1' and ram1_wr_ready = '1') then
+                    event_second  <= '0';
+                    events_stored <= events_stored+1;
+                elsif (event_fill_s = '1' and ram1_wr_ready = '1') then
+                    event_fills <= event_fills+1;
+                end if;
+            end if;
+        end if;
+    end process;
+
+
+    -- loopback for cascades: the outputs written to RAM1 are also packed two
+    -- per word (first output in the low half) and written to RAM0 from
+    -- cascade_addr on, where the next stage reads them as its signal. The
+    -- DMA is cleared on go and started a cycle later, like the memory map
+    -- does for software writes. Software has finished its RAM0 upload by
+    -- the time it writes go. An odd last output is written with a 0 upper
+    -- half, which the next stage ignores since its size excludes it.
+    loop_size <= std_logic_vector(resize(shift_right(unsigned(out_size_s)+1, 1), C_RAM0_WR_SIZE_WIDTH));
+
+    process(clks(C_CLK_USER), rst_s)
+    begin
+        if (rst_s = '1') then
+            loop_clear <= '0';
+            loop_go    <= '0';
+            loop_valid <= '0';
+            loop_data  <= (others => '0');
+            loop_low   <= (others => '0');
+            loop_half  <= '0';
+            loop_count <= (others => '0');
+        elsif (rising_edge(clks(C_CLK_USER))) then
+
+            loop_clear <= '0';
+            loop_go    <= loop_clear;
+            loop_valid <= '0';
+
+            if (go = '1' and cascade = '1') then
+                loop_clear <= '1';
+                loop_half  <= '0';
+                loop_count <= (others => '0');
+            end if;
+
+            if (cascade = '1' and out_write_s = '1') then
+                loop_count <= loop_count+1;
+
+                if (loop_half = '1') then
+                    loop_data  <= dp_out_clipped_s & loop_low;
+                    loop_valid <= '1';
+                    loop_half  <= '0';
+                elsif (loop_count+1 = unsigned(out_size_s)) then
+                    loop_data  <= std_logic_vector(to_unsigned(0, C_RAM1_WR_DATA_WIDTH)) & dp_out_clipped_s;
+                    loop_valid <= '1';
+                else
+                    loop_low  <= dp_out_clipped_s;
+                    loop_half <= '1';
+                end if;
+            end if;
+        end if;
+    end process;
+
+    ram0_wr_clear <= loop_clear   when cascade = '1' else mmap_ram0_wr_clear;
+    ram0_wr_go    <= loop_go      when cascade = '1' else mmap_ram0_wr_go;
+    ram0_wr_valid <= loop_valid   when cascade = '1' else mmap_ram0_wr_valid;
+    ram0_wr_data  <= loop_data    when cascade = '1' else mmap_ram0_wr_data;
+    ram0_wr_addr  <= cascade_addr when cascade = '1' else mmap_ram0_wr_addr;
+    ram0_wr_size  <= loop_size    when cascade = '1' else mmap_ram0_wr_size;
+
 
-    -- output of user_app into ram1_wr
-    ram1_wr_valid <= dp_valid_out_s and ram1_wr_ready; 
-    ram1_wr_data <= dp_out_clipped_s;
-    
-    
     dp_valid_in_s <= sb_rd_en_s;
-    dp_en <= ram1_wr_ready; -- delay this signal using and
+    dp_en <= out_ready_s; -- delay this signal using and
+
+
 
 
+    -- writes the leading 0's, the signal from RAM0 and the trailing 0's
+    -- into the signal buffer
+    U_PAD_GEN: entity work.pad_gen
+        port map(
+            clk       => clks(C_CLK_USER),
+            rst       => rst_s,
+            go        => go,
+            size      => unpadded_size,
+            mem_valid => ram0_rd_valid,
+            full      => sb_full_s,
+            mem_rd_en => ram0_rd_rd_en_s,
+            wr_en     => sb_wr_en_s,
+            wr_zero   => sb_wr_zero_s);
 
 
     -- signal buffer entity 
@@ -206,6 +454,7 @@ begin
             rst => rst,
             rd_en => sb_rd_en_s,
             wr_en => sb_wr_en_s,
+            wr_zero => sb_wr_zero_s,
             full => sb_full_s,
             empty => sb_empty_s,
             input => ram0_rd_data,
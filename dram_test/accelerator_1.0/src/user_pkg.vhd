@@ -61,6 +61,12 @@ package user_pkg is
 --    constant C_MEM_START_ADDR : std_logic_vector(MMAP_ADDR_RANGE) := (others => '0');
 --    constant C_MEM_END_ADDR   : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(unsigned(C_MEM_START_ADDR)+(2**C_MEM_ADDR_WIDTH-1));
 
+    constant C_EVENT_COUNT_ADDR   : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-14, C_MMAP_ADDR_WIDTH));
+    constant C_THRESHOLD_ADDR     : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-13, C_MMAP_ADDR_WIDTH));
+    constant C_CASCADE_ADDR       : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-12, C_MMAP_ADDR_WIDTH));
+    constant C_DECIMATE_ADDR      : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-11, C_MMAP_ADDR_WIDTH));
+    constant C_BANK_ADDR          : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-10, C_MMAP_ADDR_WIDTH));
+    constant C_SIGNAL_ADDR_ADDR   : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-9, C_MMAP_ADDR_WIDTH));
     constant C_RAM0_DMA_ADDR      : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-8, C_MMAP_ADDR_WIDTH));
     constant C_RAM1_DMA_ADDR      : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-7, C_MMAP_ADDR_WIDTH));
     constant C_GO_ADDR            : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-6, C_MMAP_ADDR_WIDTH));
@@ -70,6 +76,31 @@ package user_pkg is
     constant C_SIGNAL_SIZE_ADDR   : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-2, C_MMAP_ADDR_WIDTH));
     constant C_DONE_ADDR          : std_logic_vector(MMAP_ADDR_RANGE) := std_logic_vector(to_unsigned(2**C_MMAP_ADDR_WIDTH-1, C_MMAP_ADDR_WIDTH));
 
+    -- bit of a C_RST_ADDR write that resets the pipeline but leaves the
+    -- DRAM interfaces alone, so the signal in RAM0 can be convolved again
+    constant C_RST_KEEP_SIGNAL_BIT : natural := 1;
+
+    -- a C_DECIMATE_ADDR write holds the decimation factor in its low bits
+    -- and the number of outputs kept (written to RAM1) above them
+    constant C_DECIMATE_FACTOR_WIDTH : positive := 8;
+    subtype DECIMATE_FACTOR_RANGE is natural range C_DECIMATE_FACTOR_WIDTH-1 downto 0;
+    subtype DECIMATE_SIZE_RANGE is natural range C_DECIMATE_FACTOR_WIDTH+C_RAM1_WR_SIZE_WIDTH-1 downto C_DECIMATE_FACTOR_WIDTH;
+
+    -- a C_CASCADE_ADDR write with the enable bit set makes the next go also
+    -- write its outputs to RAM0, starting at the word address above the
+    -- enable bit. Any C_RST_ADDR write disables it.
+    constant C_CASCADE_ENABLE_BIT : natural := 0;
+    subtype CASCADE_ADDR_RANGE is natural range C_RAM0_ADDR_WIDTH downto 1;
+
+    -- a C_THRESHOLD_ADDR write holds the threshold in its low bits and the
+    -- maximum number of events above them. With a nonzero maximum, the next
+    -- go writes an (index, value) event to RAM1 for each output above the
+    -- threshold instead of the outputs, and C_EVENT_COUNT_ADDR counts them.
+    -- Any C_RST_ADDR write disables it.
+    constant C_MAX_EVENTS_WIDTH : positive := C_RAM1_ADDR_WIDTH+1;
+    subtype THRESHOLD_RANGE is natural range C_SIGNAL_WIDTH-1 downto 0;
+    subtype MAX_EVENTS_RANGE is natural range C_SIGNAL_WIDTH+C_MAX_EVENTS_WIDTH-1 downto C_SIGNAL_WIDTH;
+
     constant C_1 : std_logic := '1';
     constant C_0 : std_logic := '0';
     
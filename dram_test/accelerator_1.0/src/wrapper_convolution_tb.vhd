@@ -20,7 +20,10 @@ end wrapper_tb;
 architecture behavior of wrapper_tb is
 
     constant TEST_SIZE  : integer := 6;
-    constant DMA_SIZE   : integer := integer(ceil(real(TEST_SIZE+C_KERNEL_WIDTH)*real(C_RAM0_RD_DATA_WIDTH)/real(C_DRAM0_DATA_WIDTH)));
+    -- only the unpadded signal is transferred, the accelerator adds the 0's
+    constant DMA_SIZE   : integer := integer(ceil(real(TEST_SIZE)*real(C_RAM0_RD_DATA_WIDTH)/real(C_DRAM0_DATA_WIDTH)));
+    constant OUTPUT_SIZE  : integer := TEST_SIZE+C_KERNEL_SIZE-1;
+    constant OUT_DMA_SIZE : integer := integer(ceil(real(OUTPUT_SIZE)*real(C_RAM1_WR_DATA_WIDTH)/real(C_DRAM1_DATA_WIDTH)));
     constant MAX_CYCLES : integer := TEST_SIZE*1000;
 
     constant CLK0_HALF_PERIOD : time := 5 ns;
@@ -64,16 +67,27 @@ begin
     -- process to test different inputs
     process
 
-        -- function to check if the outputs is correct
+        -- function to check if the outputs is correct. With a signal and
+        -- kernel of all 1's, output i is the number of signal samples that
+        -- overlap the kernel, which is only correct if the padding is 0.
         function checkOutput (
             i : integer)
             return integer is
 
-        variable y : integer;
-                
+        variable first, last : integer;
 
         begin
-            return i+1;
+            first := i-C_KERNEL_SIZE+1;
+            if (first < 0) then
+                first := 0;
+            end if;
+
+            last := i;
+            if (last > TEST_SIZE-1) then
+                last := TEST_SIZE-1;
+            end if;
+
+            return last-first+1;
         end checkOutput;
 
         procedure clearMMAP is
@@ -126,7 +140,7 @@ begin
             -----------------------------------------------------------------------------------------------------------
             addr_count := 0;
 
-        -- pad 1's at the beginning of signal
+        -- write the unpadded signal of all 1's
         for i in 0 to DMA_SIZE-1 loop
             mmap_wr_addr <= std_logic_vector(to_unsigned(i, C_MMAP_ADDR_WIDTH));
             mmap_wr_en   <= '1';
@@ -236,7 +250,7 @@ begin
             mmap_wr_addr                                                 <= C_RAM1_DMA_ADDR;
             mmap_wr_en                                                   <= '1';
             mmap_wr_data                                                 <= (others => '0');
-            mmap_wr_data(C_RAM1_RD_SIZE_WIDTH+C_RAM1_ADDR_WIDTH-1 downto 0) <= std_logic_vector(to_unsigned(DMA_SIZE, C_RAM1_RD_SIZE_WIDTH) & to_unsigned(0, C_RAM1_ADDR_WIDTH));
+            mmap_wr_data(C_RAM1_RD_SIZE_WIDTH+C_RAM1_ADDR_WIDTH-1 downto 0) <= std_logic_vector(to_unsigned(OUT_DMA_SIZE, C_RAM1_RD_SIZE_WIDTH) & to_unsigned(0, C_RAM1_ADDR_WIDTH));
             wait until rising_edge(clk0);
             clearMMAP;
             for i in 0 to 100 loop
@@ -245,7 +259,7 @@ begin
 
 
     --        -- read outputs from output memory
-            for i in 0 to DMA_SIZE-1 loop
+            for i in 0 to OUT_DMA_SIZE-1 loop
                 mmap_rd_addr <= std_logic_vector(to_unsigned(i, C_MMAP_ADDR_WIDTH));
                 mmap_rd_en   <= '1';
                 wait until rising_edge(clk0);
@@ -254,13 +268,17 @@ begin
                 wait until rising_edge(clk0);
                 result       := mmap_rd_data;
 
-                if (unsigned(result) /= checkOutput(i)) then
-                    errors := errors + 1;
-                    report "Result for " & integer'image(i) &
-                        " is incorrect. The output is " &
-                        integer'image(to_integer(unsigned(result))) &
-                        " but should be " & integer'image(checkOutput(i));
-                end if;
+                -- each word holds two outputs, the first in the low half
+                for j in 0 to 1 loop
+                    if (2*i+j < OUTPUT_SIZE and
+                        unsigned(result((j+1)*C_RAM1_WR_DATA_WIDTH-1 downto j*C_RAM1_WR_DATA_WIDTH)) /= checkOutput(2*i+j)) then
+                        errors := errors + 1;
+                        report "Result for " & integer'image(2*i+j) &
+                            " is incorrect. The output is " &
+                            integer'image(to_integer(unsigned(result((j+1)*C_RAM1_WR_DATA_WIDTH-1 downto j*C_RAM1_WR_DATA_WIDTH)))) &
+                            " but should be " & integer'image(checkOutput(2*i+j));
+                    end if;
+                end loop;
 
                 for j in 0 to C_MMAP_CYCLES-1 loop
                     wait until rising_edge(clk0);
@@ -46,6 +46,11 @@ Board::Board(const char *bitfile, const vector<float> &clocks) : PAGE_SIZE(sysco
 }
 
 
+Board::Board() : PAGE_SIZE(sysconf(_SC_PAGESIZE)), mmapPages(NULL) {
+
+}
+
+
 Board::~Board() {
 
   delete mmapPages;
@@ -57,6 +57,10 @@ class Board {
   void configureFpgaClocks(const std::vector<float> &frequencies);
   void initializeMemoryMap();
   void handleError(std::string str) const;
+
+  // used by derived boards (e.g. emulators) that don't access the FPGA
+  // directly
+  Board();
 };
 
 #endif
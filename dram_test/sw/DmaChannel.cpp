@@ -0,0 +1,299 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+
+#include "DmaChannel.h"
+
+using namespace std;
+
+DmaChannel::DmaChannel(Board &board, unsigned long chunkWords) :
+  App(board), chunkWords(chunkWords), nextId(1), lastExecuted(0), completed(0),
+  failed(false), stopping(false), copyPending(false), copySrc(0), copyWords(0) {
+
+  if (chunkWords == 0 || chunkWords > RAM_WORDS)
+    this->chunkWords = RAM_WORDS;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+
+  // assert rst, cleared by memory map
+  App::write(1u, RST_ADDR);
+
+  pthread_create(&thread, NULL, channelThread, this);
+}
+
+
+DmaChannel::~DmaChannel() {
+
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&workCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+void DmaChannel::send(const void *data, unsigned long dramAddr, unsigned long words) {
+
+  wait(sendAsync(data, dramAddr, words));
+}
+
+
+void DmaChannel::receive(void *data, unsigned long dramAddr, unsigned long words) {
+
+  wait(receiveAsync(data, dramAddr, words));
+}
+
+
+void DmaChannel::copy(unsigned long srcAddr, unsigned long dstAddr, unsigned long words) {
+
+  wait(copyAsync(srcAddr, dstAddr, words));
+}
+
+
+DmaChannel::request_t DmaChannel::sendAsync(const void *data, unsigned long dramAddr,
+                                             unsigned long words) {
+
+  return enqueue(REQUEST_SEND, (boardWord_t *) data, 0, dramAddr, words);
+}
+
+
+DmaChannel::request_t DmaChannel::receiveAsync(void *data, unsigned long dramAddr,
+                                                unsigned long words) {
+
+  return enqueue(REQUEST_RECEIVE, (boardWord_t *) data, dramAddr, 0, words);
+}
+
+
+DmaChannel::request_t DmaChannel::copyAsync(unsigned long srcAddr, unsigned long dstAddr,
+                                             unsigned long words) {
+
+  return enqueue(REQUEST_COPY, NULL, srcAddr, dstAddr, words);
+}
+
+
+bool DmaChannel::isDone(request_t id) {
+
+  pthread_mutex_lock(&mutex);
+  bool done = completed >= id || failed;
+  pthread_mutex_unlock(&mutex);
+  return done;
+}
+
+
+void DmaChannel::wait(request_t id) {
+
+  pthread_mutex_lock(&mutex);
+  while (completed < id && !failed) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  bool ok = !failed;
+  pthread_mutex_unlock(&mutex);
+
+  if (!ok) {
+    cerr << "Error: DMA transfer failed" << endl;
+    throw 1;
+  }
+}
+
+
+void DmaChannel::waitAll() {
+
+  pthread_mutex_lock(&mutex);
+  request_t last = nextId-1;
+  pthread_mutex_unlock(&mutex);
+  wait(last);
+}
+
+
+DmaChannel::request_t DmaChannel::enqueue(RequestType type, boardWord_t *data,
+                                          unsigned long srcAddr, unsigned long dstAddr,
+                                          unsigned long words) {
+
+  Request request;
+  request.type = type;
+  request.data = data;
+  request.srcAddr = srcAddr;
+  request.dstAddr = dstAddr;
+  request.words = words;
+
+  pthread_mutex_lock(&mutex);
+  request.id = nextId++;
+  requests.push_back(request);
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+  return request.id;
+}
+
+
+unsigned long DmaChannel::getChunk(unsigned long addr, unsigned long words) const {
+
+  unsigned long toBoundary = DRAM_WORDS-(addr & (DRAM_WORDS-1));
+  unsigned long chunk = words < chunkWords ? words : chunkWords;
+  return chunk < toBoundary ? chunk : toBoundary;
+}
+
+
+bool DmaChannel::overlapsCopy(unsigned long addr, unsigned long words) const {
+
+  // compare on the wrapped DRAM addresses
+  unsigned long start = (addr-copySrc) & (DRAM_WORDS-1);
+  unsigned long back = (copySrc-addr) & (DRAM_WORDS-1);
+  return copyPending && (start < copyWords || back < words ||
+                         words >= DRAM_WORDS || copyWords >= DRAM_WORDS);
+}
+
+
+void DmaChannel::finishCopy() {
+
+  if (!copyPending) return;
+
+  // wait for the board to assert done
+  bool done = false;
+  while (!done) {
+    App::read(done, DONE_ADDR);
+  }
+
+  pthread_mutex_lock(&mutex);
+  copyPending = false;
+  completed = lastExecuted;
+  pthread_cond_broadcast(&doneCond);
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void DmaChannel::execute(const Request &request) {
+
+  unsigned long done = 0;
+
+  switch (request.type) {
+
+  case REQUEST_SEND:
+
+    // don't overwrite the source of a copy that is still running
+    if (overlapsCopy(request.dstAddr, request.words))
+      finishCopy();
+
+    while (done < request.words) {
+
+      unsigned long addr = (request.dstAddr+done) & (DRAM_WORDS-1);
+      unsigned long words = getChunk(addr, request.words-done);
+
+      // enable dma transfer from software into ram 0
+      App::write((unsigned) ((words << ADDR_WIDTH) | addr), RAM0_CONFIG_ADDR);
+      App::write(request.data+done, MEM_IN_ADDR, words);
+      done += words;
+    }
+    break;
+
+  case REQUEST_RECEIVE:
+
+    // DRAM1 might still be written by a copy
+    finishCopy();
+
+    while (done < request.words) {
+
+      unsigned long addr = (request.srcAddr+done) & (DRAM_WORDS-1);
+      unsigned long words = getChunk(addr, request.words-done);
+
+      // configure dma transfer from ram1 to software
+      App::write((unsigned) ((words << ADDR_WIDTH) | addr), RAM1_CONFIG_ADDR);
+      App::read(request.data+done, MEM_OUT_ADDR, words);
+      done += words;
+    }
+    break;
+
+  case REQUEST_COPY:
+
+    while (done < request.words) {
+
+      unsigned long src = (request.srcAddr+done) & (DRAM_WORDS-1);
+      unsigned long dst = (request.dstAddr+done) & (DRAM_WORDS-1);
+      unsigned long words = getChunk(src, request.words-done);
+      words = getChunk(dst, words);
+
+      // only one copy can run at a time
+      finishCopy();
+
+      // the size is in 16-bit elements
+      App::write((unsigned) (words*2), SIZE_ADDR);
+      App::write((unsigned) src, RAM0_ADDR_ADDR);
+      App::write((unsigned) dst, RAM1_ADDR_ADDR);
+      App::write(1u, GO_ADDR);
+
+      copyPending = true;
+      copySrc = src;
+      copyWords = words;
+      done += words;
+    }
+    break;
+  }
+}
+
+
+void *DmaChannel::channelThread(void *arg) {
+
+  DmaChannel *channel = (DmaChannel *) arg;
+
+  pthread_mutex_lock(&channel->mutex);
+  while (true) {
+
+    while (channel->requests.empty() && !channel->copyPending && !channel->stopping) {
+      pthread_cond_wait(&channel->workCond, &channel->mutex);
+    }
+
+    if (channel->requests.empty()) {
+
+      if (!channel->copyPending) break;
+
+      // nothing else to overlap with the copy
+      pthread_mutex_unlock(&channel->mutex);
+      try {
+        channel->finishCopy();
+      }
+      catch(...) {
+        channel->copyPending = false;
+        pthread_mutex_lock(&channel->mutex);
+        channel->failed = true;
+        pthread_cond_broadcast(&channel->doneCond);
+        continue;
+      }
+      pthread_mutex_lock(&channel->mutex);
+      continue;
+    }
+
+    Request request = channel->requests.front();
+    channel->requests.pop_front();
+    pthread_mutex_unlock(&channel->mutex);
+
+    bool ok = true;
+    try {
+      channel->execute(request);
+    }
+    catch(...) {
+      ok = false;
+    }
+
+    pthread_mutex_lock(&channel->mutex);
+    channel->lastExecuted = request.id;
+    if (!ok) {
+      channel->failed = true;
+      channel->copyPending = false;
+    }
+
+    // requests complete in order, so nothing after a running copy is done
+    // until the copy is
+    if (!channel->copyPending)
+      channel->completed = request.id;
+    pthread_cond_broadcast(&channel->doneCond);
+  }
+  pthread_mutex_unlock(&channel->mutex);
+
+  return NULL;
+}
@@ -0,0 +1,115 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _DMA_CHANNEL_H_
+#define _DMA_CHANNEL_H_
+
+#include <deque>
+#include <pthread.h>
+
+#include "App.h"
+
+#define ADDR_WIDTH 15
+#define RAM_WORDS (1 << ADDR_WIDTH)
+
+// words in each DRAM. DRAM addresses wrap at this boundary.
+#define DRAM_ADDR_WIDTH 15
+#define DRAM_WORDS (1 << DRAM_ADDR_WIDTH)
+
+#define MEM_IN_ADDR 0
+#define MEM_OUT_ADDR 0
+#define RST_ADDR ((1<<MMAP_ADDR_WIDTH)-8)
+#define RAM0_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-7)
+#define RAM1_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-6)
+#define GO_ADDR ((1<<MMAP_ADDR_WIDTH)-5)
+#define RAM0_ADDR_ADDR ((1<<MMAP_ADDR_WIDTH)-4)
+#define RAM1_ADDR_ADDR ((1<<MMAP_ADDR_WIDTH)-3)
+#define SIZE_ADDR ((1<<MMAP_ADDR_WIDTH)-2)
+#define DONE_ADDR ((1<<MMAP_ADDR_WIDTH)-1)
+
+
+/** \brief Transfers host buffers to and from arbitrary DRAM offsets.
+ *
+ * send() writes a host buffer to DRAM0, receive() reads DRAM1 into a host
+ * buffer, and copy() has the FPGA copy DRAM0 to DRAM1. Addresses and sizes
+ * are in 32-bit words. Transfers are split into chunks of at most
+ * chunkWords words that never cross the 2^15-word DRAM boundary, so any
+ * size can be transferred (addresses wrap like in the DRAM).
+ *
+ * The *Async() versions queue the transfer for the channel's thread and
+ * return immediately, so the caller can prepare the next buffer while the
+ * transfer is in flight. Host buffers must stay valid until wait() returns.
+ * Requests complete in order. A copy runs on the FPGA while the thread
+ * sends later chunks to DRAM0, and its DONE is only polled before anything
+ * that depends on it (a receive, another copy, or a send that overwrites
+ * its source).
+ */
+
+class DmaChannel : public App {
+
+ public:
+  typedef unsigned long request_t;
+
+  DmaChannel(Board &board, unsigned long chunkWords=RAM_WORDS);
+  ~DmaChannel();
+
+  void send(const void *data, unsigned long dramAddr, unsigned long words);
+  void receive(void *data, unsigned long dramAddr, unsigned long words);
+  void copy(unsigned long srcAddr, unsigned long dstAddr, unsigned long words);
+
+  request_t sendAsync(const void *data, unsigned long dramAddr, unsigned long words);
+  request_t receiveAsync(void *data, unsigned long dramAddr, unsigned long words);
+  request_t copyAsync(unsigned long srcAddr, unsigned long dstAddr, unsigned long words);
+
+  bool isDone(request_t id);
+
+  // throws if any transfer failed
+  void wait(request_t id);
+  void waitAll();
+
+ protected:
+  enum RequestType {
+    REQUEST_SEND,
+    REQUEST_RECEIVE,
+    REQUEST_COPY
+  };
+
+  struct Request {
+    RequestType type;
+    request_t id;
+    boardWord_t *data;
+    unsigned long srcAddr;
+    unsigned long dstAddr;
+    unsigned long words;
+  };
+
+  unsigned long chunkWords;
+
+  std::deque<Request> requests;
+  request_t nextId;
+  request_t lastExecuted;
+  request_t completed;
+  bool failed;
+  bool stopping;
+
+  // DRAM0 source range of a copy still running on the FPGA
+  bool copyPending;
+  unsigned long copySrc;
+  unsigned long copyWords;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t workCond;
+  pthread_cond_t doneCond;
+
+  request_t enqueue(RequestType type, boardWord_t *data, unsigned long srcAddr,
+                    unsigned long dstAddr, unsigned long words);
+  void execute(const Request &request);
+  void finishCopy();
+  unsigned long getChunk(unsigned long addr, unsigned long words) const;
+  bool overlapsCopy(unsigned long addr, unsigned long words) const;
+
+  static void *channelThread(void *channel);
+};
+
+#endif
@@ -8,10 +8,11 @@
 #include <cstdlib>
 
 #include "DramTest.h"
+#include "Timer.h"
 
 using namespace std;
 
-DramTest::DramTest(Board &board) : App(board) {
+DramTest::DramTest(Board &board) : App(board), dma(board), lfsr(0xace1u) {
 
 }
 
@@ -21,64 +22,31 @@ DramTest::~DramTest() {
 
 bool DramTest::start(unsigned int size, unsigned int addr) {
 
-  unsigned dmaWords = (unsigned long) ceil(size*sizeof(appWord_t)/(float) sizeof(boardWord_t));
-  
   // make sure test doesn't exceed dram address space in memory map
   if (size+addr > MAX_SIZE)
     size = MAX_SIZE-addr;
   
   //  cout << "Testing size " << size << " and address " << addr << endl;
   
-  // change to test smaller amounts  
-  unsigned config = (dmaWords << ADDR_WIDTH) | addr;
-  appWord_t go, done, rst;
+  unsigned dmaWords = (unsigned long) ceil(size*sizeof(appWord_t)/(float) sizeof(boardWord_t));
   appWord_t *input, *output;
   
-  input = (appWord_t *) safeMalloc(size*sizeof(appWord_t));
-  output = (appWord_t *) safeMalloc(size*sizeof(appWord_t));
+  // pooled buffers are reused across tests, so steady-state tests don't
+  // allocate or page fault
+  input = (appWord_t *) allocBuffer(size*sizeof(appWord_t));
+  output = (appWord_t *) allocBuffer(size*sizeof(appWord_t));
   assert(input != NULL);
   assert(output != NULL);
 
   // initialize input and output arrays
-  for (unsigned i=0; i < size; i++) {
-    
-    input[i] = rand();
-    output[i] = 0;    
-  }
+  fillPattern(input, size*sizeof(appWord_t));
+  memset(output, 0, size*sizeof(appWord_t));
 
-  // assert rst, cleared by memory map
-  rst = 1;
-  write(rst, RST_ADDR); 
-
-  // enable dma transfer from software into ram 0
-  write(config, RAM0_CONFIG_ADDR);
-  
-  // transfer all inputs
-  write(input, MEM_IN_ADDR, size);
-  write(size, SIZE_ADDR); 
-  write(addr, RAM0_ADDR_ADDR); 
-  write(addr, RAM1_ADDR_ADDR); 
-  
-  // assert go, cleared by memory map
-  go = 1;
-  write(&go, GO_ADDR, 1);
-  
-  // wait for the board to assert done
-  done = 0;
-  while (!done) {
-    read(done, DONE_ADDR);
-    
-#ifdef DEBUG
-    // wait 100 ms
-    usleep(100000); 
-#endif
-  }
-  
-  // configure dma transfer from ram1 to software
-  write(config, RAM1_CONFIG_ADDR);
-  
-  // read the outputs back from the FPGA
-  read(output, MEM_OUT_ADDR, size);
+  // transfer all inputs to DRAM0, copy them to DRAM1 on the FPGA, and read
+  // the outputs back
+  dma.send(input, addr, dmaWords);
+  dma.copy(addr, addr, dmaWords);
+  dma.receive(output, addr, dmaWords);
 
   /*  for (unsigned i=0; i < size; i++) {
 
@@ -86,10 +54,173 @@ bool DramTest::start(unsigned int size, unsigned int addr) {
   }
   */
   bool result = (memcmp(input, output, size*sizeof(appWord_t)) == 0);
-  delete[] input;
-  delete[] output;
+  releaseBuffer(input);
+  releaseBuffer(output);
   return result;
 }
 
 
+void DramTest::fillPattern(void *data, unsigned long bytes) {
+
+  // a 32-bit Galois LFSR (x^32+x^22+x^2+x+1) is much cheaper than rand()
+  // and never repeats within a transfer
+  boardWord_t word;
+  unsigned char *dst = (unsigned char *) data;
+
+  for (unsigned long i=0; i < bytes; i += sizeof(boardWord_t)) {
+
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0x80200003u);
+    word = lfsr;
+    memcpy(dst+i, &word, bytes-i < sizeof(boardWord_t) ? bytes-i : sizeof(boardWord_t));
+  }
+}
+
+
+bool DramTest::measure(BandwidthPoint &point, boardWord_t *input, boardWord_t *output,
+                       unsigned reps) {
+
+  Timer timer;
+
+  fillPattern(input, point.words*sizeof(boardWord_t));
+  memset(output, 0, point.words*sizeof(boardWord_t));
+
+  for (unsigned t=0; t < NUM_TRANSFERS; t++) {
+    point.mean[t] = 0.0;
+    point.min[t] = -1.0;
+  }
+
+  for (unsigned r=0; r < reps; r++) {
+    for (unsigned t=0; t < NUM_TRANSFERS; t++) {
+
+      timer.start();
+      switch (t) {
+      case TRANSFER_WRITE:
+        dma.send(input, point.align, point.words);
+        break;
+      case TRANSFER_COPY:
+        dma.copy(point.align, point.align, point.words);
+        break;
+      case TRANSFER_READ:
+        dma.receive(output, point.align, point.words);
+        break;
+      }
+      timer.stop();
+
+      double time = timer.elapsedTime();
+      point.mean[t] += time/reps;
+      if (point.min[t] < 0.0 || time < point.min[t])
+        point.min[t] = time;
+    }
+  }
+
+  return memcmp(input, output, point.words*sizeof(boardWord_t)) == 0;
+}
+
+
+void DramTest::fit(const vector<BandwidthPoint> &points, Transfer transfer,
+                   double &fixedCost, double &peak) {
+
+  // least squares fit of time = fixedCost + bytes/peak over the aligned
+  // points
+  double n = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+
+  for (unsigned i=0; i < points.size(); i++) {
+
+    if (points[i].align != 0) continue;
+
+    double x = points[i].words*sizeof(boardWord_t);
+    double y = points[i].mean[transfer];
+    n++;
+    sumX += x;
+    sumY += y;
+    sumXX += x*x;
+    sumXY += x*y;
+  }
+
+  double var = n*sumXX-sumX*sumX;
+  double slope = var > 0.0 ? (n*sumXY-sumX*sumY)/var : 0.0;
+
+  fixedCost = n > 0 ? (sumY-slope*sumX)/n : 0.0;
+  if (fixedCost < 0.0) fixedCost = 0.0;
+  peak = slope > 0.0 ? 1.0/slope : 0.0;
+}
+
+
+bool DramTest::characterize(ostream &out, bool json, unsigned reps) {
+
+  static const char *names[NUM_TRANSFERS] = {"write", "copy", "read"};
+
+  // word offsets from a DRAM boundary. Unaligned maximum size transfers
+  // wrap around the end of the DRAM.
+  const unsigned long aligns[] = {0, 1, 17};
+  const unsigned numAligns = sizeof(aligns)/sizeof(aligns[0]);
+
+  if (reps == 0) reps = 1;
 
+  boardWord_t *input = (boardWord_t *) allocBuffer(DRAM_WORDS*sizeof(boardWord_t));
+  boardWord_t *output = (boardWord_t *) allocBuffer(DRAM_WORDS*sizeof(boardWord_t));
+  vector<BandwidthPoint> points;
+  bool correct = true;
+
+  for (unsigned long words=1; words <= DRAM_WORDS; words *= 2) {
+    for (unsigned a=0; a < numAligns; a++) {
+
+      BandwidthPoint point;
+      point.words = words;
+      point.align = aligns[a];
+      correct = measure(point, input, output, reps) && correct;
+      points.push_back(point);
+    }
+  }
+
+  releaseBuffer(input);
+  releaseBuffer(output);
+
+  if (json) out << "{" << endl << "  \"points\": [" << endl;
+  else out << "words,bytes,align,transfer,mean_us,min_us,mbytes_per_sec" << endl;
+
+  for (unsigned i=0; i < points.size(); i++) {
+    for (unsigned t=0; t < NUM_TRANSFERS; t++) {
+
+      const BandwidthPoint &p = points[i];
+      unsigned long bytes = p.words*sizeof(boardWord_t);
+      double bandwidth = p.mean[t] > 0.0 ? bytes/p.mean[t]/1e6 : 0.0;
+
+      if (json) {
+        out << "    {\"words\": " << p.words << ", \"bytes\": " << bytes
+            << ", \"align\": " << p.align << ", \"transfer\": \"" << names[t]
+            << "\", \"mean_us\": " << p.mean[t]*1e6 << ", \"min_us\": " << p.min[t]*1e6
+            << ", \"mbytes_per_sec\": " << bandwidth << "}"
+            << (i+1 < points.size() || t+1 < NUM_TRANSFERS ? "," : "") << endl;
+      }
+      else {
+        out << p.words << "," << bytes << "," << p.align << "," << names[t] << ","
+            << p.mean[t]*1e6 << "," << p.min[t]*1e6 << "," << bandwidth << endl;
+      }
+    }
+  }
+
+  if (json) out << "  ]," << endl << "  \"fits\": [" << endl;
+  else out << endl << "transfer,fixed_us,peak_mbytes_per_sec,knee_bytes" << endl;
+
+  for (unsigned t=0; t < NUM_TRANSFERS; t++) {
+
+    double fixedCost, peak;
+    fit(points, (Transfer) t, fixedCost, peak);
+    double knee = fixedCost*peak;
+
+    if (json) {
+      out << "    {\"transfer\": \"" << names[t] << "\", \"fixed_us\": " << fixedCost*1e6
+          << ", \"peak_mbytes_per_sec\": " << peak/1e6 << ", \"knee_bytes\": " << knee << "}"
+          << (t+1 < NUM_TRANSFERS ? "," : "") << endl;
+    }
+    else {
+      out << names[t] << "," << fixedCost*1e6 << "," << peak/1e6 << "," << knee << endl;
+    }
+  }
+
+  if (json) out << "  ]," << endl << "  \"correct\": " << (correct ? "true" : "false")
+                << endl << "}" << endl;
+
+  return correct;
+}
@@ -4,24 +4,17 @@
 #ifndef _DRAM_TEST_H_
 #define _DRAM_TEST_H_
 
-#include "App.h"
-
-#define ADDR_WIDTH 15
-#define RAM_WORDS (1 << ADDR_WIDTH)
+#include <iostream>
+#include <vector>
 
-#define MEM_IN_ADDR 0
-#define MEM_OUT_ADDR 0
-#define RST_ADDR ((1<<MMAP_ADDR_WIDTH)-8)
-#define RAM0_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-7)
-#define RAM1_CONFIG_ADDR ((1<<MMAP_ADDR_WIDTH)-6)
-#define GO_ADDR ((1<<MMAP_ADDR_WIDTH)-5)
-#define RAM0_ADDR_ADDR ((1<<MMAP_ADDR_WIDTH)-4)
-#define RAM1_ADDR_ADDR ((1<<MMAP_ADDR_WIDTH)-3)
-#define SIZE_ADDR ((1<<MMAP_ADDR_WIDTH)-2)
-#define DONE_ADDR ((1<<MMAP_ADDR_WIDTH)-1)
+#include "App.h"
+#include "DmaChannel.h"
 
 #define NUM_RAND_TESTS 500
 
+// repetitions of every transfer measured by characterize()
+#define BW_REPS 20
+
 class DramTest : public App {
 
  public:  
@@ -33,8 +26,49 @@ class DramTest : public App {
 
   bool start(unsigned int input, unsigned int addr);
 
+  /** \brief Measures DMA bandwidth and latency over a grid of transfer
+   * sizes and DRAM alignments.
+   *
+   * Every point times a write to DRAM0, a copy to DRAM1 on the FPGA (the
+   * compute roundtrip) and a read from DRAM1, and checks the data once the
+   * timing is done. The results are written to out as CSV, or as JSON if
+   * json is true, followed by a fit of time = fixed cost + bytes/peak for
+   * each transfer. The knee is the size at which the fixed cost equals the
+   * streaming time, i.e., where half of the peak bandwidth is reached.
+   * Returns false if any transfer returned the wrong data.
+   */
+  bool characterize(std::ostream &out, bool json, unsigned reps=BW_REPS);
+
   static const unsigned int MAX_SIZE = RAM_WORDS*sizeof(boardWord_t)/sizeof(appWord_t);
 
+ protected:
+  DmaChannel dma;
+
+  // state of the LFSR that generates the test patterns
+  unsigned lfsr;
+
+  enum Transfer {
+    TRANSFER_WRITE,
+    TRANSFER_COPY,
+    TRANSFER_READ,
+    NUM_TRANSFERS
+  };
+
+  struct BandwidthPoint {
+    unsigned long words;
+    unsigned long align;
+
+    // mean and minimum seconds per transfer
+    double mean[NUM_TRANSFERS];
+    double min[NUM_TRANSFERS];
+  };
+
+  void fillPattern(void *data, unsigned long bytes);
+  bool measure(BandwidthPoint &point, boardWord_t *input, boardWord_t *output,
+               unsigned reps);
+  static void fit(const std::vector<BandwidthPoint> &points, Transfer transfer,
+                  double &fixedCost, double &peak);
+
 };
 
 #endif
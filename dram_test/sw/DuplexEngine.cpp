@@ -0,0 +1,194 @@
+// Greg Stitt
+// University of Florida
+
+#include <iostream>
+#include <cassert>
+
+#include "DuplexEngine.h"
+
+using namespace std;
+
+DuplexEngine::DuplexEngine(Board &board) :
+  App(board), inputs(NULL), outputs(NULL), words(0), numJobs(0),
+  uploaded(0), copied(0), readBack(0), failed(false) {
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&cond, NULL);
+
+  // assert rst, cleared by memory map
+  App::write(1u, RST_ADDR);
+}
+
+
+DuplexEngine::~DuplexEngine() {
+
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+
+void DuplexEngine::run(boardWord_t * const *inputs, boardWord_t * const *outputs,
+                       unsigned long words, unsigned numJobs) {
+
+  assert(words <= MAX_JOB_WORDS);
+
+  this->inputs = inputs;
+  this->outputs = outputs;
+  this->words = words;
+  this->numJobs = numJobs;
+  uploaded = copied = readBack = 0;
+  failed = false;
+
+  pthread_t uploader, reader;
+  pthread_create(&uploader, NULL, uploadThread, this);
+  pthread_create(&reader, NULL, readThread, this);
+
+  // this thread starts the copies between the other two
+  for (unsigned i=0; i < numJobs; i++) {
+
+    if (!waitFor(uploaded, i+1) || !waitFor(readBack, i < 2 ? 0 : i-1))
+      break;
+
+    bool ok = true;
+    try {
+      copy(i);
+    }
+    catch(...) {
+      ok = false;
+    }
+    finished(copied, ok);
+  }
+
+  pthread_join(uploader, NULL);
+  pthread_join(reader, NULL);
+
+  if (failed) {
+    cerr << "Error: duplex transfer failed" << endl;
+    throw 1;
+  }
+}
+
+
+void DuplexEngine::runSerial(boardWord_t * const *inputs, boardWord_t * const *outputs,
+                             unsigned long words, unsigned numJobs) {
+
+  assert(words <= MAX_JOB_WORDS);
+
+  this->inputs = inputs;
+  this->outputs = outputs;
+  this->words = words;
+
+  for (unsigned i=0; i < numJobs; i++) {
+    upload(i);
+    copy(i);
+    readOutput(i);
+  }
+}
+
+
+unsigned long DuplexEngine::getRegion(unsigned job) {
+
+  return (job % 2)*MAX_JOB_WORDS;
+}
+
+
+void DuplexEngine::upload(unsigned job) {
+
+  // enable dma transfer from software into ram 0
+  App::write((unsigned) ((words << ADDR_WIDTH) | getRegion(job)), RAM0_CONFIG_ADDR);
+  App::write(inputs[job], MEM_IN_ADDR, words);
+}
+
+
+void DuplexEngine::copy(unsigned job) {
+
+  // the size is in 16-bit elements
+  App::write((unsigned) (words*2), SIZE_ADDR);
+  App::write((unsigned) getRegion(job), RAM0_ADDR_ADDR);
+  App::write((unsigned) getRegion(job), RAM1_ADDR_ADDR);
+  App::write(1u, GO_ADDR);
+
+  // wait for the board to assert done
+  bool done = false;
+  while (!done) {
+    App::read(done, DONE_ADDR);
+  }
+}
+
+
+void DuplexEngine::readOutput(unsigned job) {
+
+  // configure dma transfer from ram1 to software
+  App::write((unsigned) ((words << ADDR_WIDTH) | getRegion(job)), RAM1_CONFIG_ADDR);
+  App::read(outputs[job], MEM_OUT_ADDR, words);
+}
+
+
+bool DuplexEngine::waitFor(const unsigned &count, unsigned target) {
+
+  pthread_mutex_lock(&mutex);
+  while (count < target && !failed) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  bool ok = !failed;
+  pthread_mutex_unlock(&mutex);
+  return ok;
+}
+
+
+void DuplexEngine::finished(unsigned &count, bool ok) {
+
+  pthread_mutex_lock(&mutex);
+  if (ok)
+    count++;
+  else
+    failed = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void *DuplexEngine::uploadThread(void *arg) {
+
+  DuplexEngine *engine = (DuplexEngine *) arg;
+
+  for (unsigned i=0; i < engine->numJobs; i++) {
+
+    if (!engine->waitFor(engine->copied, i < 2 ? 0 : i-1))
+      break;
+
+    bool ok = true;
+    try {
+      engine->upload(i);
+    }
+    catch(...) {
+      ok = false;
+    }
+    engine->finished(engine->uploaded, ok);
+  }
+
+  return NULL;
+}
+
+
+void *DuplexEngine::readThread(void *arg) {
+
+  DuplexEngine *engine = (DuplexEngine *) arg;
+
+  for (unsigned i=0; i < engine->numJobs; i++) {
+
+    if (!engine->waitFor(engine->copied, i+1))
+      break;
+
+    bool ok = true;
+    try {
+      engine->readOutput(i);
+    }
+    catch(...) {
+      ok = false;
+    }
+    engine->finished(engine->readBack, ok);
+  }
+
+  return NULL;
+}
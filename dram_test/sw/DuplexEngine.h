@@ -0,0 +1,73 @@
+// Greg Stitt
+// University of Florida
+
+#ifndef _DUPLEX_ENGINE_H_
+#define _DUPLEX_ENGINE_H_
+
+#include <pthread.h>
+
+#include "App.h"
+#include "DmaChannel.h"
+
+/** \brief Runs a stream of jobs through the DRAM test design with the RAM0
+ * upload and RAM1 readback paths used at the same time.
+ *
+ * Each job is uploaded to DRAM0, copied to DRAM1 by the FPGA, and read back.
+ * Jobs alternate between the two halves of each DRAM, so an upload thread
+ * can send job n+1 to DRAM0 while a readback thread reads job n from DRAM1
+ * and the calling thread starts the copies. The handshake between them is:
+ *
+ * - job n is only uploaded once the copy of job n-2 (which read the same
+ *   half of DRAM0) is done,
+ * - job n is only copied once it is uploaded and job n-2 (which is in the
+ *   same half of DRAM1) has been read back, and
+ * - job n is only read back once its copy is done.
+ *
+ * runSerial() does the same jobs one step after the other for comparison.
+ */
+
+class DuplexEngine : public App {
+
+ public:
+  DuplexEngine(Board &board);
+  ~DuplexEngine();
+
+  // every job is words long, which can be at most MAX_JOB_WORDS.
+  // throws if a transfer failed.
+  void run(boardWord_t * const *inputs, boardWord_t * const *outputs,
+           unsigned long words, unsigned numJobs);
+  void runSerial(boardWord_t * const *inputs, boardWord_t * const *outputs,
+                 unsigned long words, unsigned numJobs);
+
+  static const unsigned long MAX_JOB_WORDS = DRAM_WORDS/2;
+
+ protected:
+  boardWord_t * const *inputs;
+  boardWord_t * const *outputs;
+  unsigned long words;
+  unsigned numJobs;
+
+  // number of jobs that finished each step
+  unsigned uploaded;
+  unsigned copied;
+  unsigned readBack;
+  bool failed;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  static unsigned long getRegion(unsigned job);
+
+  void upload(unsigned job);
+  void copy(unsigned job);
+  void readOutput(unsigned job);
+
+  // waits until count reaches target, returns false if another step failed
+  bool waitFor(const unsigned &count, unsigned target);
+  void finished(unsigned &count, bool ok);
+
+  static void *uploadThread(void *engine);
+  static void *readThread(void *engine);
+};
+
+#endif
@@ -0,0 +1,176 @@
+// Greg Stitt
+// University of Florida
+
+#include <time.h>
+
+#include "EmuBoard.h"
+#include "DmaChannel.h"
+
+using namespace std;
+
+EmuBoard::EmuBoard(double pathBandwidth) : dram0(DRAM_WORDS, 0), dram1(DRAM_WORDS, 0),
+                       ram0WrAddr(0), ram1RdAddr(0), ram0RdAddr(0),
+                       ram1WrAddr(0), size(0), done(false),
+                       pathBandwidth(pathBandwidth) {
+
+  pthread_mutex_init(&ram0Mutex, NULL);
+  pthread_mutex_init(&ram1Mutex, NULL);
+  pthread_mutex_init(&regMutex, NULL);
+}
+
+
+EmuBoard::~EmuBoard() {
+
+  pthread_mutex_destroy(&regMutex);
+  pthread_mutex_destroy(&ram1Mutex);
+  pthread_mutex_destroy(&ram0Mutex);
+}
+
+
+bool EmuBoard::write(unsigned *data, unsigned long addr, unsigned long words) {
+
+  unsigned long i=0;
+  while (i < words) {
+
+    if (addr+i < RAM_WORDS) {
+
+      // stream the whole run of DMA words under one lock
+      unsigned long streamed = 0;
+      pthread_mutex_lock(&ram0Mutex);
+      for (; i < words && addr+i < RAM_WORDS; i++) {
+        dram0[ram0WrAddr] = data[i];
+        ram0WrAddr = (ram0WrAddr+1) & (DRAM_WORDS-1);
+        streamed++;
+      }
+      transferDelay(streamed);
+      pthread_mutex_unlock(&ram0Mutex);
+    }
+    else {
+      pthread_mutex_lock(&regMutex);
+      writeReg(addr+i, data[i]);
+      pthread_mutex_unlock(&regMutex);
+      i++;
+    }
+  }
+
+  return true;
+}
+
+
+bool EmuBoard::read(unsigned *data, unsigned long addr, unsigned long words) {
+
+  unsigned long i=0;
+  while (i < words) {
+
+    if (addr+i < RAM_WORDS) {
+
+      unsigned long streamed = 0;
+      pthread_mutex_lock(&ram1Mutex);
+      for (; i < words && addr+i < RAM_WORDS; i++) {
+        data[i] = dram1[ram1RdAddr];
+        ram1RdAddr = (ram1RdAddr+1) & (DRAM_WORDS-1);
+        streamed++;
+      }
+      transferDelay(streamed);
+      pthread_mutex_unlock(&ram1Mutex);
+    }
+    else {
+      pthread_mutex_lock(&regMutex);
+      data[i] = readReg(addr+i);
+      pthread_mutex_unlock(&regMutex);
+      i++;
+    }
+  }
+
+  return true;
+}
+
+
+void EmuBoard::writeReg(unsigned long addr, boardWord_t data) {
+
+  switch (addr) {
+
+  case RST_ADDR:
+    if (data & 1) done = false;
+    break;
+
+  case RAM0_CONFIG_ADDR:
+    pthread_mutex_lock(&ram0Mutex);
+    ram0WrAddr = data & (DRAM_WORDS-1);
+    pthread_mutex_unlock(&ram0Mutex);
+    break;
+
+  case RAM1_CONFIG_ADDR:
+    pthread_mutex_lock(&ram1Mutex);
+    ram1RdAddr = data & (DRAM_WORDS-1);
+    pthread_mutex_unlock(&ram1Mutex);
+    break;
+
+  case RAM0_ADDR_ADDR:
+    ram0RdAddr = data & (DRAM_WORDS-1);
+    break;
+
+  case RAM1_ADDR_ADDR:
+    ram1WrAddr = data & (DRAM_WORDS-1);
+    break;
+
+  case SIZE_ADDR:
+    size = data;
+    break;
+
+  case GO_ADDR:
+    if (data & 1) {
+      copy();
+      done = true;
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+
+boardWord_t EmuBoard::readReg(unsigned long addr) const {
+
+  switch (addr) {
+
+  case RAM0_ADDR_ADDR:
+    return ram0RdAddr;
+
+  case RAM1_ADDR_ADDR:
+    return ram1WrAddr;
+
+  case SIZE_ADDR:
+    return size;
+
+  case DONE_ADDR:
+    return done ? 1 : 0;
+
+  default:
+    return 0;
+  }
+}
+
+
+void EmuBoard::copy() {
+
+  // the size is in 16-bit elements, and addresses wrap like in the DRAM
+  for (unsigned long i=0; i < (size+1)/2; i++) {
+    dram1[(ram1WrAddr+i) & (DRAM_WORDS-1)] = dram0[(ram0RdAddr+i) & (DRAM_WORDS-1)];
+  }
+}
+
+
+void EmuBoard::transferDelay(unsigned long words) const {
+
+  if (pathBandwidth <= 0.0) return;
+
+  // the path stays busy (locked) for the length of the transfer, but the
+  // other path can run at the same time
+  double seconds = words*sizeof(boardWord_t)/pathBandwidth;
+  timespec delay;
+  delay.tv_sec = (time_t) seconds;
+  delay.tv_nsec = (long) ((seconds-delay.tv_sec)*1e9);
+  nanosleep(&delay, NULL);
+}
@@ -0,0 +1,58 @@
+// Greg Stitt
+// University of Florida
+// EmuBoard class
+// This class emulates the DRAM test accelerator's memory map in software so
+// that the host code can run without a ZedBoard. Like the DMA interfaces,
+// writes below RAM_WORDS stream into DRAM0 starting at the last RAM0 config
+// address, reads below RAM_WORDS stream out of DRAM1 starting at the last
+// RAM1 config address, and GO copies SIZE 16-bit elements from DRAM0 to
+// DRAM1. Like the hardware, the RAM0 write path, the RAM1 read path and
+// the registers can be used from different threads at the same time.
+
+#ifndef _EMU_BOARD_H_
+#define _EMU_BOARD_H_
+
+#include <vector>
+#include <pthread.h>
+
+#include "Board.h"
+
+class EmuBoard : public Board {
+
+ public:
+  // pathBandwidth limits the RAM0 write and RAM1 read paths to that many
+  // bytes/second each (0 is unlimited), to model the time of DMA transfers
+  EmuBoard(double pathBandwidth=0.0);
+  virtual ~EmuBoard();
+
+  virtual bool write(unsigned *data, unsigned long addr, unsigned long words);
+  virtual bool read(unsigned *data, unsigned long addr, unsigned long words);
+
+ protected:
+  std::vector<boardWord_t> dram0;
+  std::vector<boardWord_t> dram1;
+
+  // next DRAM word of the RAM0 write and RAM1 read DMAs
+  unsigned long ram0WrAddr;
+  unsigned long ram1RdAddr;
+
+  unsigned long ram0RdAddr;
+  unsigned long ram1WrAddr;
+  unsigned long size;
+  bool done;
+  double pathBandwidth;
+
+  // ram0Mutex guards ram0WrAddr, ram1Mutex guards ram1RdAddr, and regMutex
+  // guards the other registers. The DRAM contents aren't locked, since
+  // software must not read and write the same words at the same time.
+  pthread_mutex_t ram0Mutex;
+  pthread_mutex_t ram1Mutex;
+  pthread_mutex_t regMutex;
+
+  void writeReg(unsigned long addr, boardWord_t data);
+  boardWord_t readReg(unsigned long addr) const;
+  void copy();
+  void transferDelay(unsigned long words) const;
+};
+
+#endif
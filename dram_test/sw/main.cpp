@@ -11,12 +11,16 @@
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <fstream>
 
 #include <unistd.h>
 
 #include "Board.h"
 #include "Timer.h"
+#include "EmuBoard.h"
 #include "DramTest.h"
+#include "DmaChannel.h"
+#include "DuplexEngine.h"
 
 using namespace std;
 
@@ -42,10 +46,116 @@ void replaceMessage(string oldMsg, string newMsg) {
 }
 
 
+// sends the whole DRAM in small chunks from several queued requests, so
+// chunks cross the DRAM boundary and the copies overlap with later sends
+bool testAsync(Board &board) {
+
+  const unsigned chunkWords = 1000;
+  const unsigned numParts = 4;
+  const unsigned partWords = DRAM_WORDS/numParts;
+  const unsigned offset = DRAM_WORDS-chunkWords/2;
+
+  DmaChannel dma(board, chunkWords);
+  boardWord_t *input = (boardWord_t *) App::allocBuffer(DRAM_WORDS*sizeof(boardWord_t));
+  boardWord_t *output = (boardWord_t *) App::allocBuffer(DRAM_WORDS*sizeof(boardWord_t));
+
+  for (unsigned i=0; i < DRAM_WORDS; i++) {
+    input[i] = rand();
+    output[i] = 0;
+  }
+
+  for (unsigned i=0; i < numParts; i++) {
+    unsigned addr = offset+i*partWords;
+    dma.sendAsync(input+i*partWords, addr, partWords);
+    dma.copyAsync(addr, addr, partWords);
+  }
+  dma.receiveAsync(output, offset, DRAM_WORDS);
+  dma.waitAll();
+
+  bool result = memcmp(input, output, DRAM_WORDS*sizeof(boardWord_t)) == 0;
+  App::releaseBuffer(input);
+  App::releaseBuffer(output);
+  return result;
+}
+
+
+// runs the same jobs serially and with the upload and readback overlapped,
+// and reports the aggregate (upload+readback) bandwidth of each
+bool testDuplex(Board &board, unsigned numJobs, double &serialBw, double &duplexBw) {
+
+  const unsigned long words = DuplexEngine::MAX_JOB_WORDS;
+  const double bytes = 2.0*numJobs*words*sizeof(boardWord_t);
+
+  DuplexEngine engine(board);
+  vector<boardWord_t *> inputs(numJobs), outputs(numJobs);
+  Timer serial, duplex;
+  bool result = true;
+
+  for (unsigned i=0; i < numJobs; i++) {
+    inputs[i] = (boardWord_t *) App::allocBuffer(words*sizeof(boardWord_t));
+    outputs[i] = (boardWord_t *) App::allocBuffer(words*sizeof(boardWord_t));
+    for (unsigned j=0; j < words; j++) {
+      inputs[i][j] = rand();
+    }
+  }
+
+  try {
+    serial.start();
+    engine.runSerial(&inputs[0], &outputs[0], words, numJobs);
+    serial.stop();
+
+    for (unsigned i=0; i < numJobs; i++) {
+      memset(outputs[i], 0, words*sizeof(boardWord_t));
+    }
+
+    duplex.start();
+    engine.run(&inputs[0], &outputs[0], words, numJobs);
+    duplex.stop();
+
+    for (unsigned i=0; i < numJobs; i++) {
+      result = memcmp(inputs[i], outputs[i], words*sizeof(boardWord_t)) == 0 && result;
+    }
+  }
+  catch(...) {
+    result = false;
+  }
+
+  serialBw = bytes/serial.elapsedTime()/1e6;
+  duplexBw = bytes/duplex.elapsedTime()/1e6;
+
+  for (unsigned i=0; i < numJobs; i++) {
+    App::releaseBuffer(inputs[i]);
+    App::releaseBuffer(outputs[i]);
+  }
+  return result;
+}
+
+
 int main(int argc, char* argv[]) {
    
-  if (argc != 2) {
-    cerr << "Usage: " << argv[0] << " bitfile" << endl;
+  const char *bwFile = NULL;
+  unsigned bwReps = BW_REPS;
+  unsigned duplexJobs = 16;
+  double emuRate = 0.0;
+  bool badArgs = argc < 2;
+  for (int i=2; i < argc && !badArgs; i++) {
+    // back the transfer buffers with huge pages
+    if (strcmp(argv[i], "-huge") == 0)
+      App::setHugePages(true);
+    else if (strcmp(argv[i], "-bw") == 0 && i+1 < argc)
+      bwFile = argv[++i];
+    else if (strcmp(argv[i], "-reps") == 0 && i+1 < argc)
+      bwReps = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-duplex") == 0 && i+1 < argc)
+      duplexJobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-emurate") == 0 && i+1 < argc)
+      emuRate = atof(argv[++i])*1e6;
+    else
+      badArgs = true;
+  }
+
+  if (badArgs) {
+    cerr << "Usage: " << argv[0] << " (bitfile | -emu) [-huge] [-duplex jobs] [-emurate MB/s] [-bw file.(csv|json) [-reps n]]" << endl;
     return -1;
   }
 
@@ -61,7 +171,10 @@ int main(int argc, char* argv[]) {
   // initialize board
   Board *board;
   try {
-    board = new Board(argv[1], clocks);
+    if (strcmp(argv[1], "-emu") == 0)
+      board = new EmuBoard(emuRate);
+    else
+      board = new Board(argv[1], clocks);
   }
   catch(...) {
     exit(-1);
@@ -71,6 +184,31 @@ int main(int argc, char* argv[]) {
 
   DramTest dramTest(*board);
   string msg;
+
+  // characterize the bandwidth instead of running the pass/fail tests
+  if (bwFile != NULL) {
+
+    string name(bwFile);
+    bool json = name.size() >= 5 && name.compare(name.size()-5, 5, ".json") == 0;
+    ofstream out(bwFile);
+    if (!out) {
+      cerr << "Error: couldn't open " << bwFile << endl;
+      return -1;
+    }
+
+    cout << "Measuring DMA bandwidth....";
+    fflush(stdout);
+    if (!dramTest.characterize(out, json, bwReps)) {
+      cout << "ERROR: Transfers returned the wrong data" << endl;
+      return -1;
+    }
+
+    cout << "SUCCESS (results in " << bwFile << ")" << endl;
+    App::freeBufferPool();
+    delete board;
+    return 0;
+  }
+
   cout << "Testing transfers to/from address 0....";
 
   for (unsigned i=1; i*i <= DramTest::MAX_SIZE; i++) {
@@ -118,6 +256,27 @@ int main(int argc, char* argv[]) {
   }
 
   replaceMessage(msg, "SUCCESS\n"); 
+  cout << "Testing chunked asynchronous transfers....";
+
+  if (!testAsync(*board)) {
+      cout << "ERROR: Failed asynchronous transfers" << endl;
+      return -1;
+  }
+
+  cout << "SUCCESS" << endl;
+  cout << "Testing full-duplex transfers....";
+  fflush(stdout);
+
+  double serialBw, duplexBw;
+  if (!testDuplex(*board, duplexJobs, serialBw, duplexBw)) {
+      cout << "ERROR: Failed full-duplex transfers" << endl;
+      return -1;
+  }
+
+  cout << "SUCCESS" << endl;
+  cout << "Aggregate bandwidth: serial = " << serialBw << " MB/s, duplex = "
+       << duplexBw << " MB/s (" << duplexBw/serialBw << "x)" << endl;
+  App::freeBufferPool();
   delete board;
   return 0;
 }